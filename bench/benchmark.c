@@ -0,0 +1,606 @@
+// Benchmarks for the dictionary library.
+//
+// Build and run from the repository root:
+//     cc -O2 -o benchmark bench/benchmark.c -lpthread
+//     ./benchmark > bench_output.txt
+//
+// Every result is printed as one json object per line so the output of two versions can be diffed.
+// The library is compiled into this file so its allocations can be counted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Contadores de memoria dinamica, se comparten con los hilos de json lines
+unsigned long long mallocCount, reallocCount, freeCount, allocatedBytes;
+
+void *countingMalloc(size_t size)
+{
+    __atomic_fetch_add(&mallocCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocatedBytes, size, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+void *countingRealloc(void *pointer, size_t size)
+{
+    __atomic_fetch_add(&reallocCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocatedBytes, size, __ATOMIC_RELAXED);
+    return realloc(pointer, size);
+}
+
+void countingFree(void *pointer)
+{
+    if (pointer)
+        __atomic_fetch_add(&freeCount, 1, __ATOMIC_RELAXED);
+    free(pointer);
+}
+
+#define malloc countingMalloc
+#define realloc countingRealloc
+#define free countingFree
+#include "../src/dictionary.c"
+#undef malloc
+#undef realloc
+#undef free
+
+#define MIN_TIME_NS 200000000.0  // Cada caso se repite hasta tardar al menos este tiempo
+#define MAX_SIZE 1000000
+
+typedef struct
+{
+    unsigned long long mallocs, reallocs, frees, bytes;
+    double nanoseconds;
+} Measure;
+
+unsigned long long randomState = 88172645463325252ULL;
+
+// Generador xorshift, para que todas las ejecuciones usen los mismos datos
+unsigned long long nextRandom()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+void startMeasure(Measure *m)
+{
+    m->mallocs = mallocCount;
+    m->reallocs = reallocCount;
+    m->frees = freeCount;
+    m->bytes = allocatedBytes;
+    m->nanoseconds = now();
+}
+
+void stopMeasure(Measure *m)
+{
+    m->nanoseconds = now() - m->nanoseconds;
+    m->mallocs = mallocCount - m->mallocs;
+    m->reallocs = reallocCount - m->reallocs;
+    m->frees = freeCount - m->frees;
+    m->bytes = allocatedBytes - m->bytes;
+}
+
+// Imprime un resultado. Si bytes no es 0 tambien se imprime el rendimiento en MB/s
+void report(const char *name, const char *variant, long size, long operations, size_t bytes, const Measure *m)
+{
+    printf("{\"benchmark\":\"%s\",\"variant\":\"%s\",\"size\":%ld,\"operations\":%ld,\"ns_per_op\":%.1f",
+           name, variant, size, operations, m->nanoseconds / operations);
+    if (bytes)
+        printf(",\"mb_per_s\":%.2f", bytes * (double) operations / (m->nanoseconds / 1e9) / 1e6);
+    printf(",\"mallocs_per_op\":%.2f,\"reallocs_per_op\":%.2f,\"frees_per_op\":%.2f,\"bytes_allocated_per_op\":%.1f}\n",
+           (double) m->mallocs / operations, (double) m->reallocs / operations,
+           (double) m->frees / operations, (double) m->bytes / operations);
+    fflush(stdout);
+}
+
+void keyName(char *key, long i)
+{
+    sprintf(key, "key%ld", i);
+}
+
+// Crea un diccionario de size numeros enlazando los elementos directamente,
+// pues con setNumber construir los diccionarios mas grandes tomaria un tiempo cuadratico
+Dictionary *numberDictionary(long size)
+{
+    Dictionary *d = newDictionary();
+    Element *last = NULL;
+    char key[80];
+    long i;
+
+    for(i = 0; i < size; i++)
+    {
+        double value = i;
+        keyName(key, i);
+        Element *newp = newElement(d->allocator, key, 'n', copyNumber(d->allocator, &value));
+        if (last)
+            last->next = newp;
+        else
+            d->first = newp;
+        last = newp;
+    }
+
+    return d;
+}
+
+// Cantidad de operaciones para que un caso sobre un diccionario de size claves no tarde demasiado
+long operationsFor(long size)
+{
+    long operations = 20000000 / size;
+    return operations < 10 ? 10 : operations > 1000000 ? 1000000 : operations;
+}
+
+void benchmarkLookups(long size)
+{
+    Dictionary *d = numberDictionary(size);
+    long operations = operationsFor(size), i;
+    char keys[256][80], missing[80];
+    double result;
+    Measure m;
+
+    for(i = 0; i < 256; i++)
+        keyName(keys[i], nextRandom() % size);
+    strcpy(missing, "missing");
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        getNumber(d, keys[i & 255], &result);
+    stopMeasure(&m);
+    report("getNumber", "hit", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        getNumber(d, missing, &result);
+    stopMeasure(&m);
+    report("getNumber", "miss", size, operations, 0, &m);
+
+    // Las mismas busquedas con el indice ordenado, y un recorrido completo en orden de claves
+    DictionaryCursor cursor;
+    DictionaryEntry entry;
+    createOrderedIndex(d);
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        getNumber(d, keys[i & 255], &result);
+    stopMeasure(&m);
+    report("getNumber", "hit, ordered index", size, operations, 0, &m);
+
+    startMeasure(&m);
+    startOrderedIteration(d, &cursor, NULL, NULL);
+    while (nextEntry(&cursor, &entry));
+    stopMeasure(&m);
+    report("nextEntry", "key order", size, size, 0, &m);
+    dropOrderedIndex(d);
+
+    // Con el indice de prefijos, contar las claves que empiezan con "key1" (alrededor de un decimo del total)
+    int count;
+    createPrefixIndex(d);
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        countEntriesWithPrefix(d, "key1", &count);
+    stopMeasure(&m);
+    report("countEntriesWithPrefix", "key1", size, operations, 0, &m);
+    dropPrefixIndex(d);
+
+    // Con forma, cada accessor busca su clave la primera vez y despues va directo a su slot
+    DictionaryAccessor accessors[256];
+    shapeDictionary(d);
+    for(i = 0; i < 256; i++)
+        initAccessor(&accessors[i], keys[i]);
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        getNumberAt(d, &accessors[i & 255], &result);
+    stopMeasure(&m);
+    report("getNumberAt", "hit, shape", size, operations, 0, &m);
+    releaseShape(d);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        setNumber(d, keys[i & 255], i);
+    stopMeasure(&m);
+    report("setNumber", "overwrite", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+    {
+        setNumber(d, missing, i);
+        removeElement(d, missing);
+    }
+    stopMeasure(&m);
+    report("setNumber+removeElement", "new key", size, operations, 0, &m);
+
+    // Se agrega una clave con cada tipo para medir las funciones que devuelven copias
+    double numbers[16] = {0};
+    char *strings[4] = {"a", "bb", "ccc", "dddd"};
+    Dictionary *small = numberDictionary(10);
+    setNumberArray(d, "numbers", 16, numbers);
+    setStringArray(d, "strings", 4, strings);
+    setString(d, "string", "value");
+    setDictionary(d, "dictionary", small);
+    freeDictionary(small);
+
+    int arraySize;
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        free(getString(d, "string"));
+    stopMeasure(&m);
+    report("getString", "hit", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        free(getNumberArray(d, "numbers", &arraySize));
+    stopMeasure(&m);
+    report("getNumberArray", "16 numbers", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        sumNumberArray(d, "numbers", &result);
+    stopMeasure(&m);
+    report("sumNumberArray", "16 numbers", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+    {
+        char **array = getStringArray(d, "strings", &arraySize);
+        int j;
+        for(j = 0; j < arraySize; j++)
+            free(array[j]);
+        free(array);
+    }
+    stopMeasure(&m);
+    report("getStringArray", "4 strings", size, operations, 0, &m);
+
+    startMeasure(&m);
+    for(i = 0; i < operations; i++)
+        freeDictionary(getDictionary(d, "dictionary"));
+    stopMeasure(&m);
+    report("getDictionary", "10 keys", size, operations, 0, &m);
+
+    freeDictionary(d);
+}
+
+// Crea un diccionario anidado depth niveles, cada nivel con width numeros y la clave "child"
+Dictionary *deepDictionary(int depth, int width)
+{
+    Dictionary *d = numberDictionary(width);
+
+    if (depth > 1)
+    {
+        Dictionary *child = deepDictionary(depth - 1, width);
+        setDictionary(d, "child", child);
+        freeDictionary(child);
+    }
+
+    return d;
+}
+
+// Crea un diccionario de width claves, cada una con un diccionario de 10 numeros
+Dictionary *wideDictionary(long width)
+{
+    Dictionary *d = newDictionary(), *child = numberDictionary(10);
+    Element *last = NULL;
+    char key[80];
+    long i;
+
+    for(i = 0; i < width; i++)
+    {
+        keyName(key, i);
+        appendElement(d, &last, newElement(d->allocator, key, 'd', copyDictionary(d->allocator, child)));
+    }
+
+    freeDictionary(child);
+    return d;
+}
+
+void benchmarkCopy(const char *variant, Dictionary *d, long size)
+{
+    long operations = 0, i, batch = 1;
+    Measure copy = {0}, release = {0}, m;
+
+    while (copy.nanoseconds < MIN_TIME_NS)
+    {
+        for(i = 0; i < batch; i++)
+        {
+            startMeasure(&m);
+            Dictionary *aux = copyDictionary(d->allocator, d);
+            stopMeasure(&m);
+            copy.nanoseconds += m.nanoseconds;
+            copy.mallocs += m.mallocs;
+            copy.reallocs += m.reallocs;
+            copy.frees += m.frees;
+            copy.bytes += m.bytes;
+
+            startMeasure(&m);
+            freeDictionary(aux);
+            stopMeasure(&m);
+            release.nanoseconds += m.nanoseconds;
+            release.mallocs += m.mallocs;
+            release.reallocs += m.reallocs;
+            release.frees += m.frees;
+            release.bytes += m.bytes;
+        }
+        operations += batch;
+        batch *= 2;
+    }
+
+    report("copyDictionary", variant, size, operations, 0, &copy);
+    report("freeDictionary", variant, size, operations, 0, &release);
+}
+
+#define CHURN_OPERATIONS 1000000  // Claves que agrega y quita cada hilo en benchmarkChurn
+
+// Agrega y quita una clave de su propio diccionario muchas veces
+void *churn(void *dictionary)
+{
+    Dictionary *d = (Dictionary *) dictionary;
+    long i;
+
+    for(i = 0; i < CHURN_OPERATIONS; i++)
+    {
+        setNumber(d, "missing", i);
+        removeElement(d, "missing");
+    }
+    return NULL;
+}
+
+// Mide setNumber y removeElement en threads hilos a la vez, cada uno sobre un diccionario de 10 claves
+void benchmarkChurn(int threads)
+{
+    Dictionary *dictionaries[threads];
+    pthread_t ids[threads];
+    char variant[80];
+    Measure m;
+    int i;
+
+    for(i = 0; i < threads; i++)
+        dictionaries[i] = numberDictionary(10);
+
+    startMeasure(&m);
+    for(i = 0; i < threads; i++)
+        pthread_create(&ids[i], NULL, churn, dictionaries[i]);
+    for(i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+    stopMeasure(&m);
+
+    sprintf(variant, "new key, %d threads", threads);
+    report("setNumber+removeElement", variant, 10, (long) threads * CHURN_OPERATIONS, 0, &m);
+
+    for(i = 0; i < threads; i++)
+        freeDictionary(dictionaries[i]);
+}
+
+// Agrega a json el texto s, creciendo el buffer si hace falta
+void append(char **json, size_t *len, size_t *capacity, const char *s)
+{
+    size_t sLen = strlen(s);
+    while (*len + sLen + 1 > *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 4096;
+        *json = realloc(*json, *capacity);
+    }
+    memcpy(*json + *len, s, sLen + 1);
+    *len += sLen;
+}
+
+// Configuracion plana: claves con strings, numeros y booleanos
+char *flatConfig(int keys)
+{
+    char *json = NULL, item[160];
+    size_t len = 0, capacity = 0;
+    int i;
+
+    append(&json, &len, &capacity, "{");
+    for(i = 0; i < keys; i++)
+    {
+        if (i % 3 == 0)
+            sprintf(item, "\"setting_%d\":\"value-%llu\"", i, nextRandom() % 100000);
+        else if (i % 3 == 1)
+            sprintf(item, "\"setting_%d\":%.3f", i, (nextRandom() % 1000000) / 1000.0);
+        else
+            sprintf(item, "\"setting_%d\":%s", i, nextRandom() % 2 ? "true" : "false");
+        append(&json, &len, &capacity, i ? "," : "");
+        append(&json, &len, &capacity, item);
+    }
+    append(&json, &len, &capacity, "}");
+    return json;
+}
+
+// Telemetria: pocas claves, cada una con un arreglo grande de numeros
+char *telemetry(int series, int samples)
+{
+    char *json = NULL, item[80];
+    size_t len = 0, capacity = 0;
+    int i, j;
+
+    append(&json, &len, &capacity, "{\"host\":\"node-17\"");
+    for(i = 0; i < series; i++)
+    {
+        sprintf(item, ",\"metric_%d\":[", i);
+        append(&json, &len, &capacity, item);
+        for(j = 0; j < samples; j++)
+        {
+            sprintf(item, "%s%.3f", j ? "," : "", (long long) (nextRandom() % 2000000) / 1000.0 - 1000);
+            append(&json, &len, &capacity, item);
+        }
+        append(&json, &len, &capacity, "]");
+    }
+    append(&json, &len, &capacity, "}");
+    return json;
+}
+
+// Diccionarios anidados depth niveles
+char *deeplyNested(int depth)
+{
+    char *json = NULL, item[80];
+    size_t len = 0, capacity = 0;
+    int i;
+
+    for(i = 0; i < depth; i++)
+    {
+        sprintf(item, "{\"level\":%d.000,\"name\":\"level-%d\",\"child\":", i, i);
+        append(&json, &len, &capacity, item);
+    }
+    append(&json, &len, &capacity, "{\"leaf\":true}");
+    for(i = 0; i < depth; i++)
+        append(&json, &len, &capacity, "}");
+    return json;
+}
+
+// Tabla: un arreglo grande de diccionarios con las mismas claves
+char *dictionaryArray(int rows)
+{
+    char *json = NULL, item[256];
+    size_t len = 0, capacity = 0;
+    int i;
+
+    append(&json, &len, &capacity, "{\"table\":\"events\",\"rows\":[");
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(item, "%s{\"id\":%d.000,\"user\":\"user-%llu\",\"score\":%.3f,\"active\":%s,\"tags\":[\"a\",\"b\"]}",
+                i ? "," : "", i, nextRandom() % 10000, (nextRandom() % 100000) / 1000.0,
+                nextRandom() % 2 ? "true" : "false");
+        append(&json, &len, &capacity, item);
+    }
+    append(&json, &len, &capacity, "]}");
+    return json;
+}
+
+// Registros que repiten los mismos objetos anidados: una de pocas direcciones y los mismos metadatos
+char *repeatedObjects(int rows)
+{
+    char *json = NULL, item[512];
+    size_t len = 0, capacity = 0;
+    int i;
+
+    append(&json, &len, &capacity, "{\"table\":\"customers\",\"rows\":[");
+    for(i = 0; i < rows; i++)
+    {
+        sprintf(item, "%s{\"id\":%d.000,\"address\":{\"street\":\"street-%llu\",\"city\":\"city\",\"zip\":\"1000\","
+                "\"geo\":{\"lat\":1.500,\"lon\":2.500}},\"meta\":{\"source\":\"import\",\"version\":3.000,"
+                "\"flags\":[true,false]}}", i ? "," : "", i, nextRandom() % 8);
+        append(&json, &len, &capacity, item);
+    }
+    append(&json, &len, &capacity, "]}");
+    return json;
+}
+
+void benchmarkJson(const char *variant, char *json)
+{
+    size_t len = strlen(json);
+    long operations = 0, i, batch = 1;
+    Measure parse = {0}, serialize = {0}, m;
+    Dictionary *d = dictionaryFromJson(json);
+
+    if (!d)
+    {
+        fprintf(stderr, "benchmark: the %s corpus is not valid json\n", variant);
+        exit(1);
+    }
+
+    // El json generado por la libreria puede no ser identico al del corpus, se mide con su propio tamano
+    char *generated = jsonFromDictionary(d);
+    size_t generatedLen = strlen(generated);
+    free(generated);
+
+    while (parse.nanoseconds < MIN_TIME_NS)
+    {
+        startMeasure(&m);
+        for(i = 0; i < batch; i++)
+            freeDictionary(dictionaryFromJson(json));
+        stopMeasure(&m);
+        parse.nanoseconds += m.nanoseconds;
+        parse.mallocs += m.mallocs;
+        parse.reallocs += m.reallocs;
+        parse.frees += m.frees;
+        parse.bytes += m.bytes;
+        operations += batch;
+        batch *= 2;
+    }
+    report("dictionaryFromJson", variant, len, operations, len, &parse);
+
+    for(operations = 0, batch = 1; serialize.nanoseconds < MIN_TIME_NS; operations += batch, batch *= 2)
+    {
+        startMeasure(&m);
+        for(i = 0; i < batch; i++)
+            free(jsonFromDictionary(d));
+        stopMeasure(&m);
+        serialize.nanoseconds += m.nanoseconds;
+        serialize.mallocs += m.mallocs;
+        serialize.reallocs += m.reallocs;
+        serialize.frees += m.frees;
+        serialize.bytes += m.bytes;
+    }
+    report("jsonFromDictionary", variant, generatedLen, operations, generatedLen, &serialize);
+
+    // Con el json guardado, cambiando una clave del primer nivel antes de cada serializacion
+    Measure cached = {0};
+    setJsonCache(d, 1);
+    for(operations = 0, batch = 1; cached.nanoseconds < MIN_TIME_NS; operations += batch, batch *= 2)
+    {
+        startMeasure(&m);
+        for(i = 0; i < batch; i++)
+        {
+            setNumber(d, "changed", i);
+            free(jsonFromDictionary(d));
+        }
+        stopMeasure(&m);
+        cached.nanoseconds += m.nanoseconds;
+        cached.mallocs += m.mallocs;
+        cached.reallocs += m.reallocs;
+        cached.frees += m.frees;
+        cached.bytes += m.bytes;
+    }
+    report("setNumber+jsonFromDictionary", "cached json", generatedLen, operations, generatedLen, &cached);
+
+    freeDictionary(d);
+    free(json);
+}
+
+int main(int argc, char *argv[])
+{
+    long size, maxSize = argc > 1 ? atol(argv[1]) : MAX_SIZE;
+
+    if (maxSize < 10)
+    {
+        fprintf(stderr, "usage: %s [max dictionary size, at least 10]\n", argv[0]);
+        return 1;
+    }
+
+    for(size = 10; size <= maxSize; size *= 10)
+        benchmarkLookups(size);
+
+    benchmarkChurn(1);
+    benchmarkChurn(4);
+
+    Dictionary *d;
+    d = deepDictionary(100, 10);
+    benchmarkCopy("deep 100 levels x 10 keys", d, 100 * 11);
+    freeDictionary(d);
+
+    d = deepDictionary(1000, 10);
+    benchmarkCopy("deep 1000 levels x 10 keys", d, 1000 * 11);
+    freeDictionary(d);
+
+    d = wideDictionary(10000);
+    benchmarkCopy("wide 10000 keys x 10 keys", d, 10000 * 11);
+    freeDictionary(d);
+
+    benchmarkJson("flat config", flatConfig(200));
+    benchmarkJson("numeric telemetry", telemetry(8, 4096));
+    benchmarkJson("deeply nested", deeplyNested(100));
+    benchmarkJson("deeply nested, 1000 levels", deeplyNested(1000));
+    benchmarkJson("dictionary array", dictionaryArray(2000));
+    benchmarkJson("repeated objects", repeatedObjects(2000));
+    setInterning(1);
+    benchmarkJson("repeated objects, interning", repeatedObjects(2000));
+    setInterning(0);
+
+    return 0;
+}
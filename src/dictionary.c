@@ -1,1033 +1,7257 @@
+#define _POSIX_C_SOURCE 200809L  // clock_gettime, ftruncate y las demas funciones POSIX aunque se compile con -std=c11
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NUMBER_KERNELS_SIMD  // Hay versiones SSE2 y AVX2 de las operaciones sobre arreglos numericos
+#endif
 #include "dictionary.h"
 
+#define LINES_PER_TASK 64      // Lineas que toma cada hilo de una vez al leer o escribir json lines
+#define LINES_PER_BATCH 65536  // Lineas que se procesan juntas antes de entregarlas o escribirlas
+#define MAX_THREADS 256        // Hilos que se usan como maximo al leer o escribir json lines
+#define BITS_PER_WORD 64       // Booleanos que caben en cada palabra de un arreglo booleano
+#define INDEX_DEGREE 16        // Grado minimo del arbol B de los indices ordenados, cada nodo tiene hasta 2 * INDEX_DEGREE hijos
+#define MIN_TABLE_ROWS 2       // Cantidad minima de diccionarios con la misma forma para guardarlos por columnas
+#define FRAME_STACK_BYTES 1024 // Bytes de marcos que una pila de marcos guarda en el stack antes de pedir memoria
+#define POOL_CLASSES 4         // Tamanos de bloque del pool: 16, 32, 64 y 128 bytes
+#define POOL_SLAB_BYTES 65536  // Memoria que el pool pide de una vez para los bloques de un tamano, alineada a su tamano
+#define POOL_BATCH 64          // Bloques que un hilo pasa de una vez entre su cache y el pool compartido
+#define SHAPE_CACHE_SIZE 256   // Transiciones entre formas que recuerda cada hilo
+#define STORE_COMPACT_BYTES (16 << 20)  // Largo del log de un store a partir del que se compacta, si no se indica otro
+#define STORE_VERSION 1                 // Version del formato del log y del snapshot
+#define LOG_HEADER_BYTES 16             // Encabezado del log: "DLOG", version y generacion
+#define SNAPSHOT_HEADER_BYTES 28        // Encabezado del snapshot: "DSNP", version, generacion, largo y checksum
+#define RECORD_HEADER_BYTES 8           // Encabezado de cada registro del log: largo y checksum
+
+// Las estadisticas se pueden desactivar compilando con -DDICTIONARY_NO_STATS
+#ifndef DICTIONARY_NO_STATS
+#define STATS_ADD(field, n) statsAdd(offsetof(DictionaryStats, field), (n))
+#define STATS_MAX(field, n) statsMax(offsetof(DictionaryStats, field), (n))
+#define STATS_CLOCK() statsClock()
+#else
+#define STATS_ADD(field, n) ((void) sizeof(n))
+#define STATS_MAX(field, n) ((void) sizeof(n))
+#define STATS_CLOCK() 0LL
+#endif
+
+// Los arreglos booleanos guardan un bit por elemento en palabras de tipo unsigned long long, y los arreglos
+// de diccionarios con las mismas claves (tipo 'c') guardan en elements una tabla en lugar de los diccionarios
 typedef struct
 {
     int size;
     void *elements;
     char type;
+    unsigned long long hash;  // Hash de los elementos, el mismo para una tabla y un arreglo de diccionarios iguales
+    long long arrayBytes;     // Bytes del arreglo sin sus strings ni sus diccionarios, medidos al crearlo
+    long long stringBytes;    // Bytes de los strings del arreglo, tambien los de las celdas de una tabla
 } Array;
 
-void errorMessage();
-void freeDictionary(Dictionary *dictionary);
-void freeElement(Element *element);
-Element *newElement(const char *key, char type, void *value);
-double *copyNumber(const double *number);
-Bool *copyBool(const Bool *value);
-char *copyString(const char *s);
-Array *newArray(void *elements, int size, char type);
-double *copyNumberArray(int size, double value[size]);
-Bool *copyBoolArray(int size, Bool value[size]);
-char **copyStringArray(int size, char *value[size]);
-Dictionary *copyDictionary(const Dictionary *dictionary);
-Dictionary **copyDictionaryArray(int size, Dictionary *value[size]);
+// Arreglo de diccionarios guardado por columnas: una clave y un arreglo de valores por columna
+typedef struct
+{
+    int columns;
+    char **keys;    // Clave de cada columna
+    char *types;    // Tipo de cada columna
+    void **values;  // Valores de cada columna: double * si es 'n', Bool * si es 'b' y un arreglo de punteros si no
+} Table;
+
+// Nodo del arbol B de un indice ordenado. Guarda los elementos ordenados por clave, y en los nodos internos
+// las claves del hijo i son menores a la del elemento i y las del hijo i + 1 mayores
+typedef struct indexNode
+{
+    int count;  // Cantidad de elementos, entre INDEX_DEGREE - 1 y 2 * INDEX_DEGREE - 1 salvo en la raiz
+    int leaf;
+    Element *elements[2 * INDEX_DEGREE - 1];
+    struct indexNode *children[2 * INDEX_DEGREE];
+} IndexNode;
+
+// Nodo del arbol radix de un indice de prefijos. Cada nodo agrega su etiqueta a la clave de su padre, y la etiqueta
+// no se copia sino que es parte de la clave de algun elemento del subarbol
+typedef struct prefixNode
+{
+    const Element *owner;        // Elemento en cuya clave esta la etiqueta, NULL en la raiz
+    int start;                   // La etiqueta son los length caracteres de owner->key desde start
+    int length;
+    Element *element;            // Elemento cuya clave termina en este nodo, o NULL
+    int count;                   // Elementos en el subarbol
+    struct prefixNode *child;    // Primer hijo, los hijos estan ordenados por el primer caracter de su etiqueta
+    struct prefixNode *sibling;
+} PrefixNode;
+
+// Forma de un diccionario, es decir la secuencia de sus claves. Las formas forman un arbol en el que cada una agrega
+// una clave a la de su padre, y se comparten entre todos los diccionarios con las mismas claves en el mismo orden.
+// Solo references, child y sibling cambian. child y sibling solo con shapesLock tomado, y references de forma atomica:
+// sin el lock solo la puede aumentar quien ya tiene una referencia, y solo bajar si no es la ultima
+typedef struct shape
+{
+    struct shape *parent;
+    char key[80];              // Ultima clave, su slot es size - 1
+    int size;                  // Cantidad de claves
+    unsigned long long id;     // Distinto para cada forma creada, asi un accessor no confunde una forma liberada con una nueva
+    int references;            // Diccionarios y formas hijas que la usan
+    struct shape *child;       // Primera forma que agrega una clave a esta
+    struct shape *sibling;
+} Shape;
+
+// Nodo de una proyeccion: una clave de un camino pedido. Los hijos son las claves que se guardan del diccionario
+// que tenga como valor, salvo que whole indique que se guarda el valor entero
+typedef struct projectionNode
+{
+    char key[80];                        // Vacia en la raiz
+    int whole;
+    struct projectionNode *child;
+    struct projectionNode *sibling;
+    struct projectionNode *nextAllocated;  // Siguiente nodo de la proyeccion, para hacerles free sin recorrer el arbol
+} ProjectionNode;
+
+// Operaciones sobre los elementos de un arreglo numerico. Hay una version por cada juego de instrucciones
+// y se elige la mejor que soporte el procesador la primera vez que se usan
+typedef struct
+{
+    double (*sum)(const double *values, int size);
+    double (*min)(const double *values, int size);
+    double (*max)(const double *values, int size);
+    double (*squaredDeviation)(const double *values, int size, double mean);  // Suma de (x - mean)^2
+    double (*dot)(const double *values, const double *others, int size);
+    void (*scale)(double *values, int size, double factor);
+    void (*add)(double *values, int size, double addend);
+    int (*countAbove)(const double *values, int size, double threshold);
+} NumberKernels;
+
+typedef struct
+{
+    const char *text;  // Inicio de la linea, no termina en '\0'
+    size_t length;
+    int number;        // Numero de la linea en el texto original
+} Line;
+
+// Texto que crece a medida que se le agregan caracteres, usado para serializar. Si falta memoria queda en failed
+// y no se le agrega nada mas
+typedef struct
+{
+    const DictionaryAllocator *allocator;
+    char *text;
+    size_t length;
+    size_t capacity;
+    int failed;
+} Buffer;
+
+// Pila de marcos para recorrer los valores anidados sin recursion, asi el stack que se usa no depende de la
+// profundidad. Los primeros marcos caben en local y los demas se piden al allocator
+typedef struct
+{
+    const DictionaryAllocator *allocator;
+    char *frames;
+    size_t frameSize;
+    int count;
+    int capacity;
+    union
+    {
+        char bytes[FRAME_STACK_BYTES];
+        void *pointer;  // Alinea los marcos
+        double number;
+        long long integer;
+    } local;
+} FrameStack;
+
+// Marco de copyTree: un diccionario, un arreglo de diccionarios o una tabla que se esta copiando
+typedef struct
+{
+    char kind;            // 'd' diccionario, 'a' arreglo de diccionarios o 'c' tabla
+    int share;            // 'd': si al terminar la copia se comparte, ver setInterning
+    const void *source;   // Dictionary o Array original
+    void *target;         // Dictionary o Array nuevo
+    void **slot;          // Donde se guarda la copia, o NULL si al terminar se agrega como elemento con la clave key
+    const char *key;
+    const Element *next;  // 'd': siguiente elemento por copiar
+    Element *last;        // 'd': ultimo elemento copiado
+    int index;            // 'a': siguiente diccionario por copiar, 'c': siguiente celda por copiar
+} CopyFrame;
+
+// Marco de serializeDictionary: un diccionario, un arreglo de diccionarios o tabla, o una fila de una tabla
+typedef struct
+{
+    char kind;            // 'd' diccionario, 'a' arreglo o 'r' fila
+    int cache;
+    const void *value;    // Dictionary, Array o Table
+    const Element *next;  // 'd': siguiente elemento
+    int index;            // 'a': siguiente elemento, 'r': siguiente columna
+    int row;              // 'r': fila de la tabla
+    size_t start;         // 'd': donde empieza su json en el texto
+} SerializeFrame;
+
+// Marco de parseJson: un diccionario o un arreglo de diccionarios que se esta leyendo
+typedef struct
+{
+    char kind;               // 'd' diccionario o 'a' arreglo de diccionarios
+    char *position;          // parseJson: donde sigue el json del marco
+    int size;                // Cantidad de miembros o elementos, o lugares de array mientras parseJson lo lee
+    int next;                // Siguiente miembro o elemento por leer
+    Dictionary *dictionary;  // 'd': el diccionario que se llena, 'a': al que se agrega el arreglo
+    Dictionary **array;      // 'a': los diccionarios ya leidos
+    char key[80];            // 'd': clave del miembro que se esta leyendo, 'a': clave del arreglo
+    const ProjectionNode *projection;  // Claves que se guardan del diccionario o de los del arreglo, NULL si todas
+    const char **keys;       // 'd': tabla de hash de las claves ya leidas, que apuntan al json
+    int keyCapacity;
+} ParseFrame;
+
+// Lectura de un registro del log o del snapshot de un store
+typedef struct
+{
+    const char *data;
+    size_t length;
+    size_t position;
+} Reader;
+
+// Archivos que guardan un diccionario, ver openDictionaryStore. Cada cambio se agrega como registro a pending, y el
+// hilo flusher lo pasa a writing, lo escribe al log y hace fsync, asi los que llegan mientras tanto se escriben todos
+// juntos con el siguiente fsync. Los campos marcados con lock solo se usan con el lock tomado
+typedef struct dictionaryStore
+{
+    char *directory;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;                 // Hay registros nuevos, alguien espera en syncDictionaryStore o se cierra
+    pthread_cond_t synced;                  // Avanzo durable o fallo una escritura
+    pthread_t flusher;
+    Buffer pending;                         // lock: registros que falta escribir
+    Buffer writing;                         // Registros que el flusher esta escribiendo
+    unsigned long long appended;            // lock: bytes de registros agregados desde que se abrio
+    unsigned long long durable;             // lock: de ellos, los que ya estan en disco
+    int waiting;                            // lock: hilos esperando en syncDictionaryStore
+    int closing;                            // lock
+    int failed;                             // lock: fallo una escritura o no hubo memoria para un registro
+    int logFd;                              // lock: log en el que escribe el flusher
+    unsigned long long generation;          // Cada compactacion empieza un log nuevo, con la siguiente generacion.
+                                            // Cambia con el lock tomado
+    int rotating;                           // lock: si el flusher todavia no empezo el log de generation
+    unsigned long long rotateAt;            // lock: los bytes de appended que van antes de ese log
+    unsigned long long snapshotGeneration;  // Primer log que no esta en el snapshot, los anteriores ya se borraron
+    size_t logBytes;                        // Largo del log actual
+    size_t compactAt;                       // Largo del log con el que se compacta
+    size_t compactBytes;
+    int syncMilliseconds;
+    int compacting;                         // Si hay un hilo de compactacion al que no se le hizo join
+    int compacted;                          // lock: si ese hilo ya termino
+    pthread_t compactor;
+} DictionaryStore;
+
+typedef struct
+{
+    Line *lines;
+    Dictionary **results;
+    int size;
+    int next;  // Siguiente linea a procesar, compartida por todos los hilos
+} ParseJob;
+
+typedef struct
+{
+    Dictionary **dictionaries;
+    char **results;
+    int size;
+    int next;  // Siguiente diccionario a procesar, compartido por todos los hilos
+} SerializeJob;
+
+// Contadores de un hilo. Cada hilo solo escribe los suyos, asi no tiene que sincronizarse con los demas
+typedef struct threadStats
+{
+    DictionaryStats stats;
+    struct threadStats *next;
+    struct threadStats *prev;
+} ThreadStats;
+
+__thread ThreadStats *localStats;      // Contadores del hilo actual
+ThreadStats *allStats;                 // Contadores de todos los hilos vivos
+DictionaryStats retiredStats;          // Suma de los contadores de los hilos que ya terminaron
+pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t statsOnce = PTHREAD_ONCE_INIT;
+pthread_key_t statsKey;
+
+// Slab del pool, del que se cortan bloques de un tamano. Esta alineado a POOL_SLAB_BYTES, asi el slab de un bloque
+// se encuentra con su direccion, y esta estructura ocupa sus primeros bloques
+typedef struct poolSlab
+{
+    struct poolSlab *next;      // Siguiente slab con bloques libres del mismo tamano
+    struct poolSlab *nextSlab;  // Siguiente slab pedido, no se liberan
+    int c;                      // Tamano de sus bloques, 16 << c bytes
+    int free;                   // Bloques libres
+    int listed;                 // Si esta en la lista de slabs con bloques libres
+    unsigned long long bits[POOL_SLAB_BYTES / 16 / BITS_PER_WORD];  // Bit i encendido si el bloque i esta libre
+} PoolSlab;
+
+// Bloques libres de un hilo, por tamano. Se usan sin sincronizar: solo se va al pool compartido cuando no queda
+// ninguno, para pedir POOL_BATCH, o cuando hay 2 * POOL_BATCH, para devolver los POOL_BATCH liberados hace mas tiempo
+typedef struct
+{
+    void *blocks[POOL_CLASSES][2 * POOL_BATCH];  // Se entregan y se agregan al final
+    int counts[POOL_CLASSES];
+    int registered;                              // Si se le devuelven al pool compartido cuando termina el hilo
+} PoolCache;
+
+// Los elementos, las estructuras Array y los numeros y booleanos del allocator por defecto se piden al pool en lugar
+// de a malloc. Los bloques libres no se encadenan sino que se marcan en el slab, asi pedir y liberar bloques no toca
+// su memoria, y al pedirlos se toman en el orden en que estan en el slab, asi lo que se crea junto queda junto en
+// memoria aunque antes se hayan liberado bloques en cualquier orden. Se puede desactivar con -DDICTIONARY_NO_POOL
+__thread PoolCache poolCache;
+PoolSlab *freeSlabs[POOL_CLASSES];  // Slabs con bloques libres de cada tamano
+PoolSlab *poolSlabs;                // Todos los slabs
+pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;  // Protege los slabs
+pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+pthread_key_t poolKey;
+
+// Formas que agregan una clave a otra, por hash de la forma y la clave, para encontrarlas sin tomar shapesLock. Cada una
+// tiene una referencia a su forma, asi no se libera mientras este en la cache, y su forma a su vez tiene una al padre
+typedef struct
+{
+    Shape *shapes[SHAPE_CACHE_SIZE];
+    int registered;  // Si se sueltan sus referencias cuando termina el hilo
+} ShapeCache;
+
+__thread ShapeCache shapeCache;
+pthread_once_t shapeCacheOnce = PTHREAD_ONCE_INIT;
+pthread_key_t shapeCacheKey;
+
+unsigned int crcTable[256];  // Tabla del CRC-32C con el que se verifican los registros de los stores
+pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+double scalarSum(const double *values, int size);
+double scalarMin(const double *values, int size);
+double scalarMax(const double *values, int size);
+double scalarSquaredDeviation(const double *values, int size, double mean);
+double scalarDot(const double *values, const double *others, int size);
+void scalarScale(double *values, int size, double factor);
+void scalarAdd(double *values, int size, double addend);
+int scalarCountAbove(const double *values, int size, double threshold);
+
+const NumberKernels scalarKernels = {scalarSum, scalarMin, scalarMax, scalarSquaredDeviation, scalarDot, scalarScale,
+                                     scalarAdd, scalarCountAbove};
+
+#ifdef NUMBER_KERNELS_SIMD
+double sse2Sum(const double *values, int size);
+double sse2Min(const double *values, int size);
+double sse2Max(const double *values, int size);
+double sse2SquaredDeviation(const double *values, int size, double mean);
+double sse2Dot(const double *values, const double *others, int size);
+void sse2Scale(double *values, int size, double factor);
+void sse2Add(double *values, int size, double addend);
+int sse2CountAbove(const double *values, int size, double threshold);
+double avx2Sum(const double *values, int size);
+double avx2Min(const double *values, int size);
+double avx2Max(const double *values, int size);
+double avx2SquaredDeviation(const double *values, int size, double mean);
+double avx2Dot(const double *values, const double *others, int size);
+void avx2Scale(double *values, int size, double factor);
+void avx2Add(double *values, int size, double addend);
+int avx2CountAbove(const double *values, int size, double threshold);
+
+const NumberKernels sse2Kernels = {sse2Sum, sse2Min, sse2Max, sse2SquaredDeviation, sse2Dot, sse2Scale, sse2Add,
+                                   sse2CountAbove};
+const NumberKernels avx2Kernels = {avx2Sum, avx2Min, avx2Max, avx2SquaredDeviation, avx2Dot, avx2Scale, avx2Add,
+                                   avx2CountAbove};
+#endif
+
+const NumberKernels *numberKernels = &scalarKernels;  // Version elegida por chooseNumberKernels
+pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+void *mallocAllocate(size_t size, void *context);
+void *mallocReallocate(void *pointer, size_t size, void *context);
+void mallocRelease(void *pointer, void *context);
+
+const DictionaryAllocator mallocAllocator = {mallocAllocate, mallocReallocate, mallocRelease, NULL};
+const DictionaryAllocator *defaultAllocator = &mallocAllocator;  // Allocator de los diccionarios nuevos
+const char nullValue = 0;  // Valor de todos los elementos null, asi no se reserva memoria para ellos
+Shape rootShape = {NULL, "", 0, 1, 1, NULL, NULL};  // Forma sin claves, su referencia inicial hace que nunca se libere
+unsigned long long nextShapeId = 2;
+pthread_mutex_t shapesLock = PTHREAD_MUTEX_INITIALIZER;  // Protege el arbol de formas, que comparten todos los hilos
+int interning = 0;                     // Si los diccionarios anidados se comparten, ver setInterning
+Dictionary **internBuckets;            // Diccionarios compartidos por hash, encadenados por nextInterned
+unsigned long internCapacity, internCount;
+pthread_mutex_t internLock = PTHREAD_MUTEX_INITIALIZER;  // Protege la tabla y las referencias de los diccionarios compartidos
+int maxJsonDepth = 0;                  // Limites del json que se lee, ver setJsonLimits
+size_t maxJsonLength = 0;
+
+void *allocate(const DictionaryAllocator *allocator, size_t size);
+void *reallocate(const DictionaryAllocator *allocator, void *pointer, size_t size);
+void release(const DictionaryAllocator *allocator, void *pointer);
+void *allocateBlock(const DictionaryAllocator *allocator, size_t size);
+void releaseBlock(const DictionaryAllocator *allocator, void *pointer, size_t size);
+int poolClass(size_t size);
+void createPoolKey();
+void registerPool(PoolCache *cache);
+int refillPool(PoolCache *cache, int c);
+void returnBlocks(void **blocks, int count);
+void retirePool(void *cache);
+void createStatsKey();
+void retireStats(void *stats);
+ThreadStats *threadStats();
+void statsAdd(size_t field, long long n);
+void statsMax(size_t field, long long n);
+long long statsClock();
+void addStats(DictionaryStats *total, const DictionaryStats *stats);
+void valueBytes(char type, const void *value, DictionaryUsage *usage);
+void addNestedUsage(char type, const void *value, DictionaryUsage *usage);
+void measureArray(Array *array);
+void countElement(const Element *element, int sign);
+void addUsage(const Dictionary *dictionary, DictionaryUsage *usage);
+Element *lookupElement(const Dictionary *dictionary, const char *key, long long *comparisons);
+Element *findElement(const Dictionary *dictionary, const char *key);
+void initFrames(FrameStack *stack, const DictionaryAllocator *allocator, size_t frameSize);
+void *pushFrame(FrameStack *stack);
+void *topFrame(const FrameStack *stack);
+void popFrame(FrameStack *stack);
+void freeFrames(FrameStack *stack);
+void freeArrayElements(const DictionaryAllocator *allocator, char type, void *elements, int size);
+void pendDictionary(Dictionary **pending, Dictionary *dictionary);
+void pendArray(Array **pending, Array *array);
+void pendValue(const DictionaryAllocator *allocator, Dictionary **dictionaries, Array **arrays, char type, void *value);
+void freeTree(const DictionaryAllocator *allocator, Dictionary *dictionaries, Array *arrays);
+void freeValue(const DictionaryAllocator *allocator, char type, void *value);
+void freeElement(const DictionaryAllocator *allocator, Element *element);
+void releaseLeaf(const DictionaryAllocator *allocator, char type, void *value);
+Element *newElement(const DictionaryAllocator *allocator, const char *key, char type, void *value);
+double *copyNumber(const DictionaryAllocator *allocator, const double *number);
+Bool *copyBool(const DictionaryAllocator *allocator, const Bool *value);
+char *copyString(const DictionaryAllocator *allocator, const char *s);
+Array *newArray(const DictionaryAllocator *allocator, void *elements, int size, char type);
+void *allocateArray(const DictionaryAllocator *allocator, int size, size_t elementSize);
+double *copyNumberArray(const DictionaryAllocator *allocator, int size, double value[size]);
+int wordCount(int size);
+Bool bitValue(const unsigned long long *bits, int index);
+unsigned long long *packBoolArray(const DictionaryAllocator *allocator, int size, Bool value[size]);
+Bool *unpackBoolArray(const DictionaryAllocator *allocator, int size, const unsigned long long *bits);
+unsigned long long *copyBits(const DictionaryAllocator *allocator, int size, const unsigned long long *bits);
+Element *findBoolArray(const Dictionary *dictionary, const char *key);
+Element *findNumberArray(const Dictionary *dictionary, const char *key);
+void chooseNumberKernels();
+const NumberKernels *kernels();
+int combineBoolArrays(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey, char operation);
+char **copyStringArray(const DictionaryAllocator *allocator, int size, char *value[size]);
+Dictionary **copyDictionaryArray(const DictionaryAllocator *allocator, int size, Dictionary *value[size]);
+void *copyValue(const DictionaryAllocator *allocator, char type, const void *value);
+Array *copyArrayShell(const DictionaryAllocator *allocator, const Array *array);
+int hasDictionaries(char type, const void *value);
+int deliverCopy(FrameStack *stack, void **slot, const char *key, char type, void *copy);
+int beginCopy(FrameStack *stack, char type, const void *value, void **slot, const char *key, int fresh);
+int continueCopy(FrameStack *stack, CopyFrame *frame);
+void *copyTree(const DictionaryAllocator *allocator, char type, const void *value, int fresh);
+size_t cellSize(char type);
+void *cellValue(const Table *table, int column, int row);
+int sameShape(int size, Dictionary *value[size]);
+Table *newTable(const DictionaryAllocator *allocator, int columns);
+int allocateColumn(const DictionaryAllocator *allocator, Table *table, int column, int rows);
+void releaseTable(const DictionaryAllocator *allocator, Table *table);
+void freeTable(const DictionaryAllocator *allocator, Table *table, int rows);
+int setCell(const DictionaryAllocator *allocator, Table *table, int column, int row, const void *value);
+Table *tableFromDictionaries(const DictionaryAllocator *allocator, int size, Dictionary *value[size]);
+Dictionary *dictionaryFromRow(const DictionaryAllocator *allocator, const Table *table, int row);
+Dictionary **dictionariesFromTable(const DictionaryAllocator *allocator, const Table *table, int rows);
+Dictionary *copyDictionary(const DictionaryAllocator *allocator, const Dictionary *dictionary);
+Dictionary *storeDictionary(const DictionaryAllocator *allocator, const Dictionary *dictionary);
 void addElement(Dictionary *dictionary, Element *newp);
+Element *unlinkElement(Dictionary *dictionary, const char *key);
+int putElement(Dictionary *dictionary, Element *newp);
+Shape *shapeTransition(Shape *shape, const char *key);
+Shape *findTransition(Shape *shape, const char *key);
+void createShapeCacheKey();
+void retireShapeCache(void *cache);
+void referenceShape(Shape *shape);
+void unreferenceShape(Shape *shape);
+void dropShape(Shape *shape);
+void releaseShape(Dictionary *dictionary);
+void shareShape(Dictionary *dictionary, Shape *shape);
+int extendShape(Dictionary *dictionary, Element *newp);
+Element *accessElement(const Dictionary *dictionary, DictionaryAccessor *accessor);
+IndexNode *newIndexNode(const DictionaryAllocator *allocator, int leaf);
+void freeIndexNode(const DictionaryAllocator *allocator, IndexNode *node);
+void addIndexUsage(const IndexNode *node, DictionaryUsage *usage);
+int indexPosition(const IndexNode *node, const char *key, long long *comparisons);
+Element *indexFind(const IndexNode *node, const char *key, long long *comparisons);
+int indexReplace(IndexNode *node, Element *element);
+int splitIndexChild(const DictionaryAllocator *allocator, IndexNode *parent, int i);
+int indexInsert(Dictionary *dictionary, Element *element);
+void mergeIndexChildren(const DictionaryAllocator *allocator, IndexNode *parent, int i);
+void fillIndexChild(const DictionaryAllocator *allocator, IndexNode *parent, int i);
+void indexDelete(const DictionaryAllocator *allocator, IndexNode *node, const char *key);
+void indexRemove(Dictionary *dictionary, const char *key);
+PrefixNode *newPrefixNode(const DictionaryAllocator *allocator, const Element *owner, int start, Element *element);
+void freePrefixNode(const DictionaryAllocator *allocator, PrefixNode *node);
+void addPrefixUsage(const PrefixNode *node, DictionaryUsage *usage);
+PrefixNode **findPrefixChild(PrefixNode *node, char c);
+PrefixNode *prefixSubtree(const PrefixNode *root, const char *prefix, int exact, long long *comparisons);
+int prefixInsert(Dictionary *dictionary, Element *element);
+void prefixReplace(PrefixNode *root, const Element *old, Element *element);
+const Element *anyPrefixElement(const PrefixNode *node);
+void mergePrefixChild(const DictionaryAllocator *allocator, PrefixNode *node);
+void prefixRemove(Dictionary *dictionary, const Element *element);
+int visitPrefixNode(const PrefixNode *node, int (*callback)(const DictionaryEntry *entry, void *data), void *data);
+void fillEntry(const Element *element, DictionaryEntry *result);
+void fillValue(const char *key, char type, const void *value, DictionaryEntry *result);
+unsigned long long mixHash(unsigned long long x);
+unsigned long long hashText(const char *s);
+unsigned long long hashNumbers(const double *values, int size, unsigned long long hash);
+unsigned long long hashValue(char type, const void *value);
+unsigned long long hashElement(const char *key, char type, const void *value);
+unsigned long long hashArray(const Array *array);
+void rehashArray(Dictionary *dictionary, Element *element);
+int identicalDictionaries(const Dictionary *dictionary, const Dictionary *other);
+int identicalValues(char type, const void *value, const void *other);
+int identicalArrays(const Array *array, const Array *other);
+int identicalRows(const Array *array, int row, const Array *other, int otherRow);
+int isShared(const Dictionary *dictionary);
+Dictionary *findInterned(const DictionaryAllocator *allocator, const Dictionary *dictionary);
+void addInterned(Dictionary *dictionary);
+void removeInterned(Dictionary *dictionary);
+Dictionary *findShared(const DictionaryAllocator *allocator, const Dictionary *dictionary);
+Dictionary *shareCopy(Dictionary *copy);
+int equalValues(char type, const void *value, const void *other);
+int equalArrays(const Array *array, const Array *other);
+int equalRows(const Array *array, int row, const Array *other, int otherRow);
+int equalTableRows(const Table *table, int row, const Table *other, int otherRow);
+int equalRowDictionary(const Table *table, int row, const Dictionary *dictionary);
+int countElements(const Dictionary *dictionary);
+Element *matchElement(const Dictionary *dictionary, const Element *hint, const char *key);
+int appendElement(Dictionary *dictionary, Element **last, Element *newp);
+void descendLeft(DictionaryCursor *cursor, const IndexNode *node);
+void seekCursor(DictionaryCursor *cursor, const IndexNode *root, const char *from);
 int setValue(Dictionary *dictionary, const char *key, const void *value, char type);
 int setArray(Dictionary *dictionary, const char *key, int size, void *value, char type);
-char *concat(char *s1, char *s2);
+int initBuffer(Buffer *buffer, const DictionaryAllocator *allocator, size_t capacity);
+void failBuffer(Buffer *buffer);
+void appendBytes(Buffer *buffer, const char *s, size_t length);
+void appendText(Buffer *buffer, const char *s);
+void invalidateJson(Dictionary *dictionary);
+void releaseJson(const Dictionary *dictionary);
+void releaseNestedJson(char type, const void *value);
 int isNumber(char *str);
-char **split(char *str, int *size);
-int keyExists(const char *key, const Dictionary *dictionary);
-
-// Muestra un mensaje de error cuando no hay memoria disponible y aborta la ejecucin
-void errorMessage()
+char *skipValue(char *s);
+int growParsedKeys(const DictionaryAllocator *allocator, ParseFrame *frame);
+int addParsedKey(const DictionaryAllocator *allocator, ParseFrame *frame, const char *start);
+ProjectionNode *newProjectionNode(ProjectionNode *root, ProjectionNode *parent, const char *key, int length);
+int addProjectionPath(ProjectionNode *root, const char *path);
+const ProjectionNode *findProjection(const ProjectionNode *node, const char *key);
+Dictionary *parseDictionary(const DictionaryAllocator *allocator, const char *json, size_t len, const ProjectionNode *projection);
+int parseJson(const DictionaryAllocator *allocator, const char *json, size_t len, const ProjectionNode *projection, Dictionary **result);
+int beginParse(FrameStack *stack, char *s, const ProjectionNode *projection, int validate);
+int continueParse(FrameStack *stack, ParseFrame *frame, Dictionary **result);
+int parseMember(FrameStack *stack, ParseFrame *frame, char *s);
+int parseArray(FrameStack *stack, ParseFrame *frame, char *s, const ProjectionNode *projection);
+int parseScalarArray(ParseFrame *frame, char *s, const DictionaryAllocator *allocator);
+int finishDictionaryArray(FrameStack *stack, ParseFrame *frame);
+int finishDictionary(FrameStack *stack, ParseFrame *frame, Dictionary **result);
+void releaseParseFrame(const DictionaryAllocator *allocator, ParseFrame *frame);
+void serializeDictionary(Buffer *buffer, const Dictionary *dictionary, int cache);
+void beginSerialize(Buffer *buffer, FrameStack *stack, char type, const void *value, int cache);
+void continueSerialize(Buffer *buffer, FrameStack *stack, SerializeFrame *frame);
+void serializeValue(Buffer *buffer, char type, const void *value);
+int threadCount(int threads);
+void runInParallel(void *(*worker)(void *), void *job, int threads);
+int splitLines(const char *text, size_t len, Line **lines);
+void *parseLinesWorker(void *job);
+void parseLines(Line *lines, int size, Dictionary **results, int threads);
+char *readAll(int fd, size_t *len);
+void *serializeWorker(void *job);
+void serializeDictionaries(Dictionary **dictionaries, int size, char **results, int threads);
+int writeAll(int fd, const char *text, size_t len);
+void encodeKey(Buffer *buffer, const char *key);
+void encodeString(Buffer *buffer, const char *s, size_t length);
+void encodeValue(Buffer *buffer, char type, const void *value);
+void beginEncode(Buffer *buffer, FrameStack *stack, char type, const void *value);
+void continueEncode(Buffer *buffer, FrameStack *stack, SerializeFrame *frame);
+int readBytes(Reader *reader, void *result, size_t length);
+const char *skipBytes(Reader *reader, size_t length);
+int readKey(Reader *reader, char *key);
+int decodeMembers(Reader *reader, Dictionary *dictionary, unsigned int count);
+int beginDecode(FrameStack *stack, Reader *reader);
+int continueDecode(FrameStack *stack, ParseFrame *frame, Reader *reader);
+int decodeMember(FrameStack *stack, ParseFrame *frame, Reader *reader);
+int decodeArray(FrameStack *stack, ParseFrame *frame, Reader *reader);
+void createCrcTable(void);
+unsigned int checksum(const char *data, size_t length);
+char *storePath(const DictionaryStore *store, const char *name, unsigned long long generation);
+int openStoreFile(const DictionaryStore *store, const char *name, unsigned long long generation, int flags);
+void unlinkStoreFile(const DictionaryStore *store, const char *name, unsigned long long generation);
+int syncDirectory(const char *directory);
+int createLog(DictionaryStore *store, unsigned long long generation);
+int replayLog(DictionaryStore *store, Dictionary *dictionary, unsigned long long generation, size_t *valid);
+int applyRecord(Dictionary *dictionary, Reader *reader);
+unsigned long long loadSnapshot(DictionaryStore *store, Dictionary *dictionary);
+int beginRecord(DictionaryStore *store, char operation, const char *key, size_t *start);
+void endRecord(Dictionary *dictionary, size_t start);
+void logElement(Dictionary *dictionary, const Element *element, char operation);
+void logRemoval(Dictionary *dictionary, const char *key);
+void *flushStore(void *argument);
+int startCompaction(Dictionary *dictionary, int wait);
+void *compactStore(void *argument);
+void closeStore(DictionaryStore *store);
+void releaseStore(DictionaryStore *store);
+
+// Funciones por defecto para la memoria dinamica
+void *mallocAllocate(size_t size, void *context)
 {
-    fprintf(stderr, "Error: No hay memoria...\n");
-    exit(1);
+    (void) context;
+    return malloc(size);
 }
 
-// Creates a new empty dictionary
-Dictionary *newDictionary()
+void *mallocReallocate(void *pointer, size_t size, void *context)
 {
-    Dictionary *d;
-    if ((d = (Dictionary *) malloc(sizeof(Dictionary))) == NULL)
-        errorMessage();
-
-    d->first = NULL;
-    return d;
+    (void) context;
+    return realloc(pointer, size);
 }
 
-// Hace free a un elemento de un diccionario
-void freeElement(Element *element)
+void mallocRelease(void *pointer, void *context)
 {
-    if (element->type == 'n' || element->type == 'b' || element->type == 's')
-        free(element->value);
-    else if (element->type == 'd')
-        freeDictionary(element->value);
-    else if (element->type == 'a')
-    {
-        int arrayType = ((Array *) element->value)->type;
+    (void) context;
+    free(pointer);
+}
 
-        // Si es un arreglo numrico o booleano simplemente se le hace free al arreglo de elementos
-        if (arrayType == 'n' || arrayType == 'b')
-            free(((Array *) element->value)->elements);
-        // En cambio si es un arreglo de strings o diccionarios se le hace free a cada uno de los elementos
-        // Porque fueron creados con memoria dinmica
-        else if (arrayType == 's')
-        {
-            int i;
-            for(i = 0; i < ((Array *) element->value)->size; i++)
-                    free(((char **) ((Array *) element->value)->elements)[i]);
-        }
-        else if (arrayType == 'd')
-        {
-            int i;
-            for(i = 0; i < ((Array *) element->value)->size; i++)
-                freeDictionary(((Dictionary **) ((Array *) element->value)->elements)[i]);
-        }
+// Toda la memoria dinamica de la libreria se pide con estas funciones, para poder contarla
+void *allocate(const DictionaryAllocator *allocator, size_t size)
+{
+    STATS_ADD(mallocs, 1);
+    return allocator->allocate(size, allocator->context);
+}
 
-        free(element->value); // Se le hace free a la estructura Array
-    }
-    free(element);
+void *reallocate(const DictionaryAllocator *allocator, void *pointer, size_t size)
+{
+    STATS_ADD(reallocs, 1);
+    return allocator->reallocate(pointer, size, allocator->context);
 }
 
-// Releases the memory of the given dictionary
-void freeDictionary(Dictionary *dictionary)
+void release(const DictionaryAllocator *allocator, void *pointer)
 {
-    if (!dictionary)
+    if (!pointer)
         return;
 
-    Element *aux;
-    for(; dictionary->first; dictionary->first = aux)
+    STATS_ADD(frees, 1);
+    allocator->release(pointer, allocator->context);
+}
+
+// Los bloques chicos del allocator por defecto se piden con estas funciones, que los sacan del pool del hilo.
+// size debe ser el mismo al pedir y liberar un bloque
+void *allocateBlock(const DictionaryAllocator *allocator, size_t size)
+{
+#ifndef DICTIONARY_NO_POOL
+    if (allocator == &mallocAllocator && size <= (size_t) 16 << (POOL_CLASSES - 1))
     {
-        aux = dictionary->first->next;
-        freeElement(dictionary->first);
-    }
+        PoolCache *cache = &poolCache;
+        int c = poolClass(size);
+
+        if (!cache->counts[c] && !refillPool(cache, c))
+            return NULL;
 
-    free(dictionary);
+        STATS_ADD(pooledBlocks, 1);
+        return cache->blocks[c][--cache->counts[c]];
+    }
+#endif
+    return allocate(allocator, size);
 }
 
-// Removes the given key. Returns 1 if it was able to do it otherwise returns 0
-int removeElement(Dictionary *dictionary, const char *key)
+void releaseBlock(const DictionaryAllocator *allocator, void *pointer, size_t size)
 {
-    if(!dictionary)
-        return 0;
+#ifndef DICTIONARY_NO_POOL
+    if (allocator == &mallocAllocator && size <= (size_t) 16 << (POOL_CLASSES - 1))
+    {
+        PoolCache *cache = &poolCache;
+        int c = poolClass(size);
 
-    Element *aux, *prev = NULL;
+        if (!pointer)
+            return;
 
-    for(aux = dictionary->first; aux; aux = aux->next)
-    {
-        if (!strcmp(aux->key, key))
+        if (!cache->registered)
+            registerPool(cache);
+
+        if (cache->counts[c] == 2 * POOL_BATCH) // Devuelve los liberados hace mas tiempo y deja los otros
         {
-            if(!prev)
-                dictionary->first = aux->next;
-            else
-                prev->next = aux->next;
-            freeElement(aux);
-            return 1;
+            returnBlocks(cache->blocks[c], POOL_BATCH);
+            memmove(cache->blocks[c], cache->blocks[c] + POOL_BATCH, sizeof(void *) * POOL_BATCH);
+            cache->counts[c] = POOL_BATCH;
         }
-        prev = aux;
+        cache->blocks[c][cache->counts[c]++] = pointer;
+        return;
     }
-
-    return 0;
+#endif
+    release(allocator, pointer);
 }
 
-// Crea un nuevo elemento de clave key, tipo type y valor value
-Element *newElement(const char *key, char type, void *value)
+// Retorna el tamano de bloque del pool en el que cabe size
+int poolClass(size_t size)
 {
-    Element *newp;
-    if ((newp = (Element *) malloc(sizeof(Element))) == NULL)  // Crea un nuevo elemento en el diccionario
-        errorMessage();
-
-    strcpy(newp->key, key);
-    newp->type = type;
-    newp->value = value;
-    newp->next = NULL;
-    return newp;
+    int c = 0;
+    while ((size_t) 16 << c < size)
+        c++;
+    return c;
 }
 
-// Retorna una nueva direccin de memoria que contendr una copia de number
-double *copyNumber(const double *number)
+void createPoolKey()
 {
-    double *copy;
-    if ((copy = (double *) malloc(sizeof(double))) == NULL) // Asigna el espacio de memoria donde se guardar el valor
-        errorMessage();
-
-    *copy = *number;
-    return copy;
+    pthread_key_create(&poolKey, retirePool);
 }
 
-// Retorna una nueva direccin de memoria que contendr una copia de value
-Bool *copyBool(const Bool *value)
+// Hace que los bloques de la cache del hilo actual vuelvan al pool compartido cuando termina el hilo
+void registerPool(PoolCache *cache)
 {
-    Bool *copy;
-    if ((copy = (Bool *) malloc(sizeof(Bool))) == NULL) // Asigna el espacio de memoria donde se guardar el valor
-        errorMessage();
-
-    *copy = *value;
-    return copy;
+    pthread_once(&poolOnce, createPoolKey);
+    pthread_setspecific(poolKey, cache);
+    cache->registered = 1;
 }
 
-// Retorna una copia del string s
-char *copyString(const char *s)
+// Llena la cache vacia del tamano c con hasta POOL_BATCH bloques libres de un slab, pidiendo uno nuevo si no hay.
+// Retorna 1 si pudo hacerlo y 0 si no hay memoria
+int refillPool(PoolCache *cache, int c)
 {
-    char *str;
-    if ((str = (char *) malloc(sizeof(char) * (strlen(s) + 1))) == NULL) // Asigna el espacio suficiente para guardar el string
-        errorMessage();
-    strcpy(str, s);
-    return str;
-}
+    int shift = 4 + c, first, word, count, i;
+    PoolSlab *slab;
+    unsigned long long bits;
 
-// Crea un nuevo arreglo de la estructura Array de tipo type cuyos elementos sern los de elements
-Array *newArray(void *elements, int size, char type)
-{
-    Array *newp;
+    if (!cache->registered)
+        registerPool(cache);
+
+    pthread_mutex_lock(&poolLock);
+    if (!(slab = freeSlabs[c]))
+    {
+        STATS_ADD(mallocs, 1);
+        if (posix_memalign((void **) &slab, POOL_SLAB_BYTES, POOL_SLAB_BYTES))
+        {
+            pthread_mutex_unlock(&poolLock);
+            return 0;
+        }
 
-    if ((newp = (Array *) malloc(sizeof(Array))) == NULL) // Asigna el espacio de memoria donde se guardar el arreglo
-        errorMessage();
+        // Los bloques que ocupa la estructura del slab no se marcan como libres
+        memset(slab, 0, sizeof(PoolSlab));
+        first = (sizeof(PoolSlab) + (1 << shift) - 1) >> shift;
+        for(i = first; i < POOL_SLAB_BYTES >> shift; i++)
+            slab->bits[i / BITS_PER_WORD] |= 1ULL << (i % BITS_PER_WORD);
+        slab->c = c;
+        slab->free = (POOL_SLAB_BYTES >> shift) - first;
+        slab->listed = 1;
+        slab->nextSlab = poolSlabs;
+        poolSlabs = freeSlabs[c] = slab;
+    }
 
-    newp->elements = elements;
-    newp->type = type;
-    newp->size = size;
-    return newp;
+    // Se entregan desde el final de la cache, asi que se guardan al reves para entregarlos en orden de direccion
+    count = slab->free < POOL_BATCH ? slab->free : POOL_BATCH;
+    cache->counts[c] = count;
+    for(word = 0; count; word++)
+        for(bits = slab->bits[word]; bits && count; bits &= bits - 1)
+        {
+            cache->blocks[c][--count] = (char *) slab + ((size_t) (word * BITS_PER_WORD + __builtin_ctzll(bits)) << shift);
+            slab->bits[word] &= ~(bits & -bits);
+        }
+
+    if (!(slab->free -= cache->counts[c]))
+    {
+        freeSlabs[c] = slab->next;
+        slab->listed = 0;
+    }
+    pthread_mutex_unlock(&poolLock);
+    return 1;
 }
 
-// Crea una copia del arreglo numrico
-double *copyNumberArray(int size, double value[size])
+// Marca como libres count bloques en sus slabs
+void returnBlocks(void **blocks, int count)
 {
-    double *arrayElements;
+    PoolSlab *slab;
+    size_t block;
+    int i;
 
-    if ((arrayElements = (double *) malloc(sizeof(double) * size)) == NULL) // Asigna el espacio de memoria para guardar los elementos
-        errorMessage();
+    pthread_mutex_lock(&poolLock);
+    for(i = 0; i < count; i++)
+    {
+        slab = (PoolSlab *) ((size_t) blocks[i] & ~((size_t) POOL_SLAB_BYTES - 1));
+        block = ((size_t) blocks[i] & (POOL_SLAB_BYTES - 1)) >> (4 + slab->c);
+        slab->bits[block / BITS_PER_WORD] |= 1ULL << (block % BITS_PER_WORD);
+        slab->free++;
+        if (!slab->listed) // Va al principio, asi se vuelven a usar primero los bloques que se liberaron ultimo
+        {
+            slab->next = freeSlabs[slab->c];
+            freeSlabs[slab->c] = slab;
+            slab->listed = 1;
+        }
+    }
+    pthread_mutex_unlock(&poolLock);
+}
 
-    int i;
-    for(i = 0; i < size; i++)
-        arrayElements[i] = value[i]; // Copia los elementos
+// Se llama cuando termina un hilo, devuelve sus bloques libres a sus slabs
+void retirePool(void *cache)
+{
+    PoolCache *p = (PoolCache *) cache;
+    int c;
 
-    return arrayElements;
+    for(c = 0; c < POOL_CLASSES; c++)
+        returnBlocks(p->blocks[c], p->counts[c]);
+    memset(p, 0, sizeof(PoolCache));
 }
 
-// Crea una copia del arreglo booleano
-Bool *copyBoolArray(int size, Bool value[size])
+void createStatsKey()
 {
-    Bool *arrayElements;
+    pthread_key_create(&statsKey, retireStats);
+}
 
-    if ((arrayElements = (Bool *) malloc(sizeof(Bool) * size)) == NULL) // Asigna el espacio de memoria para guardar los elementos
-        errorMessage();
+// Se llama cuando termina un hilo, suma sus contadores a los de los hilos terminados
+void retireStats(void *stats)
+{
+    ThreadStats *t = (ThreadStats *) stats;
 
-    int i;
-    for(i = 0; i < size; i++)
-        arrayElements[i] = value[i]; // Copia los elementos
+    pthread_mutex_lock(&statsLock);
+    addStats(&retiredStats, &t->stats);
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        allStats = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    pthread_mutex_unlock(&statsLock);
 
-    return arrayElements;
+    free(t); // No se usa release para no contar la memoria de las estadisticas
 }
 
-// Crea una copia del arreglo de strings
-char **copyStringArray(int size, char *value[size])
+// Retorna los contadores del hilo actual, creandolos la primera vez. Retorna NULL si no hay memoria
+ThreadStats *threadStats()
 {
-    char **arrayElements;
+    if (localStats)
+        return localStats;
 
-    if ((arrayElements = (char **) malloc(sizeof(char *) * size)) == NULL) // Asigna el espacio de memoria para guardar el arreglo
-        errorMessage();
+    pthread_once(&statsOnce, createStatsKey);
 
-    int i;
-    for(i = 0; i < size; i++) // Copia los elementos
-        arrayElements[i] = copyString(value[i]);
+    ThreadStats *t;
+    if ((t = (ThreadStats *) calloc(1, sizeof(ThreadStats))) == NULL)
+        return NULL;
 
-    return arrayElements;
+    pthread_mutex_lock(&statsLock);
+    t->next = allStats;
+    if (allStats)
+        allStats->prev = t;
+    allStats = t;
+    pthread_mutex_unlock(&statsLock);
+
+    pthread_setspecific(statsKey, t);
+    return localStats = t;
 }
 
-// Crea una copia del arreglo de diccionarios
-Dictionary **copyDictionaryArray(int size, Dictionary *value[size])
+// Suma n al contador que esta en la posicion field de DictionaryStats.
+// Los otros hilos pueden leerlo mientras tanto, por eso se escribe de forma atomica aunque sin sincronizar
+void statsAdd(size_t field, long long n)
 {
-    Dictionary **arrayElements;
+    ThreadStats *t;
+    if (!(t = threadStats()))
+        return;
 
-    if ((arrayElements = (Dictionary **) malloc(sizeof(Dictionary *) * size)) == NULL) // Asigna el espacio de memoria para guardar el arreglo
-        errorMessage();
+    long long *counter = (long long *) ((char *) &t->stats + field);
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
 
-    int i;
-    for(i = 0; i < size; i++) // Copia los elementos
-        arrayElements[i] = copyDictionary(value[i]);
+// Guarda n en el contador que esta en la posicion field de DictionaryStats si es mayor a su valor
+void statsMax(size_t field, long long n)
+{
+    ThreadStats *t;
+    if (!(t = threadStats()))
+        return;
 
-    return arrayElements;
+    long long *counter = (long long *) ((char *) &t->stats + field);
+    if (n > *counter)
+        __atomic_store_n(counter, n, __ATOMIC_RELAXED);
 }
 
-// Crea una copia de un diccionario
-// En esta funcin no se hace uso de las funciones setNumber, setString, etc. con el fin de evitar tener que
-// Iterar tantas veces sobre el nuevo diccionario, pues ya se tiene un puntero hacia el ltimo elemento que se va agregando.
-Dictionary *copyDictionary(const Dictionary *dictionary)
+// Retorna el tiempo actual en nanosegundos
+long long statsClock()
 {
-    if (!dictionary)
-        return NULL;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
 
-    Dictionary *d = newDictionary();
-    Element *auxOriginal, *auxCopy, *newp;
-    // auxOriginal es un auxiliar usado con los elementos del diccionario original
-    // auxCopy es un auxiliar usado con los elementos del nuevo diccionario
+// Suma los contadores de stats a los de total, salvo los maximos que se comparan
+void addStats(DictionaryStats *total, const DictionaryStats *stats)
+{
+    long long *t = (long long *) total;
+    const long long *s = (const long long *) stats;
+    size_t i, max = offsetof(DictionaryStats, maxLookupComparisons) / sizeof(long long);
 
-    auxCopy = NULL;
-    for(auxOriginal = dictionary->first; auxOriginal; auxOriginal = auxOriginal->next)
+    for(i = 0; i < sizeof(DictionaryStats) / sizeof(long long); i++)
     {
-        int size;
-        void *value;
-        switch (auxOriginal->type)
-        {
-            case 'n':
-                newp = newElement(auxOriginal->key, auxOriginal->type, copyNumber(auxOriginal->value));
-                break;
-            case 'b':
-                newp = newElement(auxOriginal->key, auxOriginal->type, copyBool(auxOriginal->value));
-                break;
-            case 's':
-                newp = newElement(auxOriginal->key, auxOriginal->type, copyString(auxOriginal->value));
-                break;
-            case 'd':
-                newp = newElement(auxOriginal->key, auxOriginal->type, copyDictionary(auxOriginal->value));
-                break;
-            case 'a':
-                size = ((Array *) auxOriginal->value)->size;
-                value = ((Array *) auxOriginal->value)->elements;
-                switch (((Array *) auxOriginal->value)->type)
-                {
-                    case 'n':
-                        newp = newElement(auxOriginal->key, 'a', newArray(copyNumberArray(size, value), size, 'n'));
-                        break;
-                    case 'b':
-                        newp = newElement(auxOriginal->key, 'a', newArray(copyBoolArray(size, value), size, 'b'));
-                        break;
-                    case 's':
-                        newp = newElement(auxOriginal->key, 'a', newArray(copyStringArray(size, value), size, 's'));
-                        break;
-                    case 'd':
-                        newp = newElement(auxOriginal->key, 'a', newArray(copyDictionaryArray(size, value), size, 'd'));
-                        break;
-                }
-                break;
-        }
-        if (!auxCopy)
-        {
-            d->first = newp;
-            auxCopy = d->first;
-        }
-        else
-        {
-            auxCopy->next = newp;
-            auxCopy = auxCopy->next;
-        }
+        long long value = __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+        if (i != max)
+            t[i] += value;
+        else if (value > t[i])
+            t[i] = value;
     }
-
-    return d;
 }
 
-// Conecta el nuevo elemento al final de la lista de elementos del diccionario
-void addElement(Dictionary *dictionary, Element *newp)
+// Saves in result the counters of the whole library, added up over all the threads
+void getDictionaryStats(DictionaryStats *result)
 {
-    if(!dictionary->first)
-        dictionary->first = newp;
-    else
-    {
-        Element *aux;
-        for(aux = dictionary->first; aux->next; aux = aux->next);
-        aux->next = newp;
-    }
+    ThreadStats *t;
+
+    pthread_mutex_lock(&statsLock);
+    *result = retiredStats;
+    for(t = allStats; t; t = t->next)
+        addStats(result, &t->stats);
+    pthread_mutex_unlock(&statsLock);
 }
 
-// Generalizacion de las funciones setNumber, setBool, setString, setDictionary
-int setValue(Dictionary *dictionary, const char *key, const void *value, char type)
+// Suma a usage los bytes y bloques de memoria que ocupa un valor de tipo type, sin contar los diccionarios que contenga
+void valueBytes(char type, const void *value, DictionaryUsage *usage)
 {
-    if (!dictionary)
-        return 0;
-
-    Element *newp;
+    const Array *array = (const Array *) value;
+    const Table *table;
+    int i, j;
 
     switch (type)
     {
         case 'n':
-            newp = newElement(key, type, copyNumber(value));
+            usage->scalarBytes += sizeof(double);
+            usage->allocations++;
             break;
         case 'b':
-            newp = newElement(key, type, copyBool(value));
+            usage->scalarBytes += sizeof(Bool);
+            usage->allocations++;
             break;
         case 's':
-            newp = newElement(key, type, copyString(value));
+            usage->stringBytes += strlen(value) + 1;
+            usage->allocations++;
             break;
-        case 'd':
-            newp = newElement(key, type, copyDictionary(value));
+        case 'a':
+            usage->arrayBytes += sizeof(Array);
+            usage->allocations += 2;
+            switch (array->type)
+            {
+                case 'n':
+                    usage->arrayBytes += sizeof(double) * array->size;
+                    break;
+                case 'b':
+                    usage->arrayBytes += sizeof(unsigned long long) * wordCount(array->size);
+                    break;
+                case 's':
+                    usage->arrayBytes += sizeof(char *) * array->size;
+                    for(i = 0; i < array->size; i++)
+                        usage->stringBytes += strlen(((char **) array->elements)[i]) + 1;
+                    usage->allocations += array->size;
+                    break;
+                case 'd':
+                    usage->arrayBytes += sizeof(Dictionary *) * array->size;
+                    break;
+                case 'c':
+                    table = (const Table *) array->elements;
+                    usage->arrayBytes += sizeof(Table) + (sizeof(char *) + sizeof(char) + sizeof(void *)) * table->columns;
+                    usage->allocations += 3;
+                    for(i = 0; i < table->columns; i++)
+                    {
+                        usage->keyBytes += strlen(table->keys[i]) + 1;
+                        usage->arrayBytes += cellSize(table->types[i]) * array->size;
+                        usage->allocations += 2;
+
+                        // Los numeros y booleanos estan en el arreglo de la columna, el resto son bloques aparte
+                        if (table->types[i] == 's' || table->types[i] == 'a')
+                            for(j = 0; j < array->size; j++)
+                                valueBytes(table->types[i], cellValue(table, i, j), usage);
+                    }
+                    break;
+            }
             break;
     }
-
-    removeElement(dictionary, key); // Si la clave ya existe, se elimina, si no existe, no pasa nada
-    addElement(dictionary, newp);
-    return 1;
 }
 
-// Sets a number for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setNumber(Dictionary *dictionary, const char *key, double value)
+// Guarda en el arreglo los bytes que ocupa, para que crear y liberar sus elementos no tenga que recorrerlo
+void measureArray(Array *array)
 {
-    return setValue(dictionary, key, &value, 'n');
+    DictionaryUsage usage = {0};
+    valueBytes('a', array, &usage);
+    array->arrayBytes = usage.arrayBytes;
+    array->stringBytes = usage.stringBytes;
 }
 
-// Saves the number associated to the corresponding key in result.
-// Returns 1 if it was able to get it otherwise returns 0
-int getNumber(const Dictionary *dictionary, const char *key, double *result)
+// Suma (sign = 1) o resta (sign = -1) el elemento de los contadores globales
+void countElement(const Element *element, int sign)
 {
-    if (!dictionary)
-        return 0;
+    DictionaryUsage usage = {0};
+    if (element->type == 'a') // Un arreglo ya tiene sus bytes medidos
+    {
+        usage.arrayBytes = ((const Array *) element->value)->arrayBytes;
+        usage.stringBytes = ((const Array *) element->value)->stringBytes;
+    }
+    else
+        valueBytes(element->type, element->value, &usage);
+
+    STATS_ADD(elements, sign);
+    STATS_ADD(keyBytes, sign * (long long) sizeof(element->key));
+    if (usage.scalarBytes)
+        STATS_ADD(scalarBytes, sign * usage.scalarBytes);
+    if (usage.stringBytes)
+        STATS_ADD(stringBytes, sign * usage.stringBytes);
+    if (usage.arrayBytes)
+        STATS_ADD(arrayBytes, sign * usage.arrayBytes);
+}
 
+// Suma a usage lo que ocupa el diccionario, incluyendo los diccionarios anidados
+void addUsage(const Dictionary *dictionary, DictionaryUsage *usage)
+{
     Element *aux;
+
+    usage->dictionaries++;
+    usage->allocations++;
+    if (dictionary->orderedIndex)
+        addIndexUsage(dictionary->orderedIndex, usage);
+    if (dictionary->prefixIndex)
+        addPrefixUsage(dictionary->prefixIndex, usage);
+    if (dictionary->slots)
+    {
+        usage->indexBytes += dictionary->slotCapacity * sizeof(Element *);
+        usage->allocations++;
+    }
+    if (dictionary->json)
+    {
+        usage->jsonBytes += dictionary->jsonLength + 1;
+        usage->allocations++;
+    }
     for(aux = dictionary->first; aux; aux = aux->next)
     {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 'n')
-            {
-                *result = *( (double *) aux->value);
-                return 1;
-            }
-            return 0;
-        }
+        usage->elements++;
+        usage->allocations++;
+        usage->keyBytes += sizeof(aux->key);
+        valueBytes(aux->type, aux->value, usage);
+        addNestedUsage(aux->type, aux->value, usage);
     }
-
-    return 0;
 }
 
-// Sets a boolean for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setBool(Dictionary *dictionary, const char *key, Bool value)
+// Suma a usage lo que ocupan los diccionarios que contiene un valor de tipo type
+void addNestedUsage(char type, const void *value, DictionaryUsage *usage)
 {
-    return setValue(dictionary, key, &value, 'b');
+    const Array *array = (const Array *) value;
+    int i, j;
+
+    if (type == 'd')
+        addUsage(value, usage);
+    else if (type == 'a' && array->type == 'd')
+        for(i = 0; i < array->size; i++)
+            addUsage(((Dictionary **) array->elements)[i], usage);
+    else if (type == 'a' && array->type == 'c')
+    {
+        const Table *table = (const Table *) array->elements;
+        for(i = 0; i < table->columns; i++)
+            if (table->types[i] == 'd' || table->types[i] == 'a')
+                for(j = 0; j < array->size; j++)
+                    addNestedUsage(table->types[i], cellValue(table, i, j), usage);
+    }
 }
 
-// Saves the boolean associated to the corresponding key in result.
-// Returns 1 if it was able to get it otherwise returns 0
-int getBool(const Dictionary *dictionary, const char *key, Bool *result)
+// Saves in result the memory held by the given dictionary, including its nested dictionaries
+void getDictionaryUsage(const Dictionary *dictionary, DictionaryUsage *result)
 {
-    if (!dictionary)
-        return 0;
+    memset(result, 0, sizeof(DictionaryUsage));
+    if (dictionary)
+        addUsage(dictionary, result);
+}
 
+// Retorna el elemento con la clave key, o NULL si no existe, usando un indice si el diccionario lo tiene.
+// Suma a comparisons las claves o nodos comparados
+Element *lookupElement(const Dictionary *dictionary, const char *key, long long *comparisons)
+{
     Element *aux;
+    PrefixNode *node;
+
+    if (dictionary->orderedIndex)
+        return indexFind(dictionary->orderedIndex, key, comparisons);
+    if (dictionary->prefixIndex)
+        return (node = prefixSubtree(dictionary->prefixIndex, key, 1, comparisons)) ? node->element : NULL;
+
     for(aux = dictionary->first; aux; aux = aux->next)
     {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 'b')
-            {
-                *result = *( (Bool *) aux->value);
-                return 1;
-            }
-            return 0;
-        }
+        (*comparisons)++;
+        if (!strcmp(aux->key, key))
+            break;
     }
+    return aux;
+}
 
-    return 0;
+// Retorna el elemento con la clave key, o NULL si no existe, y lo cuenta en las estadisticas
+Element *findElement(const Dictionary *dictionary, const char *key)
+{
+    Element *aux;
+    long long comparisons = 0;
+
+    aux = lookupElement(dictionary, key, &comparisons);
+
+    STATS_ADD(lookups, 1);
+    STATS_ADD(lookupComparisons, comparisons);
+    STATS_MAX(maxLookupComparisons, comparisons);
+    return aux;
 }
 
-// Sets a string for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setString(Dictionary *dictionary, const char *key, const char *value)
+// Sets the allocator used by new dictionaries, NULL restores malloc, realloc and free.
+// The allocator must remain valid while any dictionary created with it exists
+void setDefaultAllocator(const DictionaryAllocator *allocator)
 {
-    return setValue(dictionary, key, value, 's');
+    defaultAllocator = allocator ? allocator : &mallocAllocator;
 }
 
-// Returns the string associated to the corresponding key, otherwise returns NULL
-char *getString(const Dictionary *dictionary, const char *key)
+// Creates a new empty dictionary. Returns NULL if there is no memory
+Dictionary *newDictionary()
 {
-    if (!dictionary)
+    return newDictionaryWithAllocator(NULL);
+}
+
+// Creates a new empty dictionary that uses the given allocator, NULL means the default one.
+// Returns NULL if there is no memory
+Dictionary *newDictionaryWithAllocator(const DictionaryAllocator *allocator)
+{
+    if (!allocator)
+        allocator = defaultAllocator;
+
+    Dictionary *d;
+    if ((d = (Dictionary *) allocate(allocator, sizeof(Dictionary))) == NULL)
         return NULL;
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next)
+    d->first = NULL;
+    d->allocator = allocator;
+    d->orderedIndex = NULL;
+    d->prefixIndex = NULL;
+    d->shape = NULL;
+    d->slots = NULL;
+    d->slotCapacity = 0;
+    d->hash = 0;
+    d->references = 0;
+    d->nextInterned = NULL;
+    d->cacheJson = 0;
+    d->json = NULL;
+    d->jsonLength = 0;
+    d->store = NULL;
+    return d;
+}
+
+// Prepara una pila de marcos vacia para marcos de frameSize bytes
+void initFrames(FrameStack *stack, const DictionaryAllocator *allocator, size_t frameSize)
+{
+    stack->allocator = allocator;
+    stack->frames = stack->local.bytes;
+    stack->frameSize = frameSize;
+    stack->count = 0;
+    stack->capacity = sizeof(stack->local) / frameSize;
+}
+
+// Agrega un marco en 0 al tope de la pila y lo retorna, o retorna NULL si no hay memoria.
+// Los punteros a los marcos que ya estaban dejan de ser validos
+void *pushFrame(FrameStack *stack)
+{
+    if (stack->count == stack->capacity)
     {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 's')
-                return copyString(aux->value); // Es necesario una copia del string
+        int capacity = 2 * stack->capacity;
+        char *frames;
+
+        if (stack->frames != stack->local.bytes)
+            frames = (char *) reallocate(stack->allocator, stack->frames, capacity * stack->frameSize);
+        else if ((frames = (char *) allocate(stack->allocator, capacity * stack->frameSize)) != NULL)
+            memcpy(frames, stack->frames, stack->count * stack->frameSize);
 
+        if (!frames)
             return NULL;
-        }
+        stack->frames = frames;
+        stack->capacity = capacity;
     }
 
-    return NULL;
+    void *frame = stack->frames + stack->count++ * stack->frameSize;
+    memset(frame, 0, stack->frameSize);
+    return frame;
 }
 
-// Generalizacin de las funciones setNumberArray, setBoolArray, setStringArray y setDictionaryArray
-int setArray(Dictionary *dictionary, const char *key, int size, void *value, char type)
+// Retorna el marco del tope de la pila, o NULL si esta vacia
+void *topFrame(const FrameStack *stack)
 {
-    if (!dictionary)
-        return 0;
-
-    Element *newp;
+    return stack->count ? stack->frames + (stack->count - 1) * stack->frameSize : NULL;
+}
 
-    switch (type)
-    {
-        case 'n':
-            newp = newElement(key, 'a', newArray(copyNumberArray(size, value), size, 'n'));
-            break;
-        case 'b':
-            newp = newElement(key, 'a', newArray(copyBoolArray(size, value), size, 'b'));
-            break;
-        case 's':
-            newp = newElement(key, 'a', newArray(copyStringArray(size, value), size, 's'));
-            break;
-        case 'd':
-            newp = newElement(key, 'a', newArray(copyDictionaryArray(size, value), size, 'd'));
-            break;
-    }
+// Quita el marco del tope de la pila
+void popFrame(FrameStack *stack)
+{
+    stack->count--;
+}
 
-    removeElement(dictionary, key); // Si la clave ya existe, se elimina, si no existe, no pasa nada
-    addElement(dictionary, newp);
-    return 1;
+// Hace free a la memoria de la pila
+void freeFrames(FrameStack *stack)
+{
+    if (stack->frames != stack->local.bytes)
+        release(stack->allocator, stack->frames);
 }
 
-// Sets a numeric array for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setNumberArray(Dictionary *dictionary, const char *key, int size, double value[size])
+// Hace free a los elementos de un arreglo de tipo type, sin incluir el arreglo
+void freeArrayElements(const DictionaryAllocator *allocator, char type, void *elements, int size)
 {
-    return setArray(dictionary, key, size, value, 'n');
+    int i;
+
+    // Si es un arreglo de strings o diccionarios se le hace free a cada uno de los elementos
+    // Porque fueron creados con memoria dinmica
+    if (type == 's')
+    {
+        for(i = 0; i < size; i++)
+            release(allocator, ((char **) elements)[i]);
+    }
+    else if (type == 'd')
+    {
+        for(i = 0; i < size; i++)
+            freeDictionary(((Dictionary **) elements)[i]);
+    }
 }
 
-// Returns the numeric array associated to the corresponding key, otherwise returns NULL
-double *getNumberArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+// Agrega el diccionario a la lista de los que freeTree tiene que liberar, encadenados por nextInterned.
+// Uno compartido solo se agrega cuando lo suelta el ultimo que lo tiene, y entonces ya no esta en la tabla
+void pendDictionary(Dictionary **pending, Dictionary *dictionary)
 {
     if (!dictionary)
-        return NULL;
+        return;
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next)
+    if (isShared(dictionary))
     {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 'a' && ((Array *) aux->value)->type == 'n')
-            {
-                *sizeResult = ((Array *) aux->value)->size;
-                return copyNumberArray(*sizeResult, ((Array *) aux->value)->elements);
-            }
-            return NULL;
-        }
+        int references;
+
+        pthread_mutex_lock(&internLock);
+        if ((references = __atomic_sub_fetch(&dictionary->references, 1, __ATOMIC_ACQ_REL)) == 0)
+            removeInterned(dictionary);
+        pthread_mutex_unlock(&internLock);
+        if (references)
+            return;
     }
 
-    return NULL;
+    dictionary->nextInterned = *pending;
+    *pending = dictionary;
 }
 
-// Sets a boolean array for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setBoolArray(Dictionary *dictionary, const char *key, int size, Bool value[size])
+// Agrega el arreglo a la lista de los que freeTree tiene que liberar. Mientras espera, su hash guarda el siguiente
+void pendArray(Array **pending, Array *array)
 {
-    return setArray(dictionary, key, size, value, 'b');
+    if (!array)
+        return;
+
+    array->hash = (unsigned long long) (size_t) *pending;
+    *pending = array;
 }
 
-// Returns the boolean array associated to the corresponding key, otherwise returns NULL
-Bool *getBoolArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+// Hace free al valor de tipo type, salvo los diccionarios y arreglos que se agregan a las listas de freeTree
+void pendValue(const DictionaryAllocator *allocator, Dictionary **dictionaries, Array **arrays, char type, void *value)
 {
-    if (!dictionary)
-        return NULL;
+    if (type == 'd')
+        pendDictionary(dictionaries, value);
+    else if (type == 'a')
+        pendArray(arrays, value);
+    else if (type != 'z')
+        releaseLeaf(allocator, type, value);
+}
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next)
+// Hace free a los diccionarios y arreglos de las listas y a todo lo que contienen. Lo anidado se agrega a las listas
+// en lugar de liberarse en el momento, asi el stack que se usa no depende de la profundidad.
+// Todo lo que contiene un diccionario usa su allocator, asi que los arreglos usan allocator
+void freeTree(const DictionaryAllocator *allocator, Dictionary *dictionaries, Array *arrays)
+{
+    Dictionary *dictionary;
+    Element *element, *next;
+    Array *array;
+    Table *table;
+    int i, j;
+
+    while (dictionaries || arrays)
     {
-        if(!strcmp(aux->key, key))
+        if ((dictionary = dictionaries) != NULL)
         {
-            if(aux->type == 'a' && ((Array *) aux->value)->type == 'b')
+            dictionaries = dictionary->nextInterned;
+            for(element = dictionary->first; element; element = next)
             {
-                *sizeResult = ((Array *) aux->value)->size;
-                return copyBoolArray(*sizeResult, ((Array *) aux->value)->elements);
+                next = element->next;
+                countElement(element, -1);
+                pendValue(dictionary->allocator, &dictionaries, &arrays, element->type, element->value);
+                releaseBlock(dictionary->allocator, element, sizeof(Element));
             }
-            return NULL;
+            dictionary->first = NULL;
+
+            dropOrderedIndex(dictionary);
+            dropPrefixIndex(dictionary);
+            releaseShape(dictionary);
+            invalidateJson(dictionary);
+            release(dictionary->allocator, dictionary);
+            continue;
+        }
+
+        array = arrays;
+        arrays = (Array *) (size_t) array->hash;
+        if (array->type == 'c')
+        {
+            table = (Table *) array->elements;
+            for(i = 0; i < table->columns; i++)
+                if (table->values[i] && table->types[i] != 'n' && table->types[i] != 'b')
+                    for(j = 0; j < array->size; j++)
+                        if (((void **) table->values[i])[j])
+                            pendValue(allocator, &dictionaries, &arrays, table->types[i], ((void **) table->values[i])[j]);
+            releaseTable(allocator, table);
+        }
+        else
+        {
+            if (array->type == 'd')
+                for(i = 0; i < array->size; i++)
+                    pendDictionary(&dictionaries, ((Dictionary **) array->elements)[i]);
+            else
+                freeArrayElements(allocator, array->type, array->elements, array->size);
+            release(allocator, array->elements); // Se le hace free al arreglo de elementos
         }
+        releaseBlock(allocator, array, sizeof(Array)); // Se le hace free a la estructura Array
     }
+}
 
-    return NULL;
+// Hace free al valor de un elemento de tipo type
+void freeValue(const DictionaryAllocator *allocator, char type, void *value)
+{
+    Array *arrays = NULL;
+
+    if (type == 'n' || type == 'b' || type == 's')
+        releaseLeaf(allocator, type, value);
+    else if (type == 'd')
+        freeDictionary(value);
+    else if (type == 'a')
+    {
+        pendArray(&arrays, value);
+        freeTree(allocator, NULL, arrays);
+    }
 }
 
-// Sets an array of strings for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setStringArray(Dictionary *dictionary, const char *key, int size, char *value[size])
+// Hace free a un elemento de un diccionario
+void freeElement(const DictionaryAllocator *allocator, Element *element)
 {
-    return setArray(dictionary, key, size, value, 's');
+    countElement(element, -1);
+    freeValue(allocator, element->type, element->value);
+    releaseBlock(allocator, element, sizeof(Element));
 }
 
-// Returns the array of strings associated to the corresponding key, otherwise returns NULL
-char **getStringArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+// Hace free a un numero, booleano o string
+void releaseLeaf(const DictionaryAllocator *allocator, char type, void *value)
+{
+    if (type == 'n')
+        releaseBlock(allocator, value, sizeof(double));
+    else if (type == 'b')
+        releaseBlock(allocator, value, sizeof(Bool));
+    else
+        release(allocator, value);
+}
+
+// Releases the memory of the given dictionary
+void freeDictionary(Dictionary *dictionary)
 {
     if (!dictionary)
-        return NULL;
+        return;
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next)
-    {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 'a' && ((Array *) aux->value)->type == 's')
-            {
-                *sizeResult = ((Array *) aux->value)->size;
-                return copyStringArray(*sizeResult, ((Array *) aux->value)->elements);
-            }
-            return NULL;
-        }
-    }
+    // Si es compartido y alguien mas lo tiene, otro hilo puede liberarlo en cuanto se suelta
+    const DictionaryAllocator *allocator = dictionary->allocator;
+    Dictionary *dictionaries = NULL;
 
-    return NULL;
+    if (dictionary->store) // Los cambios que faltan se escriben antes de cerrar sus archivos
+        closeStore(dictionary->store);
+    pendDictionary(&dictionaries, dictionary);
+    freeTree(allocator, dictionaries, NULL);
 }
 
-// Sets a dictionary for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setDictionary(Dictionary *dictionary, const char *key, Dictionary *value)
+// Releases memory returned by the library for the given dictionary, like its strings, arrays or json
+void freeDictionaryMemory(const Dictionary *dictionary, void *pointer)
 {
-    return setValue(dictionary, key, value, 'd');
+    release(dictionary ? dictionary->allocator : defaultAllocator, pointer);
 }
 
-// Returns the dictionary associated to the corresponding key, otherwise returns NULL
-Dictionary *getDictionary(const Dictionary *dictionary, const char *key)
+// Removes the given key. Returns 1 if it was able to do it otherwise returns 0
+int removeElement(Dictionary *dictionary, const char *key)
 {
-    if (!dictionary)
-        return NULL;
+    if(!dictionary)
+        return 0;
 
     Element *aux;
+    if (!(aux = unlinkElement(dictionary, key)))
+        return 0;
+
+    if (dictionary->orderedIndex)
+        indexRemove(dictionary, aux->key);
+    if (dictionary->prefixIndex)
+        prefixRemove(dictionary, aux);
+    dictionary->hash -= hashElement(aux->key, aux->type, aux->value);
+    freeElement(dictionary->allocator, aux);
+    if (dictionary->shape && !shapeDictionary(dictionary))
+        releaseShape(dictionary);
+    invalidateJson(dictionary);
+    if (dictionary->store)
+        logRemoval(dictionary, key);
+    return 1;
+}
+
+// Desconecta de la lista de elementos el elemento con la clave key y lo retorna, o retorna NULL si no existe.
+// No lo quita del indice ordenado
+Element *unlinkElement(Dictionary *dictionary, const char *key)
+{
+    Element *aux, *prev = NULL;
+
     for(aux = dictionary->first; aux; aux = aux->next)
     {
-        if(!strcmp(aux->key, key))
+        if (!strcmp(aux->key, key))
         {
-            if(aux->type == 'd')
-                return copyDictionary(aux->value); // Es necesario hacer una copia del diccionario
-
-            return NULL;
+            if(!prev)
+                dictionary->first = aux->next;
+            else
+                prev->next = aux->next;
+            return aux;
         }
+        prev = aux;
     }
 
     return NULL;
 }
 
-// Sets an array of dictionaries for the given key, if the key does not exists it creates it else it overrides the previous value.
-// Returns 1 if it was able to do it otherwise returns 0
-int setDictionaryArray(Dictionary *dictionary, const char *key, int size, Dictionary *value[size])
-{
-    return setArray(dictionary, key, size, value, 'd');
-}
-
-// Returns the array of dictionaries associated to the corresponding key, otherwise returns NULL
-Dictionary **getDictionaryArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+// Crea un nuevo elemento de clave key, tipo type y valor value.
+// Si value es NULL porque no se pudo crear, o no hay memoria para el elemento, retorna NULL y hace free a value
+Element *newElement(const DictionaryAllocator *allocator, const char *key, char type, void *value)
 {
-    if (!dictionary)
+    if (!value)
         return NULL;
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next)
+    Element *newp;
+    if (strlen(key) >= sizeof(newp->key) || // La clave debe caber en el elemento
+        (newp = (Element *) allocateBlock(allocator, sizeof(Element))) == NULL)  // Crea un nuevo elemento en el diccionario
     {
-        if(!strcmp(aux->key, key))
-        {
-            if(aux->type == 'a' && ((Array *) aux->value)->type == 'd')
-            {
-                *sizeResult = ((Array *) aux->value)->size;
-                return copyDictionaryArray(*sizeResult, ((Array *) aux->value)->elements);
-            }
-            return NULL;
-        }
+        freeValue(allocator, type, value);
+        return NULL;
     }
 
-    return NULL;
+    strcpy(newp->key, key);
+    newp->type = type;
+    newp->value = value;
+    newp->next = NULL;
+
+    countElement(newp, 1);
+    return newp;
 }
 
-// Concatena al final de s1 el contenido de s2, asignando ms memoria a s1
-// Al llamar a esta funcin s1 siempre contendr una direccin reservada con memoria dinmica
-char *concat(char *s1, char *s2)
+// Retorna una nueva direccin de memoria que contendr una copia de number, o NULL si no hay memoria
+double *copyNumber(const DictionaryAllocator *allocator, const double *number)
 {
-    int len = strlen(s1) + strlen(s2) + 1; // Calcula el nuevo tamao
+    double *copy;
+    if ((copy = (double *) allocateBlock(allocator, sizeof(double))) == NULL) // Asigna el espacio de memoria donde se guardar el valor
+        return NULL;
+
+    *copy = *number;
+    return copy;
+}
 
-    if ((s1 = (char *) realloc(s1, sizeof(char) * len)) == NULL) // Asigna el espacio suficiente
-        errorMessage();
+// Retorna una nueva direccin de memoria que contendr una copia de value, o NULL si no hay memoria
+Bool *copyBool(const DictionaryAllocator *allocator, const Bool *value)
+{
+    Bool *copy;
+    if ((copy = (Bool *) allocateBlock(allocator, sizeof(Bool))) == NULL) // Asigna el espacio de memoria donde se guardar el valor
+        return NULL;
 
-    strcat(s1, s2); // Concatena s2 al final de s1
-    return s1;
+    *copy = *value;
+    return copy;
 }
 
-// Returns the json representation string for the given dictionary. If it can't do it returns NULL
-char *jsonFromDictionary(const Dictionary *dictionary)
+// Retorna una copia del string s, o NULL si no hay memoria
+char *copyString(const DictionaryAllocator *allocator, const char *s)
 {
-    if (!dictionary)
+    STATS_ADD(stringCopies, 1);
+
+    char *str;
+    if ((str = (char *) allocate(allocator, sizeof(char) * (strlen(s) + 1))) == NULL) // Asigna el espacio suficiente para guardar el string
         return NULL;
+    strcpy(str, s);
+    return str;
+}
 
-    char *json;
-    if ((json = (char *) malloc(sizeof(char))) == NULL) // Se reserva el espacio con malloc para as usar la funcin concat
-        errorMessage();
-    *json = '\0';
+// Crea un nuevo arreglo de la estructura Array de tipo type cuyos elementos sern los de elements.
+// Si elements es NULL porque no se pudo crear, o no hay memoria para el arreglo, retorna NULL y hace free a elements
+Array *newArray(const DictionaryAllocator *allocator, void *elements, int size, char type)
+{
+    if (!elements)
+        return NULL;
 
-    json = concat(json, "{"); // El json empieza en '{'
+    Array *newp;
 
-    Element *aux;
-    for(aux = dictionary->first; aux; aux = aux->next) // Para cada elemento del diccionario
+    if ((newp = (Array *) allocateBlock(allocator, sizeof(Array))) == NULL) // Asigna el espacio de memoria donde se guardar el arreglo
     {
-        json = concat(json, "\""); // Empieza en comillas
-        json = concat(json, aux->key); // Luego se copia la clave
-        json = concat(json, "\":"); // Seguidamente comillas
-        switch (aux->type) // Se copia el valor en string dependiendo del tipo
+        if (type == 'c')
+            freeTable(allocator, elements, size);
+        else
         {
-            char num[30];
-            char *dict;
-
-            case 'n':
-                sprintf(num, "%.3f", *((double *) aux->value));
-                json = concat(json, num);
-                break;
-            case 'b':
-                json = concat(json, *((Bool *) aux->value) == true ? "true" : "false");
-                break;
-            case 's':
-                json = concat(json, "\"");
-                json = concat(json, (char *) aux->value);
-                json = concat(json, "\"");
-                break;
-            case 'd':
-                dict = jsonFromDictionary((Dictionary *) aux->value);
-                json = concat(json, dict);
-                free(dict);
-                break;
-            case 'a':
-                json = concat(json, "[");
-                switch(((Array *) aux->value)->type)
-                {
-                    int i;
-
-                    case 'n':
-                        for(i = 0; i < ((Array *) aux->value)->size; i++)
-                        {
-                            sprintf(num, "%.3f", ((double *) ((Array *) aux->value)->elements)[i]);
-                            json = concat(json, num);
-                            if (i != ((Array *) aux->value)->size - 1) // Si no es el ltimo elemento
-                                json = concat(json, ",");
-                        }
-                        break;
-                    case 'b':
-                        for(i = 0; i < ((Array *) aux->value)->size; i++)
-                        {
-                            json = concat(json, ((Bool *) ((Array *) aux->value)->elements)[i] == true ? "true" : "false");
-                            if (i != ((Array *) aux->value)->size - 1) // Si no es el ltimo elemento
-                                json = concat(json, ",");
-                        }
-                        break;
-                    case 's':
-                        for(i = 0; i < ((Array *) aux->value)->size; i++)
-                        {
-                            // Comillas antes y despus del string
-                            json = concat(json, "\"");
-                            json = concat(json, ((char **) ((Array *) aux->value)->elements)[i]);
-                            json = concat(json, "\"");
-                            if (i != ((Array *) aux->value)->size - 1) // Si no es el ltimo elemento
-                                json = concat(json, ",");
-                        }
-                        break;
-                    case 'd':
-                        for(i = 0; i < ((Array *) aux->value)->size; i++)
-                        {
-                            dict = jsonFromDictionary(((Dictionary **) ((Array *) aux->value)->elements)[i]);
-                            json = concat(json, dict);
-                            free(dict);
-                            if (i != ((Array *) aux->value)->size - 1) // Si no es el ltimo elemento
-                                json = concat(json, ",");
-                        }
-                        break;
-                }
-                json = concat(json, "]");
-                break;
+            freeArrayElements(allocator, type, elements, size);
+            release(allocator, elements);
         }
-        if (aux->next) // Si no es el ltimo elemento del diccionario
-            json = concat(json, ",");
+        return NULL;
     }
 
-    json = concat(json, "}"); // Termina en '}'
+    newp->elements = elements;
+    newp->type = type;
+    newp->size = size;
+    newp->hash = hashArray(newp);
+    measureArray(newp);
+    return newp;
+}
 
-    return json;
+// Reserva el espacio para size elementos de elementSize bytes. Aunque el arreglo este vacio se reserva
+// memoria, pues NULL indica que no hay memoria
+void *allocateArray(const DictionaryAllocator *allocator, int size, size_t elementSize)
+{
+    return allocate(allocator, elementSize * (size > 0 ? size : 1));
 }
 
-// Retorna 1 si str corresponde a un nmero vlido, de lo contrario retorna 0
-int isNumber(char *str)
+// Crea una copia del arreglo numrico, o retorna NULL si no hay memoria
+double *copyNumberArray(const DictionaryAllocator *allocator, int size, double value[size])
 {
-    if (*str == '\0')
-        return 0;
+    double *arrayElements;
 
-    int len = strlen(str);
+    if ((arrayElements = (double *) allocateArray(allocator, size, sizeof(double))) == NULL) // Asigna el espacio de memoria para guardar los elementos
+        return NULL;
 
     int i;
-    for(i = 0; i < len; i++)
-        if ((str[i] < '0' || str[i] > '9') && str[i] != '.' && str[i] != '-') // Verifica que solo haya numeros o puntos
-            return 0;
+    for(i = 0; i < size; i++)
+        arrayElements[i] = value[i]; // Copia los elementos
 
-    // Primera ocurrencia de '-' y '.'
-    char *minus = strchr(str, '-'), *dot = strchr(str, '.');
+    return arrayElements;
+}
+
+// Retorna cuantas palabras hacen falta para guardar size booleanos
+int wordCount(int size)
+{
+    return (size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+// Retorna el booleano index guardado en bits
+Bool bitValue(const unsigned long long *bits, int index)
+{
+    return bits[index / BITS_PER_WORD] >> (index % BITS_PER_WORD) & 1 ? true : false;
+}
+
+// Crea una copia del arreglo booleano guardando un bit por elemento (1 si es true), o retorna NULL si no hay memoria.
+// Los bits que sobran en la ultima palabra quedan en 0
+unsigned long long *packBoolArray(const DictionaryAllocator *allocator, int size, Bool value[size])
+{
+    unsigned long long *bits;
+
+    if ((bits = (unsigned long long *) allocateArray(allocator, wordCount(size), sizeof(unsigned long long))) == NULL)
+        return NULL;
+
+    int i;
+    memset(bits, 0, sizeof(unsigned long long) * wordCount(size));
+    for(i = 0; i < size; i++)
+        if (value[i] == true)
+            bits[i / BITS_PER_WORD] |= 1ULL << (i % BITS_PER_WORD);
+
+    return bits;
+}
+
+// Crea un arreglo de Bool con los size booleanos guardados en bits, o retorna NULL si no hay memoria
+Bool *unpackBoolArray(const DictionaryAllocator *allocator, int size, const unsigned long long *bits)
+{
+    Bool *arrayElements;
+
+    if ((arrayElements = (Bool *) allocateArray(allocator, size, sizeof(Bool))) == NULL) // Asigna el espacio de memoria para guardar los elementos
+        return NULL;
+
+    int i;
+    for(i = 0; i < size; i++)
+        arrayElements[i] = bitValue(bits, i);
+
+    return arrayElements;
+}
+
+// Crea una copia de los bits de un arreglo booleano de size elementos, o retorna NULL si no hay memoria
+unsigned long long *copyBits(const DictionaryAllocator *allocator, int size, const unsigned long long *bits)
+{
+    unsigned long long *copy;
+
+    if ((copy = (unsigned long long *) allocateArray(allocator, wordCount(size), sizeof(unsigned long long))) == NULL)
+        return NULL;
+
+    memcpy(copy, bits, sizeof(unsigned long long) * wordCount(size));
+    return copy;
+}
+
+// Crea una copia del arreglo de strings, o retorna NULL si no hay memoria
+char **copyStringArray(const DictionaryAllocator *allocator, int size, char *value[size])
+{
+    char **arrayElements;
+
+    if ((arrayElements = (char **) allocateArray(allocator, size, sizeof(char *))) == NULL) // Asigna el espacio de memoria para guardar el arreglo
+        return NULL;
+
+    int i;
+    for(i = 0; i < size; i++) // Copia los elementos
+    {
+        if (!(arrayElements[i] = copyString(allocator, value[i])))
+        {
+            freeArrayElements(allocator, 's', arrayElements, i); // Se liberan los que ya se copiaron
+            release(allocator, arrayElements);
+            return NULL;
+        }
+    }
+
+    return arrayElements;
+}
+
+// Crea una copia del arreglo de diccionarios, o retorna NULL si no hay memoria
+Dictionary **copyDictionaryArray(const DictionaryAllocator *allocator, int size, Dictionary *value[size])
+{
+    Dictionary **arrayElements;
+
+    if ((arrayElements = (Dictionary **) allocateArray(allocator, size, sizeof(Dictionary *))) == NULL) // Asigna el espacio de memoria para guardar el arreglo
+        return NULL;
+
+    int i;
+    for(i = 0; i < size; i++) // Copia los elementos
+    {
+        if (!(arrayElements[i] = copyDictionary(allocator, value[i])))
+        {
+            freeArrayElements(allocator, 'd', arrayElements, i); // Se liberan los que ya se copiaron
+            release(allocator, arrayElements);
+            return NULL;
+        }
+    }
+
+    return arrayElements;
+}
+
+// Crea una copia del valor de un elemento de tipo type, o retorna NULL si no hay memoria
+void *copyValue(const DictionaryAllocator *allocator, char type, const void *value)
+{
+    const Array *array = (const Array *) value;
+
+    switch (type)
+    {
+        case 'n':
+            return copyNumber(allocator, value);
+        case 'b':
+            return copyBool(allocator, value);
+        case 's':
+            return copyString(allocator, value);
+        case 'd':
+            return storeDictionary(allocator, value);
+        case 'z':
+            return (void *) &nullValue;
+        case 'a':
+            switch (array->type)
+            {
+                case 'n':
+                    return newArray(allocator, copyNumberArray(allocator, array->size, array->elements), array->size, 'n');
+                case 'b':
+                    return newArray(allocator, copyBits(allocator, array->size, array->elements), array->size, 'b');
+                case 's':
+                    return newArray(allocator, copyStringArray(allocator, array->size, array->elements), array->size, 's');
+                case 'd':
+                    // Si todos los diccionarios tienen la misma forma se guardan por columnas
+                    if (sameShape(array->size, array->elements))
+                        return newArray(allocator, tableFromDictionaries(allocator, array->size, array->elements), array->size, 'c');
+                    return copyTree(allocator, 'a', value, 0);
+                case 'c':
+                    return copyTree(allocator, 'a', value, 0);
+            }
+    }
+
+    return NULL;
+}
+
+// Crea una copia de un diccionario usando allocator, o retorna NULL si no hay memoria
+Dictionary *copyDictionary(const DictionaryAllocator *allocator, const Dictionary *dictionary)
+{
+    if (!dictionary)
+        return NULL;
+
+    return copyTree(allocator, 'd', dictionary, 1);
+}
+
+// Retorna el diccionario a guardar como valor de otro: el mismo si ya es compartido y usa allocator, uno compartido
+// igual si setInterning esta activo, o una copia. Retorna NULL si no hay memoria
+Dictionary *storeDictionary(const DictionaryAllocator *allocator, const Dictionary *dictionary)
+{
+    return copyTree(allocator, 'd', dictionary, 0);
+}
+
+// Crea el arreglo de diccionarios o la tabla donde se copia array, con los diccionarios y las celdas de punteros en NULL
+// para llenarlos despues. Una tabla va a quedar igual, asi que ya tiene el hash de array. Retorna NULL si no hay memoria
+Array *copyArrayShell(const DictionaryAllocator *allocator, const Array *array)
+{
+    const Table *table = (const Table *) array->elements;
+    Table *copy;
+    Array *newp;
+    int i;
+
+    if ((newp = (Array *) allocateBlock(allocator, sizeof(Array))) == NULL)
+        return NULL;
+
+    newp->size = array->size;
+    newp->type = array->type;
+    newp->hash = array->hash;
+    newp->arrayBytes = array->arrayBytes; // La copia va a ocupar lo mismo
+    newp->stringBytes = array->stringBytes;
+
+    if (array->type == 'd') // Su hash se calcula al terminar, porque el de setArray aun no lo tiene
+    {
+        if ((newp->elements = allocateArray(allocator, array->size, sizeof(Dictionary *))) != NULL)
+            memset(newp->elements, 0, sizeof(Dictionary *) * array->size);
+    }
+    else if ((newp->elements = copy = newTable(allocator, table->columns)) != NULL)
+    {
+        for(i = 0; i < table->columns; i++)
+        {
+            copy->types[i] = table->types[i];
+            if (!(copy->keys[i] = copyString(allocator, table->keys[i])) || !allocateColumn(allocator, copy, i, array->size))
+            {
+                freeTable(allocator, copy, array->size);
+                newp->elements = NULL;
+                break;
+            }
+
+            if (table->types[i] == 'n' || table->types[i] == 'b') // Los numeros y booleanos se copian de una vez
+                memcpy(copy->values[i], table->values[i], cellSize(table->types[i]) * array->size);
+        }
+    }
+
+    if (!newp->elements)
+    {
+        releaseBlock(allocator, newp, sizeof(Array));
+        return NULL;
+    }
+    return newp;
+}
+
+// Retorna 1 si el valor de tipo type es un diccionario o un arreglo de diccionarios, guardado o no por columnas
+int hasDictionaries(char type, const void *value)
+{
+    return type == 'd' || (type == 'a' && (((const Array *) value)->type == 'd' || ((const Array *) value)->type == 'c'));
+}
+
+// Entrega la copia terminada de un valor de tipo type: la guarda en *slot, o si slot es NULL la agrega con la clave
+// key al final del diccionario que se copia en el tope de la pila. Retorna 0 si no hay memoria, y le hace free a copy
+int deliverCopy(FrameStack *stack, void **slot, const char *key, char type, void *copy)
+{
+    CopyFrame *parent;
+    Element *newp;
+
+    if (slot)
+        return (*slot = copy) != NULL;
+
+    if (!(newp = newElement(stack->allocator, key, type, copy)))
+        return 0;
+
+    parent = (CopyFrame *) topFrame(stack);
+    if (parent->last)
+        parent->last->next = newp;
+    else
+        ((Dictionary *) parent->target)->first = newp;
+    parent->last = newp;
+    return 1;
+}
+
+// Empieza a copiar value, de tipo type, para entregarlo con deliverCopy. Los valores simples se copian de una vez,
+// mientras que los diccionarios, arreglos de diccionarios y tablas se crean vacios y se llenan con un marco en la pila.
+// Un diccionario se guarda como con storeDictionary, salvo que fresh no sea 0. Retorna 0 si no hay memoria
+int beginCopy(FrameStack *stack, char type, const void *value, void **slot, const char *key, int fresh)
+{
+    const DictionaryAllocator *allocator = stack->allocator;
+    Dictionary *d = (Dictionary *) value, *shared;
+    const Array *array = (const Array *) value;
+    CopyFrame *frame;
+    void *copy;
+
+    if (type == 'd')
+    {
+        // Quien lo guarda ya tiene una referencia, asi que no puede llegar a 0 mientras se suma otra y no hace falta el lock
+        if (!fresh && isShared(d) && d->allocator == allocator)
+        {
+            __atomic_add_fetch(&d->references, 1, __ATOMIC_RELAXED);
+            STATS_ADD(sharedDictionaries, 1);
+            return deliverCopy(stack, slot, key, 'd', d);
+        }
+        if (!fresh && interning && (shared = findShared(allocator, d)))
+            return deliverCopy(stack, slot, key, 'd', shared);
+
+        STATS_ADD(dictionaryCopies, 1);
+        copy = newDictionaryWithAllocator(allocator);
+    }
+    else if (hasDictionaries(type, value))
+        copy = copyArrayShell(allocator, array);
+    else
+        return deliverCopy(stack, slot, key, type, copyValue(allocator, type, value));
+
+    if (!copy)
+        return 0;
+
+    if (!(frame = (CopyFrame *) pushFrame(stack)))
+    {
+        freeValue(allocator, type, copy);
+        return 0;
+    }
+
+    frame->kind = type == 'd' ? 'd' : array->type == 'd' ? 'a' : 'c';
+    frame->share = type == 'd' && !fresh && interning;
+    frame->source = value;
+    frame->target = copy;
+    frame->key = key;
+    frame->next = type == 'd' ? d->first : NULL;
+    // Lo que ya esta en su lugar se libera con lo que lo contiene si la copia no se puede terminar
+    if ((frame->slot = slot) != NULL)
+        *slot = copy;
+    return 1;
+}
+
+// Copia lo siguiente del marco del tope de la pila. Cuando ya termino lo quita y entrega la copia.
+// Retorna 0 si no hay memoria
+int continueCopy(FrameStack *stack, CopyFrame *frame)
+{
+    const Element *element;
+    const Table *table;
+    Dictionary *d;
+    int i, rows;
+
+    switch (frame->kind)
+    {
+        case 'd':
+            // Los valores simples se copian de una vez, hasta encontrar uno que necesite su propio marco
+            while ((element = frame->next) != NULL)
+            {
+                frame->next = element->next;
+                if (hasDictionaries(element->type, element->value))
+                    return beginCopy(stack, element->type, element->value, NULL, element->key, 0);
+                if (!deliverCopy(stack, NULL, element->key, element->type, copyValue(stack->allocator, element->type, element->value)))
+                    return 0;
+            }
+            break;
+        case 'a':
+            if ((i = frame->index) < ((const Array *) frame->source)->size)
+            {
+                frame->index++;
+                return beginCopy(stack, 'd', ((Dictionary **) ((const Array *) frame->source)->elements)[i],
+                                 (void **) ((Dictionary **) ((Array *) frame->target)->elements + i), NULL, 0);
+            }
+            break;
+        case 'c':
+            table = (const Table *) ((const Array *) frame->source)->elements;
+            rows = ((const Array *) frame->source)->size;
+            if (rows && (i = frame->index / rows) < table->columns)
+            {
+                if (table->types[i] == 'n' || table->types[i] == 'b') // Ya se copiaron con la tabla
+                {
+                    frame->index = (i + 1) * rows;
+                    return 1;
+                }
+
+                int row = frame->index++ % rows;
+                return beginCopy(stack, table->types[i], cellValue(table, i, row),
+                                 (void **) ((Table *) ((Array *) frame->target)->elements)->values[i] + row, NULL, 0);
+            }
+            break;
+    }
+
+    // La copia esta completa
+    CopyFrame done = *frame;
+    popFrame(stack);
+
+    if (done.kind == 'd')
+    {
+        d = (Dictionary *) done.target;
+        d->hash = ((const Dictionary *) done.source)->hash;
+        if (((const Dictionary *) done.source)->shape) // La copia tiene las mismas claves en el mismo orden
+            shareShape(d, ((const Dictionary *) done.source)->shape);
+        if (done.share)
+            done.target = shareCopy(d);
+    }
+    else if (done.kind == 'a')
+        ((Array *) done.target)->hash = hashArray(done.target);
+    return deliverCopy(stack, done.slot, done.key, done.kind == 'd' ? 'd' : 'a', done.target);
+}
+
+// Retorna una copia de value, de tipo type, hecha con allocator. Lo anidado se copia con una pila de marcos en lugar
+// de recursion, asi el stack que se usa no depende de la profundidad. Un diccionario se guarda como con
+// storeDictionary, salvo que fresh no sea 0. Retorna NULL si no hay memoria
+void *copyTree(const DictionaryAllocator *allocator, char type, const void *value, int fresh)
+{
+    FrameStack stack;
+    CopyFrame *frame;
+    void *copy = NULL;
+    int ok;
+
+    initFrames(&stack, allocator, sizeof(CopyFrame));
+    ok = beginCopy(&stack, type, value, &copy, NULL, fresh);
+    while (ok && (frame = (CopyFrame *) topFrame(&stack)))
+        ok = continueCopy(&stack, frame);
+
+    if (!ok)
+    {
+        // Las copias a medias que aun no se entregaron no estan en ningun otro lado
+        while ((frame = (CopyFrame *) topFrame(&stack)))
+        {
+            if (!frame->slot)
+                freeValue(allocator, frame->kind == 'd' ? 'd' : 'a', frame->target);
+            popFrame(&stack);
+        }
+        if (copy)
+            freeValue(allocator, type, copy);
+        copy = NULL;
+    }
+
+    freeFrames(&stack);
+    return copy;
+}
+
+// Retorna el tamao de cada valor de una columna de tipo type
+size_t cellSize(char type)
+{
+    if (type == 'n')
+        return sizeof(double);
+    if (type == 'b')
+        return sizeof(Bool);
+    return sizeof(void *);
+}
+
+// Retorna el valor de la fila row de la columna column, de la misma forma en que se guardara en un elemento
+void *cellValue(const Table *table, int column, int row)
+{
+    switch (table->types[column])
+    {
+        case 'n':
+            return (double *) table->values[column] + row;
+        case 'b':
+            return (Bool *) table->values[column] + row;
+        default:
+            return ((void **) table->values[column])[row];
+    }
+}
+
+// Retorna 1 si todos los diccionarios tienen las mismas claves, en el mismo orden y con los mismos tipos,
+// de forma que vale la pena guardarlos por columnas. De lo contrario retorna 0
+int sameShape(int size, Dictionary *value[size])
+{
+    if (size < MIN_TABLE_ROWS || !value[0])
+        return 0;
+
+    int i;
+    for(i = 1; i < size; i++)
+    {
+        Element *aux, *first;
+
+        if (!value[i])
+            return 0;
+
+        // Con la misma forma ya se sabe que tienen las mismas claves, falta comparar los tipos
+        int sameKeys = value[i]->shape && value[i]->shape == value[0]->shape;
+        for(aux = value[i]->first, first = value[0]->first; aux && first; aux = aux->next, first = first->next)
+            if (aux->type != first->type || (!sameKeys && strcmp(aux->key, first->key)))
+                return 0;
+
+        if (aux || first) // Si alguno tiene mas claves que el otro
+            return 0;
+    }
+
+    return 1;
+}
+
+// Crea una tabla vaca de columns columnas, con las columnas en NULL. Retorna NULL si no hay memoria
+Table *newTable(const DictionaryAllocator *allocator, int columns)
+{
+    Table *table;
+    if ((table = (Table *) allocate(allocator, sizeof(Table))) == NULL)
+        return NULL;
+
+    table->columns = columns;
+    table->keys = (char **) allocateArray(allocator, columns, sizeof(char *));
+    table->types = (char *) allocateArray(allocator, columns, sizeof(char));
+    table->values = (void **) allocateArray(allocator, columns, sizeof(void *));
+
+    if (!table->keys || !table->types || !table->values)
+    {
+        release(allocator, table->keys);
+        release(allocator, table->types);
+        release(allocator, table->values);
+        release(allocator, table);
+        return NULL;
+    }
+
+    memset(table->keys, 0, sizeof(char *) * columns);
+    memset(table->values, 0, sizeof(void *) * columns);
+    return table;
+}
+
+// Reserva la columna column de la tabla para rows filas. Las columnas de punteros empiezan en NULL
+// para poder liberarlas aunque no se hayan terminado de llenar. Retorna 0 si no hay memoria
+int allocateColumn(const DictionaryAllocator *allocator, Table *table, int column, int rows)
+{
+    if ((table->values[column] = allocateArray(allocator, rows, cellSize(table->types[column]))) == NULL)
+        return 0;
+
+    if (table->types[column] != 'n' && table->types[column] != 'b')
+        memset(table->values[column], 0, sizeof(void *) * rows);
+
+    return 1;
+}
+
+// Hace free a una tabla sin los valores de sus columnas de punteros
+void releaseTable(const DictionaryAllocator *allocator, Table *table)
+{
+    int i;
+
+    for(i = 0; i < table->columns; i++)
+    {
+        release(allocator, table->values[i]);
+        release(allocator, table->keys[i]);
+    }
+
+    release(allocator, table->keys);
+    release(allocator, table->types);
+    release(allocator, table->values);
+    release(allocator, table);
+}
+
+// Hace free a una tabla de rows filas y a todos sus valores
+void freeTable(const DictionaryAllocator *allocator, Table *table, int rows)
+{
+    int i, j;
+
+    for(i = 0; i < table->columns; i++)
+        if (table->values[i] && table->types[i] != 'n' && table->types[i] != 'b')
+            for(j = 0; j < rows; j++)
+                if (((void **) table->values[i])[j])
+                    freeValue(allocator, table->types[i], ((void **) table->values[i])[j]);
+
+    releaseTable(allocator, table);
+}
+
+// Guarda en la fila row de la columna column una copia de value. Retorna 0 si no hay memoria
+int setCell(const DictionaryAllocator *allocator, Table *table, int column, int row, const void *value)
+{
+    switch (table->types[column])
+    {
+        case 'n':
+            ((double *) table->values[column])[row] = *(const double *) value;
+            return 1;
+        case 'b':
+            ((Bool *) table->values[column])[row] = *(const Bool *) value;
+            return 1;
+        default:
+            return (((void **) table->values[column])[row] = copyValue(allocator, table->types[column], value)) != NULL;
+    }
+}
+
+// Crea una tabla con una copia de los size diccionarios, que deben tener la misma forma segn sameShape.
+// Retorna NULL si no hay memoria
+Table *tableFromDictionaries(const DictionaryAllocator *allocator, int size, Dictionary *value[size])
+{
+    Element *aux;
+    int columns = 0, i, j;
+
+    for(aux = value[0]->first; aux; aux = aux->next)
+        columns++;
+
+    Table *table;
+    if (!(table = newTable(allocator, columns)))
+        return NULL;
+
+    // Las claves y los tipos se toman del primer diccionario
+    for(aux = value[0]->first, i = 0; aux; aux = aux->next, i++)
+    {
+        table->types[i] = aux->type;
+        if (!(table->keys[i] = copyString(allocator, aux->key)) || !allocateColumn(allocator, table, i, size))
+        {
+            freeTable(allocator, table, size);
+            return NULL;
+        }
+    }
+
+    for(j = 0; j < size; j++)
+        for(aux = value[j]->first, i = 0; aux; aux = aux->next, i++)
+            if (!setCell(allocator, table, i, j, aux->value))
+            {
+                freeTable(allocator, table, size);
+                return NULL;
+            }
+
+    return table;
+}
+
+// Crea un diccionario con los valores de la fila row de la tabla. Retorna NULL si no hay memoria
+Dictionary *dictionaryFromRow(const DictionaryAllocator *allocator, const Table *table, int row)
+{
+    Dictionary *d;
+    if (!(d = newDictionaryWithAllocator(allocator)))
+        return NULL;
+
+    Element *last = NULL, *newp;
+    int i;
+
+    for(i = 0; i < table->columns; i++)
+    {
+        char type = table->types[i];
+
+        if (!(newp = newElement(allocator, table->keys[i], type, copyValue(allocator, type, cellValue(table, i, row)))))
+        {
+            freeDictionary(d);
+            return NULL;
+        }
+
+        if (last)
+            last->next = newp;
+        else
+            d->first = newp;
+        last = newp;
+        d->hash += hashElement(newp->key, newp->type, newp->value);
+    }
+
+    shapeDictionary(d); // Sin memoria para la forma el diccionario sigue siendo valido
+    return d;
+}
+
+// Crea un arreglo con un diccionario por cada una de las rows filas de la tabla. Retorna NULL si no hay memoria
+Dictionary **dictionariesFromTable(const DictionaryAllocator *allocator, const Table *table, int rows)
+{
+    Dictionary **arrayElements;
+
+    if ((arrayElements = (Dictionary **) allocateArray(allocator, rows, sizeof(Dictionary *))) == NULL)
+        return NULL;
+
+    int i;
+    for(i = 0; i < rows; i++)
+    {
+        if (!(arrayElements[i] = dictionaryFromRow(allocator, table, i)))
+        {
+            freeArrayElements(allocator, 'd', arrayElements, i);
+            release(allocator, arrayElements);
+            return NULL;
+        }
+    }
+
+    return arrayElements;
+}
+
+// Conecta el nuevo elemento al final de la lista de elementos del diccionario
+void addElement(Dictionary *dictionary, Element *newp)
+{
+    if(!dictionary->first)
+        dictionary->first = newp;
+    else
+    {
+        Element *aux;
+        for(aux = dictionary->first; aux->next; aux = aux->next);
+        aux->next = newp;
+    }
+}
+
+// Agrega el nuevo elemento al diccionario, reemplazando al que tenga la misma clave.
+// Si no hay memoria para agregarlo al indice ordenado le hace free, deja el diccionario como estaba y retorna 0
+int putElement(Dictionary *dictionary, Element *newp)
+{
+    long long comparisons = 0;
+    Element *old = lookupElement(dictionary, newp->key, &comparisons);
+    int wasLast = old && !old->next;
+
+    // Los indices se actualizan primero porque es lo unico que puede fallar. Reemplazar un elemento no necesita memoria
+    if (old)
+    {
+        if (dictionary->orderedIndex)
+            indexReplace(dictionary->orderedIndex, newp);
+        if (dictionary->prefixIndex)
+            prefixReplace(dictionary->prefixIndex, old, newp);
+    }
+    else if (dictionary->orderedIndex && !indexInsert(dictionary, newp))
+    {
+        freeElement(dictionary->allocator, newp);
+        return 0;
+    }
+    else if (dictionary->prefixIndex && !prefixInsert(dictionary, newp))
+    {
+        if (dictionary->orderedIndex)
+            indexRemove(dictionary, newp->key);
+        freeElement(dictionary->allocator, newp);
+        return 0;
+    }
+
+    if (old) // Si la clave ya existe, se elimina
+    {
+        dictionary->hash -= hashElement(old->key, old->type, old->value);
+        freeElement(dictionary->allocator, unlinkElement(dictionary, newp->key));
+    }
+    addElement(dictionary, newp);
+    dictionary->hash += hashElement(newp->key, newp->type, newp->value);
+
+    // Una clave nueva extiende la forma y reemplazar la ultima no la cambia, pero mover otra al final la recalcula.
+    // Si no hay memoria el diccionario se queda sin forma
+    if (dictionary->shape)
+    {
+        int shaped;
+
+        if (!old)
+            shaped = extendShape(dictionary, newp);
+        else if (wasLast)
+        {
+            dictionary->slots[dictionary->shape->size - 1] = newp;
+            shaped = 1;
+        }
+        else
+            shaped = shapeDictionary(dictionary);
+
+        if (!shaped)
+            releaseShape(dictionary);
+    }
+
+    invalidateJson(dictionary);
+    if (dictionary->store)
+        logElement(dictionary, newp, 'S');
+    return 1;
+}
+
+// Generalizacion de las funciones setNumber, setBool, setString, setDictionary
+int setValue(Dictionary *dictionary, const char *key, const void *value, char type)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *newp;
+    if (!(newp = newElement(dictionary->allocator, key, type, copyValue(dictionary->allocator, type, value))))
+        return 0;
+
+    return putElement(dictionary, newp);
+}
+
+// Sets a number for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setNumber(Dictionary *dictionary, const char *key, double value)
+{
+    return setValue(dictionary, key, &value, 'n');
+}
+
+// Saves the number associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int getNumber(const Dictionary *dictionary, const char *key, double *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return 0;
+
+    if(aux->type == 'n')
+    {
+        *result = *( (double *) aux->value);
+        return 1;
+    }
+    return 0;
+}
+
+// Sets a boolean for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setBool(Dictionary *dictionary, const char *key, Bool value)
+{
+    return setValue(dictionary, key, &value, 'b');
+}
+
+// Saves the boolean associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int getBool(const Dictionary *dictionary, const char *key, Bool *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return 0;
+
+    if(aux->type == 'b')
+    {
+        *result = *( (Bool *) aux->value);
+        return 1;
+    }
+    return 0;
+}
+
+// Sets a string for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setString(Dictionary *dictionary, const char *key, const char *value)
+{
+    return setValue(dictionary, key, value, 's');
+}
+
+// Sets the first length characters of value as the string for the given key, like setString. value doesn't need to end
+// in '\0' but must not contain it. Returns 1 if it was able to do it otherwise returns 0
+int setStringWithLength(Dictionary *dictionary, const char *key, const char *value, size_t length)
+{
+    if (!dictionary || memchr(value, '\0', length))
+        return 0;
+
+    STATS_ADD(stringCopies, 1);
+
+    char *copy;
+    Element *newp;
+    if ((copy = (char *) allocate(dictionary->allocator, length + 1)) != NULL)
+    {
+        memcpy(copy, value, length);
+        copy[length] = '\0';
+    }
+
+    if (!(newp = newElement(dictionary->allocator, key, 's', copy)))
+        return 0;
+
+    return putElement(dictionary, newp);
+}
+
+// Returns the string associated to the corresponding key, otherwise returns NULL
+char *getString(const Dictionary *dictionary, const char *key)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 's')
+        return copyString(dictionary->allocator, aux->value); // Es necesario una copia del string
+
+    return NULL;
+}
+
+// Generalizacin de las funciones setNumberArray, setBoolArray, setStringArray y setDictionaryArray
+int setArray(Dictionary *dictionary, const char *key, int size, void *value, char type)
+{
+    if (!dictionary)
+        return 0;
+
+    Array array = {size, value, type, 0, 0, 0};
+    Element *newp;
+    void *copy;
+
+    // Salvo los booleanos, que se guardan como bits, los arreglos se guardan igual que los recibe la funcin
+    if (type == 'b')
+        copy = newArray(dictionary->allocator, packBoolArray(dictionary->allocator, size, value), size, 'b');
+    else
+        copy = copyValue(dictionary->allocator, 'a', &array);
+
+    if (!(newp = newElement(dictionary->allocator, key, 'a', copy)))
+        return 0;
+
+    return putElement(dictionary, newp);
+}
+
+// Sets a numeric array for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setNumberArray(Dictionary *dictionary, const char *key, int size, double value[size])
+{
+    return setArray(dictionary, key, size, value, 'n');
+}
+
+// Returns the numeric array associated to the corresponding key, otherwise returns NULL
+double *getNumberArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 'a' && ((Array *) aux->value)->type == 'n')
+    {
+        *sizeResult = ((Array *) aux->value)->size;
+        return copyNumberArray(dictionary->allocator, *sizeResult, ((Array *) aux->value)->elements);
+    }
+    return NULL;
+}
+
+// Retorna el elemento con la clave key si es un arreglo numerico, de lo contrario retorna NULL
+Element *findNumberArray(const Dictionary *dictionary, const char *key)
+{
+    Element *aux;
+    if (!dictionary || !(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if (aux->type == 'a' && ((Array *) aux->value)->type == 'n')
+        return aux;
+    return NULL;
+}
+
+// Saves the sum of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int sumNumberArray(const Dictionary *dictionary, const char *key, double *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)))
+        return 0;
+
+    *result = kernels()->sum(((Array *) aux->value)->elements, ((Array *) aux->value)->size);
+    return 1;
+}
+
+// Saves the smallest element of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int minNumberArray(const Dictionary *dictionary, const char *key, double *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)) || ((Array *) aux->value)->size == 0)
+        return 0;
+
+    *result = kernels()->min(((Array *) aux->value)->elements, ((Array *) aux->value)->size);
+    return 1;
+}
+
+// Saves the largest element of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int maxNumberArray(const Dictionary *dictionary, const char *key, double *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)) || ((Array *) aux->value)->size == 0)
+        return 0;
+
+    *result = kernels()->max(((Array *) aux->value)->elements, ((Array *) aux->value)->size);
+    return 1;
+}
+
+// Saves the mean of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int meanNumberArray(const Dictionary *dictionary, const char *key, double *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)) || ((Array *) aux->value)->size == 0)
+        return 0;
+
+    Array *array = (Array *) aux->value;
+    *result = kernels()->sum(array->elements, array->size) / array->size;
+    return 1;
+}
+
+// Saves the population variance of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int varianceNumberArray(const Dictionary *dictionary, const char *key, double *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)) || ((Array *) aux->value)->size == 0)
+        return 0;
+
+    // Se calcula primero la media y luego la suma de los cuadrados de las diferencias, que pierde
+    // menos precision que restar la media al cuadrado del promedio de los cuadrados
+    Array *array = (Array *) aux->value;
+    double mean = kernels()->sum(array->elements, array->size) / array->size;
+    *result = kernels()->squaredDeviation(array->elements, array->size, mean) / array->size;
+    return 1;
+}
+
+// Saves the dot product of the numeric array associated to key and the numeric array associated to otherKey in other
+// in result. Both arrays must have the same size.
+// Returns 1 if it was able to get it otherwise returns 0
+int dotNumberArrays(const Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey, double *result)
+{
+    Element *aux, *otherAux;
+    if (!(aux = findNumberArray(dictionary, key)) || !(otherAux = findNumberArray(other, otherKey)))
+        return 0;
+
+    Array *array = (Array *) aux->value, *otherArray = (Array *) otherAux->value;
+    if (array->size != otherArray->size)
+        return 0;
+
+    *result = kernels()->dot(array->elements, otherArray->elements, array->size);
+    return 1;
+}
+
+// Multiplies each element of the numeric array associated to the corresponding key by factor.
+// Returns 1 if it was able to do it otherwise returns 0
+int scaleNumberArray(Dictionary *dictionary, const char *key, double factor)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)))
+        return 0;
+
+    kernels()->scale(((Array *) aux->value)->elements, ((Array *) aux->value)->size, factor);
+    rehashArray(dictionary, aux);
+    invalidateJson(dictionary);
+    if (dictionary->store)
+        logElement(dictionary, aux, 'U');
+    return 1;
+}
+
+// Adds addend to each element of the numeric array associated to the corresponding key.
+// Returns 1 if it was able to do it otherwise returns 0
+int addNumberArray(Dictionary *dictionary, const char *key, double addend)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)))
+        return 0;
+
+    kernels()->add(((Array *) aux->value)->elements, ((Array *) aux->value)->size, addend);
+    rehashArray(dictionary, aux);
+    invalidateJson(dictionary);
+    if (dictionary->store)
+        logElement(dictionary, aux, 'U');
+    return 1;
+}
+
+// Saves how many elements of the numeric array associated to the corresponding key are greater than threshold in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int countNumberArrayAbove(const Dictionary *dictionary, const char *key, double threshold, int *result)
+{
+    Element *aux;
+    if (!(aux = findNumberArray(dictionary, key)))
+        return 0;
+
+    *result = kernels()->countAbove(((Array *) aux->value)->elements, ((Array *) aux->value)->size, threshold);
+    return 1;
+}
+
+// Sets a boolean array for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setBoolArray(Dictionary *dictionary, const char *key, int size, Bool value[size])
+{
+    return setArray(dictionary, key, size, value, 'b');
+}
+
+// Returns the boolean array associated to the corresponding key, otherwise returns NULL
+Bool *getBoolArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 'a' && ((Array *) aux->value)->type == 'b')
+    {
+        *sizeResult = ((Array *) aux->value)->size;
+        return unpackBoolArray(dictionary->allocator, *sizeResult, ((Array *) aux->value)->elements);
+    }
+    return NULL;
+}
+
+// Retorna el elemento con la clave key si es un arreglo booleano, de lo contrario retorna NULL
+Element *findBoolArray(const Dictionary *dictionary, const char *key)
+{
+    Element *aux;
+    if (!dictionary || !(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if (aux->type == 'a' && ((Array *) aux->value)->type == 'b')
+        return aux;
+    return NULL;
+}
+
+// Saves the element at the given index of the boolean array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int getBoolArrayElement(const Dictionary *dictionary, const char *key, int index, Bool *result)
+{
+    Element *aux;
+    if (!(aux = findBoolArray(dictionary, key)))
+        return 0;
+
+    if (index < 0 || index >= ((Array *) aux->value)->size)
+        return 0;
+
+    *result = bitValue(((Array *) aux->value)->elements, index);
+    return 1;
+}
+
+// Saves how many elements of the boolean array associated to the corresponding key are true in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int countBoolArray(const Dictionary *dictionary, const char *key, int *result)
+{
+    Element *aux;
+    if (!(aux = findBoolArray(dictionary, key)))
+        return 0;
+
+    Array *array = (Array *) aux->value;
+    int i, count = 0;
+
+    // Los bits que sobran en la ultima palabra siempre estan en 0, asi que no hace falta tratarla aparte
+    for(i = 0; i < wordCount(array->size); i++)
+        count += __builtin_popcountll(((unsigned long long *) array->elements)[i]);
+
+    *result = count;
+    return 1;
+}
+
+// Generalizacion de andBoolArray y orBoolArray, operation es '&' o '|'
+int combineBoolArrays(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey, char operation)
+{
+    Element *aux, *otherAux;
+    if (!(aux = findBoolArray(dictionary, key)) || !(otherAux = findBoolArray(other, otherKey)))
+        return 0;
+
+    Array *array = (Array *) aux->value, *otherArray = (Array *) otherAux->value;
+    if (array->size != otherArray->size)
+        return 0;
+
+    unsigned long long *bits = array->elements, *otherBits = otherArray->elements;
+    int i, words = wordCount(array->size);
+
+    if (operation == '&')
+        for(i = 0; i < words; i++)
+            bits[i] &= otherBits[i];
+    else
+        for(i = 0; i < words; i++)
+            bits[i] |= otherBits[i];
+
+    rehashArray(dictionary, aux);
+    invalidateJson(dictionary);
+    if (dictionary->store)
+        logElement(dictionary, aux, 'U');
+    return 1;
+}
+
+// Replaces each element of the boolean array associated to key with its logical and with the same element of the boolean
+// array associated to otherKey in other. Both arrays must have the same size.
+// Returns 1 if it was able to do it otherwise returns 0
+int andBoolArray(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey)
+{
+    return combineBoolArrays(dictionary, key, other, otherKey, '&');
+}
+
+// Replaces each element of the boolean array associated to key with its logical or with the same element of the boolean
+// array associated to otherKey in other. Both arrays must have the same size.
+// Returns 1 if it was able to do it otherwise returns 0
+int orBoolArray(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey)
+{
+    return combineBoolArrays(dictionary, key, other, otherKey, '|');
+}
+
+// Sets an array of strings for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setStringArray(Dictionary *dictionary, const char *key, int size, char *value[size])
+{
+    return setArray(dictionary, key, size, value, 's');
+}
+
+// Returns the array of strings associated to the corresponding key, otherwise returns NULL
+char **getStringArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 'a' && ((Array *) aux->value)->type == 's')
+    {
+        *sizeResult = ((Array *) aux->value)->size;
+        return copyStringArray(dictionary->allocator, *sizeResult, ((Array *) aux->value)->elements);
+    }
+    return NULL;
+}
+
+// Sets a dictionary for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setDictionary(Dictionary *dictionary, const char *key, Dictionary *value)
+{
+    return setValue(dictionary, key, value, 'd');
+}
+
+// Sets a dictionary for the given key like setDictionary, but takes value instead of copying it: from then on value
+// belongs to dictionary and must not be used or freed. It is still copied, and then freed, if it uses another allocator,
+// if it is shared, if setInterning is enabled or if it was opened with openDictionaryStore. value can't be dictionary itself.
+// Returns 1 if it was able to do it otherwise returns 0, and value is freed anyway unless it was dictionary
+int moveDictionary(Dictionary *dictionary, const char *key, Dictionary *value)
+{
+    if (!dictionary || !value || value == dictionary)
+    {
+        if (value != dictionary)
+            freeDictionary(value);
+        return 0;
+    }
+
+    // Todo lo que contiene un diccionario usa su allocator, y con interning lo anidado tiene que ser compartido
+    if (value->allocator != dictionary->allocator || isShared(value) || interning || value->store)
+    {
+        int set = setDictionary(dictionary, key, value);
+        freeDictionary(value);
+        return set;
+    }
+
+    Element *newp;
+    if (!(newp = newElement(dictionary->allocator, key, 'd', value)))
+        return 0;
+
+    return putElement(dictionary, newp);
+}
+
+// Returns the dictionary associated to the corresponding key, otherwise returns NULL
+Dictionary *getDictionary(const Dictionary *dictionary, const char *key)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 'd')
+        return copyDictionary(dictionary->allocator, aux->value); // Es necesario hacer una copia del diccionario
+
+    return NULL;
+}
+
+// Sets an array of dictionaries for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setDictionaryArray(Dictionary *dictionary, const char *key, int size, Dictionary *value[size])
+{
+    return setArray(dictionary, key, size, value, 'd');
+}
+
+// Sets a null for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setNull(Dictionary *dictionary, const char *key)
+{
+    return setValue(dictionary, key, &nullValue, 'z');
+}
+
+// Returns the array of dictionaries associated to the corresponding key, otherwise returns NULL
+Dictionary **getDictionaryArray(const Dictionary *dictionary, const char *key, int *sizeResult)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return NULL;
+
+    if(aux->type == 'a' && ((Array *) aux->value)->type == 'd')
+    {
+        *sizeResult = ((Array *) aux->value)->size;
+        return copyDictionaryArray(dictionary->allocator, *sizeResult, ((Array *) aux->value)->elements);
+    }
+    if(aux->type == 'a' && ((Array *) aux->value)->type == 'c') // Si se guard por columnas se crean los diccionarios
+    {
+        *sizeResult = ((Array *) aux->value)->size;
+        return dictionariesFromTable(dictionary->allocator, ((Array *) aux->value)->elements, *sizeResult);
+    }
+    return NULL;
+}
+
+// Returns the numbers saved with the key column in each dictionary of the array associated to the corresponding key,
+// otherwise returns NULL
+double *getNumberColumn(const Dictionary *dictionary, const char *key, const char *column, int *sizeResult)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)) || aux->type != 'a')
+        return NULL;
+
+    Array *array = (Array *) aux->value;
+    int i;
+
+    if (array->type == 'c') // Si se guard por columnas basta con copiar la columna
+    {
+        Table *table = (Table *) array->elements;
+        for(i = 0; i < table->columns; i++)
+        {
+            if (!strcmp(table->keys[i], column))
+            {
+                if (table->types[i] != 'n')
+                    return NULL;
+                *sizeResult = array->size;
+                return copyNumberArray(dictionary->allocator, array->size, table->values[i]);
+            }
+        }
+        return NULL;
+    }
+
+    if (array->type != 'd')
+        return NULL;
+
+    double *numbers;
+    if ((numbers = (double *) allocateArray(dictionary->allocator, array->size, sizeof(double))) == NULL)
+        return NULL;
+
+    for(i = 0; i < array->size; i++) // Si no, se busca en cada diccionario
+    {
+        if (!getNumber(((Dictionary **) array->elements)[i], column, numbers + i))
+        {
+            release(dictionary->allocator, numbers);
+            return NULL;
+        }
+    }
+
+    *sizeResult = array->size;
+    return numbers;
+}
+
+// Crea un nodo vacio del arbol B, o retorna NULL si no hay memoria
+IndexNode *newIndexNode(const DictionaryAllocator *allocator, int leaf)
+{
+    IndexNode *node;
+    if ((node = (IndexNode *) allocate(allocator, sizeof(IndexNode))) == NULL)
+        return NULL;
+
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+// Hace free a un nodo del arbol B y a sus hijos, pero no a los elementos
+void freeIndexNode(const DictionaryAllocator *allocator, IndexNode *node)
+{
+    int i;
+    if (!node->leaf)
+        for(i = 0; i <= node->count; i++)
+            freeIndexNode(allocator, node->children[i]);
+    release(allocator, node);
+}
+
+// Suma a usage lo que ocupa un nodo del arbol B y sus hijos
+void addIndexUsage(const IndexNode *node, DictionaryUsage *usage)
+{
+    int i;
+    usage->indexBytes += sizeof(IndexNode);
+    usage->allocations++;
+    if (!node->leaf)
+        for(i = 0; i <= node->count; i++)
+            addIndexUsage(node->children[i], usage);
+}
+
+// Retorna la posicion del primer elemento del nodo cuya clave es mayor o igual a key, o count si no hay ninguno.
+// Suma a comparisons las claves comparadas
+int indexPosition(const IndexNode *node, const char *key, long long *comparisons)
+{
+    int low = 0, high = node->count, middle;
+
+    while (low < high) // Busqueda binaria
+    {
+        middle = (low + high) / 2;
+        (*comparisons)++;
+        if (strcmp(node->elements[middle]->key, key) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Retorna el elemento con la clave key del arbol que empieza en node, o NULL si no existe
+Element *indexFind(const IndexNode *node, const char *key, long long *comparisons)
+{
+    int i;
+    for(;;)
+    {
+        i = indexPosition(node, key, comparisons);
+        if (i < node->count && !strcmp(node->elements[i]->key, key))
+            return node->elements[i];
+        if (node->leaf)
+            return NULL;
+        node = node->children[i];
+    }
+}
+
+// Reemplaza en el arbol el elemento con la misma clave que element. Retorna 0 si no existe
+int indexReplace(IndexNode *node, Element *element)
+{
+    long long comparisons = 0;
+    int i;
+    for(;;)
+    {
+        i = indexPosition(node, element->key, &comparisons);
+        if (i < node->count && !strcmp(node->elements[i]->key, element->key))
+        {
+            node->elements[i] = element;
+            return 1;
+        }
+        if (node->leaf)
+            return 0;
+        node = node->children[i];
+    }
+}
+
+// Divide en dos el hijo i de parent, que esta lleno, subiendo su elemento del medio a parent, que no esta lleno.
+// Retorna 0 si no hay memoria, sin cambiar nada
+int splitIndexChild(const DictionaryAllocator *allocator, IndexNode *parent, int i)
+{
+    IndexNode *child = parent->children[i], *sibling;
+    if ((sibling = newIndexNode(allocator, child->leaf)) == NULL)
+        return 0;
+
+    // La mitad superior del hijo pasa al nuevo nodo
+    sibling->count = INDEX_DEGREE - 1;
+    memcpy(sibling->elements, child->elements + INDEX_DEGREE, sizeof(Element *) * (INDEX_DEGREE - 1));
+    if (!child->leaf)
+        memcpy(sibling->children, child->children + INDEX_DEGREE, sizeof(IndexNode *) * INDEX_DEGREE);
+    child->count = INDEX_DEGREE - 1;
+
+    memmove(parent->elements + i + 1, parent->elements + i, sizeof(Element *) * (parent->count - i));
+    memmove(parent->children + i + 2, parent->children + i + 1, sizeof(IndexNode *) * (parent->count - i));
+    parent->elements[i] = child->elements[INDEX_DEGREE - 1];
+    parent->children[i + 1] = sibling;
+    parent->count++;
+    return 1;
+}
+
+// Agrega al indice un elemento cuya clave no esta en el. Los nodos llenos se dividen al bajar, asi siempre hay lugar
+// para subir el elemento del medio. Retorna 0 si no hay memoria, en ese caso el elemento no queda en el indice
+int indexInsert(Dictionary *dictionary, Element *element)
+{
+    IndexNode *node = dictionary->orderedIndex, *root;
+    long long comparisons = 0;
+    int i;
+
+    if (node->count == 2 * INDEX_DEGREE - 1) // Si la raiz esta llena el arbol crece un nivel
+    {
+        if ((root = newIndexNode(dictionary->allocator, 0)) == NULL)
+            return 0;
+        root->children[0] = node;
+        if (!splitIndexChild(dictionary->allocator, root, 0))
+        {
+            release(dictionary->allocator, root);
+            return 0;
+        }
+        dictionary->orderedIndex = node = root;
+    }
+
+    for(;;)
+    {
+        i = indexPosition(node, element->key, &comparisons);
+        if (node->leaf)
+        {
+            memmove(node->elements + i + 1, node->elements + i, sizeof(Element *) * (node->count - i));
+            node->elements[i] = element;
+            node->count++;
+            return 1;
+        }
+        if (node->children[i]->count == 2 * INDEX_DEGREE - 1)
+        {
+            if (!splitIndexChild(dictionary->allocator, node, i))
+                return 0;
+            if (strcmp(element->key, node->elements[i]->key) > 0)
+                i++;
+        }
+        node = node->children[i];
+    }
+}
+
+// Une el hijo i + 1 de parent al hijo i, bajando entre ellos el elemento i de parent
+void mergeIndexChildren(const DictionaryAllocator *allocator, IndexNode *parent, int i)
+{
+    IndexNode *child = parent->children[i], *sibling = parent->children[i + 1];
+
+    child->elements[child->count] = parent->elements[i];
+    memcpy(child->elements + child->count + 1, sibling->elements, sizeof(Element *) * sibling->count);
+    if (!child->leaf)
+        memcpy(child->children + child->count + 1, sibling->children, sizeof(IndexNode *) * (sibling->count + 1));
+    child->count += sibling->count + 1;
+
+    memmove(parent->elements + i, parent->elements + i + 1, sizeof(Element *) * (parent->count - i - 1));
+    memmove(parent->children + i + 1, parent->children + i + 2, sizeof(IndexNode *) * (parent->count - i - 1));
+    parent->count--;
+    release(allocator, sibling);
+}
+
+// Asegura que el hijo i de parent tenga al menos INDEX_DEGREE elementos antes de bajar a borrar en el,
+// pasandole uno de un hermano o uniendolo con uno de ellos
+void fillIndexChild(const DictionaryAllocator *allocator, IndexNode *parent, int i)
+{
+    IndexNode *child = parent->children[i], *sibling;
+
+    if (i > 0 && (sibling = parent->children[i - 1])->count >= INDEX_DEGREE) // Se pasa uno del hermano izquierdo
+    {
+        memmove(child->elements + 1, child->elements, sizeof(Element *) * child->count);
+        if (!child->leaf)
+            memmove(child->children + 1, child->children, sizeof(IndexNode *) * (child->count + 1));
+        child->elements[0] = parent->elements[i - 1];
+        if (!child->leaf)
+            child->children[0] = sibling->children[sibling->count];
+        parent->elements[i - 1] = sibling->elements[sibling->count - 1];
+        sibling->count--;
+        child->count++;
+    }
+    else if (i < parent->count && (sibling = parent->children[i + 1])->count >= INDEX_DEGREE) // O del derecho
+    {
+        child->elements[child->count] = parent->elements[i];
+        if (!child->leaf)
+            child->children[child->count + 1] = sibling->children[0];
+        parent->elements[i] = sibling->elements[0];
+        memmove(sibling->elements, sibling->elements + 1, sizeof(Element *) * (sibling->count - 1));
+        if (!sibling->leaf)
+            memmove(sibling->children, sibling->children + 1, sizeof(IndexNode *) * sibling->count);
+        sibling->count--;
+        child->count++;
+    }
+    else if (i < parent->count)
+        mergeIndexChildren(allocator, parent, i);
+    else
+        mergeIndexChildren(allocator, parent, i - 1);
+}
+
+// Quita el elemento con la clave key del arbol que empieza en node. Cada nodo al que se baja tiene al menos
+// INDEX_DEGREE elementos, asi puede perder uno sin quedar con menos del minimo
+void indexDelete(const DictionaryAllocator *allocator, IndexNode *node, const char *key)
+{
+    long long comparisons = 0;
+    IndexNode *aux;
+    int i;
+
+    for(;;)
+    {
+        i = indexPosition(node, key, &comparisons);
+        if (i < node->count && !strcmp(node->elements[i]->key, key))
+        {
+            if (node->leaf)
+            {
+                memmove(node->elements + i, node->elements + i + 1, sizeof(Element *) * (node->count - i - 1));
+                node->count--;
+                return;
+            }
+
+            // En un nodo interno se reemplaza por el anterior o el siguiente en orden, y se borra ese
+            if (node->children[i]->count >= INDEX_DEGREE)
+            {
+                for(aux = node->children[i]; !aux->leaf; aux = aux->children[aux->count]);
+                node->elements[i] = aux->elements[aux->count - 1];
+                key = node->elements[i]->key;
+                node = node->children[i];
+            }
+            else if (node->children[i + 1]->count >= INDEX_DEGREE)
+            {
+                for(aux = node->children[i + 1]; !aux->leaf; aux = aux->children[0]);
+                node->elements[i] = aux->elements[0];
+                key = node->elements[i]->key;
+                node = node->children[i + 1];
+            }
+            else
+            {
+                mergeIndexChildren(allocator, node, i);
+                node = node->children[i];
+            }
+            continue;
+        }
+
+        if (node->leaf) // No esta en el arbol
+            return;
+
+        if (node->children[i]->count < INDEX_DEGREE)
+        {
+            fillIndexChild(allocator, node, i);
+            if (i > node->count) // Se unio con el hermano izquierdo
+                i--;
+        }
+        node = node->children[i];
+    }
+}
+
+// Quita del indice ordenado el elemento con la clave key
+void indexRemove(Dictionary *dictionary, const char *key)
+{
+    IndexNode *root = dictionary->orderedIndex;
+
+    indexDelete(dictionary->allocator, root, key);
+    if (root->count == 0 && !root->leaf) // Si la raiz quedo vacia el arbol baja un nivel
+    {
+        dictionary->orderedIndex = root->children[0];
+        release(dictionary->allocator, root);
+    }
+}
+
+// Keeps the keys of the dictionary sorted in a B-tree, used from then on to find keys and to iterate in key order.
+// Copies of the dictionary don't have the index. Returns 1 if it was able to do it otherwise returns 0
+int createOrderedIndex(Dictionary *dictionary)
+{
+    if (!dictionary)
+        return 0;
+    if (dictionary->orderedIndex)
+        return 1;
+
+    if ((dictionary->orderedIndex = newIndexNode(dictionary->allocator, 1)) == NULL)
+        return 0;
+
+    Element *aux;
+    for(aux = dictionary->first; aux; aux = aux->next)
+    {
+        if (!indexInsert(dictionary, aux))
+        {
+            dropOrderedIndex(dictionary);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Releases the ordered index of the dictionary, if it has one
+void dropOrderedIndex(Dictionary *dictionary)
+{
+    if (!dictionary || !dictionary->orderedIndex)
+        return;
+
+    freeIndexNode(dictionary->allocator, dictionary->orderedIndex);
+    dictionary->orderedIndex = NULL;
+}
+
+// Crea un nodo del arbol radix sin hijos cuya etiqueta va desde start hasta el final de la clave de owner,
+// o retorna NULL si no hay memoria
+PrefixNode *newPrefixNode(const DictionaryAllocator *allocator, const Element *owner, int start, Element *element)
+{
+    PrefixNode *node;
+    if ((node = (PrefixNode *) allocate(allocator, sizeof(PrefixNode))) == NULL)
+        return NULL;
+
+    node->owner = owner;
+    node->start = start;
+    node->length = owner ? (int) strlen(owner->key + start) : 0;
+    node->element = element;
+    node->count = 0;
+    node->child = NULL;
+    node->sibling = NULL;
+    return node;
+}
+
+// Hace free a un nodo del arbol radix y a sus hijos, pero no a los elementos
+void freePrefixNode(const DictionaryAllocator *allocator, PrefixNode *node)
+{
+    PrefixNode *aux;
+    for(; node->child; node->child = aux)
+    {
+        aux = node->child->sibling;
+        freePrefixNode(allocator, node->child);
+    }
+    release(allocator, node);
+}
+
+// Suma a usage lo que ocupa un nodo del arbol radix y sus hijos
+void addPrefixUsage(const PrefixNode *node, DictionaryUsage *usage)
+{
+    const PrefixNode *aux;
+    usage->indexBytes += sizeof(PrefixNode);
+    usage->allocations++;
+    for(aux = node->child; aux; aux = aux->sibling)
+        addPrefixUsage(aux, usage);
+}
+
+// Retorna el enlace al hijo de node cuya etiqueta empieza con c, o al lugar donde deberia estar si no existe
+PrefixNode **findPrefixChild(PrefixNode *node, char c)
+{
+    PrefixNode **link;
+    for(link = &node->child; *link; link = &(*link)->sibling)
+        if ((unsigned char) (*link)->owner->key[(*link)->start] >= (unsigned char) c)
+            break;
+    return link;
+}
+
+// Retorna el nodo mas alto cuyo subarbol tiene todas las claves que empiezan con prefix, o NULL si no hay ninguna.
+// Si exact no es 0 solo lo retorna si prefix termina justo en el nodo. Suma a comparisons los nodos visitados
+PrefixNode *prefixSubtree(const PrefixNode *root, const char *prefix, int exact, long long *comparisons)
+{
+    PrefixNode *node = (PrefixNode *) root, *child;
+    int depth = 0, i;
+
+    while (prefix[depth])
+    {
+        (*comparisons)++;
+        child = *findPrefixChild(node, prefix[depth]);
+        if (!child || child->owner->key[child->start] != prefix[depth])
+            return NULL;
+
+        for(i = 1; i < child->length && prefix[depth + i]; i++)
+            if (child->owner->key[child->start + i] != prefix[depth + i])
+                return NULL;
+
+        if (i < child->length) // El prefijo termina en medio de la etiqueta
+            return exact ? NULL : child;
+        node = child;
+        depth += i;
+    }
+    return node;
+}
+
+// Agrega al indice un elemento cuya clave no esta en el. Retorna 0 si no hay memoria, sin cambiar el indice
+int prefixInsert(Dictionary *dictionary, Element *element)
+{
+    PrefixNode *path[sizeof(element->key) + 1], *node = dictionary->prefixIndex, *child, *middle, *leaf = NULL, **link;
+    const char *key = element->key;
+    int depth = 0, n = 0, i;
+
+    path[n++] = node;
+    for(;;)
+    {
+        if (!key[depth]) // La clave termina en un nodo que ya existe
+        {
+            node->element = element;
+            break;
+        }
+
+        link = findPrefixChild(node, key[depth]);
+        child = *link;
+        if (!child || child->owner->key[child->start] != key[depth]) // Ningun hijo comparte caracteres, se agrega uno
+        {
+            if ((leaf = newPrefixNode(dictionary->allocator, element, depth, element)) == NULL)
+                return 0;
+            leaf->sibling = child;
+            *link = leaf;
+            path[n++] = leaf;
+            break;
+        }
+
+        for(i = 1; i < child->length && child->owner->key[child->start + i] == key[depth + i]; i++);
+        if (i == child->length)
+        {
+            node = child;
+            depth += i;
+            path[n++] = node;
+            continue;
+        }
+
+        // La clave se separa en medio de la etiqueta del hijo, se divide en un nodo con la parte comun y el hijo
+        if ((middle = newPrefixNode(dictionary->allocator, child->owner, child->start, NULL)) == NULL ||
+            (key[depth + i] && (leaf = newPrefixNode(dictionary->allocator, element, depth + i, element)) == NULL))
+        {
+            release(dictionary->allocator, middle);
+            return 0;
+        }
+        middle->length = i;
+        middle->count = child->count;
+        middle->sibling = child->sibling;
+        middle->child = child;
+        child->start += i;
+        child->length -= i;
+        child->sibling = NULL;
+        *link = middle;
+        path[n++] = middle;
+
+        if (!leaf)
+            middle->element = element;
+        else
+        {
+            if ((unsigned char) key[depth + i] < (unsigned char) child->owner->key[child->start])
+            {
+                leaf->sibling = child;
+                middle->child = leaf;
+            }
+            else
+                child->sibling = leaf;
+            path[n++] = leaf;
+        }
+        break;
+    }
+
+    for(i = 0; i < n; i++)
+        path[i]->count++;
+    return 1;
+}
+
+// Reemplaza en el indice el elemento old por element, que tiene la misma clave
+void prefixReplace(PrefixNode *root, const Element *old, Element *element)
+{
+    PrefixNode *node = root;
+    int depth = 0;
+
+    while (element->key[depth])
+    {
+        node = *findPrefixChild(node, element->key[depth]);
+        if (node->owner == old)
+            node->owner = element;
+        depth += node->length;
+    }
+    node->element = element;
+}
+
+// Retorna algun elemento del subarbol de node, que no debe estar vacio
+const Element *anyPrefixElement(const PrefixNode *node)
+{
+    while (!node->element)
+        for(node = node->child; node->count == 0; node = node->sibling); // Salta el nodo que se esta quitando
+    return node->element;
+}
+
+// Une a node su unico hijo, cuando node no tiene elemento
+void mergePrefixChild(const DictionaryAllocator *allocator, PrefixNode *node)
+{
+    PrefixNode *child = node->child;
+
+    // La clave del dueo de la etiqueta del hijo tambien contiene la etiqueta de node
+    node->owner = child->owner;
+    node->length += child->length;
+    node->element = child->element;
+    node->child = child->child;
+    release(allocator, child);
+}
+
+// Quita del indice el elemento, que debe estar en el
+void prefixRemove(Dictionary *dictionary, const Element *element)
+{
+    PrefixNode *path[sizeof(element->key) + 1], **links[sizeof(element->key) + 1], *node = dictionary->prefixIndex;
+    int depth = 0, n = 0, i;
+
+    path[n] = node;
+    links[n++] = NULL;
+    while (element->key[depth])
+    {
+        links[n] = findPrefixChild(node, element->key[depth]);
+        node = path[n] = *links[n];
+        depth += node->length;
+        n++;
+    }
+    node->element = NULL;
+
+    for(i = 0; i < n; i++)
+        path[i]->count--;
+    for(i = 0; i < n; i++)
+        if (path[i]->owner == element && path[i]->count > 0) // Las etiquetas no pueden quedar en la clave del elemento
+            path[i]->owner = anyPrefixElement(path[i]);
+
+    // Cada nodo salvo la raiz tiene un elemento o al menos dos hijos. Si el nodo quedo vacio se quita, y puede
+    // que su padre quede con un solo hijo; si no, puede que sea el nodo el que quede con un solo hijo
+    if (node == dictionary->prefixIndex)
+        return;
+    if (node->count == 0)
+    {
+        *links[n - 1] = node->sibling;
+        release(dictionary->allocator, node);
+        node = path[n - 2];
+    }
+    if (node != dictionary->prefixIndex && !node->element && node->child && !node->child->sibling)
+        mergePrefixChild(dictionary->allocator, node);
+}
+
+// Llama a callback con los elementos del subarbol de node en orden de clave, hasta que retorne 0.
+// Retorna 0 si callback retorno 0
+int visitPrefixNode(const PrefixNode *node, int (*callback)(const DictionaryEntry *entry, void *data), void *data)
+{
+    DictionaryEntry entry;
+    const PrefixNode *aux;
+
+    if (node->element) // La clave del nodo es prefijo de las de sus hijos, asi que va antes
+    {
+        fillEntry(node->element, &entry);
+        if (!callback(&entry, data))
+            return 0;
+    }
+    for(aux = node->child; aux; aux = aux->sibling)
+        if (!visitPrefixNode(aux, callback, data))
+            return 0;
+    return 1;
+}
+
+// Keeps the keys of the dictionary in a radix tree, used from then on to find keys and elements by prefix.
+// Copies of the dictionary don't have the index. Returns 1 if it was able to do it otherwise returns 0
+int createPrefixIndex(Dictionary *dictionary)
+{
+    if (!dictionary)
+        return 0;
+    if (dictionary->prefixIndex)
+        return 1;
+
+    if ((dictionary->prefixIndex = newPrefixNode(dictionary->allocator, NULL, 0, NULL)) == NULL)
+        return 0;
+
+    Element *aux;
+    for(aux = dictionary->first; aux; aux = aux->next)
+    {
+        if (!prefixInsert(dictionary, aux))
+        {
+            dropPrefixIndex(dictionary);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Releases the prefix index of the dictionary, if it has one
+void dropPrefixIndex(Dictionary *dictionary)
+{
+    if (!dictionary || !dictionary->prefixIndex)
+        return;
+
+    freePrefixNode(dictionary->allocator, dictionary->prefixIndex);
+    dictionary->prefixIndex = NULL;
+}
+
+// Calls callback in key order with each element whose key starts with prefix, until it returns 0, like forEachEntry.
+// Returns 1 if every element was visited otherwise returns 0, which also happens if the dictionary has no prefix index
+int forEachEntryWithPrefix(const Dictionary *dictionary, const char *prefix,
+                           int (*callback)(const DictionaryEntry *entry, void *data), void *data)
+{
+    if (!dictionary || !dictionary->prefixIndex)
+        return 0;
+
+    long long comparisons = 0;
+    PrefixNode *node;
+    if (!(node = prefixSubtree(dictionary->prefixIndex, prefix, 0, &comparisons)))
+        return 1;
+    return visitPrefixNode(node, callback, data);
+}
+
+// Saves in result how many keys start with prefix.
+// Returns 1 if it was able to get it otherwise returns 0, which happens if the dictionary has no prefix index
+int countEntriesWithPrefix(const Dictionary *dictionary, const char *prefix, int *result)
+{
+    if (!dictionary || !dictionary->prefixIndex)
+        return 0;
+
+    long long comparisons = 0;
+    PrefixNode *node = prefixSubtree(dictionary->prefixIndex, prefix, 0, &comparisons);
+    *result = node ? node->count : 0;
+    return 1;
+}
+
+// Retorna la forma que agrega key a shape, creandola si no existe, o NULL si no hay memoria.
+// Se llama con shapesLock tomado. Una forma nueva no tiene referencias
+Shape *shapeTransition(Shape *shape, const char *key)
+{
+    Shape *child;
+
+    for(child = shape->child; child; child = child->sibling)
+        if (!strcmp(child->key, key))
+            return child;
+
+    // Las formas son de todos los diccionarios, asi que no usan el allocator de ninguno
+    if (!(child = (Shape *) malloc(sizeof(Shape))))
+        return NULL;
+
+    child->parent = shape;
+    strcpy(child->key, key);
+    child->size = shape->size + 1;
+    child->id = nextShapeId++;
+    child->references = 0;
+    child->child = NULL;
+    child->sibling = shape->child;
+    shape->child = child;
+    referenceShape(shape);
+    return child;
+}
+
+// Retorna la forma que agrega key a shape, o NULL si no hay memoria. Si no esta en la cache del hilo la busca o la crea
+// con shapesLock tomado y la agrega a la cache. Se mantiene mientras el hilo no busque otra, y sus padres mientras ella
+// exista, asi quien la recibe puede tomar una referencia sin el lock
+Shape *findTransition(Shape *shape, const char *key)
+{
+    ShapeCache *cache = &shapeCache;
+    int i = (hashText(key) ^ shape->id * 0x9e3779b97f4a7c15ULL) % SHAPE_CACHE_SIZE;
+    Shape *child = cache->shapes[i], *old;
+
+    if (child && child->parent == shape && !strcmp(child->key, key))
+        return child;
+
+    if (!cache->registered)
+    {
+        pthread_once(&shapeCacheOnce, createShapeCacheKey);
+        pthread_setspecific(shapeCacheKey, cache);
+        cache->registered = 1;
+    }
+
+    pthread_mutex_lock(&shapesLock);
+    if ((child = shapeTransition(shape, key)) != NULL)
+    {
+        referenceShape(child);
+        old = cache->shapes[i];
+        cache->shapes[i] = child;
+        if (old)
+            dropShape(old);
+    }
+    pthread_mutex_unlock(&shapesLock);
+    return child;
+}
+
+void createShapeCacheKey()
+{
+    pthread_key_create(&shapeCacheKey, retireShapeCache);
+}
+
+// Suelta las formas de la cache de un hilo que termina
+void retireShapeCache(void *cache)
+{
+    ShapeCache *c = (ShapeCache *) cache;
+    int i;
+
+    for(i = 0; i < SHAPE_CACHE_SIZE; i++)
+        if (c->shapes[i])
+            unreferenceShape(c->shapes[i]);
+    memset(c, 0, sizeof(ShapeCache));
+}
+
+// Agrega una referencia a la forma, de la que ya se tiene una o que se obtuvo de findTransition
+void referenceShape(Shape *shape)
+{
+    __atomic_add_fetch(&shape->references, 1, __ATOMIC_RELAXED);
+}
+
+// Quita una referencia a la forma. Si es la ultima toma shapesLock, porque la forma se libera
+void unreferenceShape(Shape *shape)
+{
+    int references = __atomic_load_n(&shape->references, __ATOMIC_RELAXED);
+
+    // Sin el lock nadie mas puede quitar la ultima referencia, asi que si hay otras basta con restar
+    while (references > 1)
+        if (__atomic_compare_exchange_n(&shape->references, &references, references - 1, 0, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+            return;
+
+    pthread_mutex_lock(&shapesLock);
+    dropShape(shape);
+    pthread_mutex_unlock(&shapesLock);
+}
+
+// Quita una referencia a la forma, liberandola si era la ultima junto con los padres que se queden sin referencias.
+// Se llama con shapesLock tomado
+void dropShape(Shape *shape)
+{
+    Shape *parent, **link;
+
+    while (__atomic_sub_fetch(&shape->references, 1, __ATOMIC_ACQ_REL) == 0 && shape->parent)
+    {
+        parent = shape->parent;
+        for(link = &parent->child; *link != shape; link = &(*link)->sibling);
+        *link = shape->sibling;
+        free(shape);
+        shape = parent;
+    }
+}
+
+// Quita la forma del diccionario, si tiene una
+void releaseShape(Dictionary *dictionary)
+{
+    if (!dictionary->shape)
+        return;
+
+    unreferenceShape(dictionary->shape);
+
+    release(dictionary->allocator, dictionary->slots);
+    dictionary->shape = NULL;
+    dictionary->slots = NULL;
+    dictionary->slotCapacity = 0;
+}
+
+// Le da al diccionario sin forma la forma shape, que debe ser la de sus claves. Si no hay memoria lo deja sin forma
+void shareShape(Dictionary *dictionary, Shape *shape)
+{
+    int capacity = shape->size > 0 ? shape->size : 1, i = 0;
+    Element *aux;
+
+    if (!(dictionary->slots = (Element **) allocate(dictionary->allocator, capacity * sizeof(Element *))))
+        return;
+    for(aux = dictionary->first; aux; aux = aux->next)
+        dictionary->slots[i++] = aux;
+
+    referenceShape(shape);
+    dictionary->shape = shape;
+    dictionary->slotCapacity = capacity;
+}
+
+// Extiende la forma del diccionario con newp, que se acaba de agregar al final.
+// Retorna 0 si no hay memoria, dejando la forma como estaba
+int extendShape(Dictionary *dictionary, Element *newp)
+{
+    Shape *shape;
+    int size = dictionary->shape->size;
+
+    if (size == dictionary->slotCapacity)
+    {
+        Element **slots;
+        if (!(slots = (Element **) reallocate(dictionary->allocator, dictionary->slots, 2 * size * sizeof(Element *))))
+            return 0;
+        dictionary->slots = slots;
+        dictionary->slotCapacity = 2 * size;
+    }
+
+    if (!(shape = findTransition(dictionary->shape, newp->key)))
+        return 0;
+
+    referenceShape(shape);
+    unreferenceShape(dictionary->shape);
+    dictionary->shape = shape;
+    dictionary->slots[size] = newp;
+    return 1;
+}
+
+// Gives the dictionary the shape of its keys, shared with every dictionary that has the same keys in the same order,
+// so accessors find them without searching. Setting a new key extends the shape and any other change recomputes it.
+// dictionaryFromJson and getDictionaryArray return dictionaries with shape, and copies keep it.
+// Returns 1 if it was able to do it otherwise returns 0
+int shapeDictionary(Dictionary *dictionary)
+{
+    if (!dictionary)
+        return 0;
+
+    Shape *shape = &rootShape, *next, *old = dictionary->shape;
+    Element **slots, **oldSlots = dictionary->slots, *aux;
+    int size = 0;
+
+    for(aux = dictionary->first; aux; aux = aux->next)
+        size++;
+    if (!(slots = (Element **) allocate(dictionary->allocator, (size > 0 ? size : 1) * sizeof(Element *))))
+        return 0;
+
+    // Las formas intermedias no necesitan referencias, cada una se mantiene mientras exista la siguiente
+    for(aux = dictionary->first; aux; aux = aux->next)
+    {
+        if (!(next = findTransition(shape, aux->key)))
+        {
+            release(dictionary->allocator, slots); // Falto memoria, las formas creadas se liberan al salir de la cache
+            return 0;
+        }
+        shape = next;
+    }
+    referenceShape(shape);
+    if (old)
+        unreferenceShape(old);
+
+    size = 0;
+    for(aux = dictionary->first; aux; aux = aux->next)
+        slots[size++] = aux;
+
+    release(dictionary->allocator, oldSlots);
+    dictionary->shape = shape;
+    dictionary->slots = slots;
+    dictionary->slotCapacity = size > 0 ? size : 1;
+    return 1;
+}
+
+// Prepares accessor to find key. The accessor remembers the slot of key in the shape of the last dictionary it was
+// used with, so using it with dictionaries of that shape doesn't search the key. An accessor must not be used by
+// several threads at the same time. Returns 1 if it was able to do it otherwise returns 0, which happens if the key is
+// too long to be in a dictionary
+int initAccessor(DictionaryAccessor *accessor, const char *key)
+{
+    if (strlen(key) >= sizeof(accessor->key))
+        return 0;
+
+    strcpy(accessor->key, key);
+    accessor->shapeId = 0;
+    accessor->slot = -1;
+    return 1;
+}
+
+// Retorna el elemento con la clave del accessor, o NULL si no existe. Si la forma del diccionario no es la que
+// recuerda el accessor busca el slot de la clave en ella, y si el diccionario no tiene forma busca la clave
+Element *accessElement(const Dictionary *dictionary, DictionaryAccessor *accessor)
+{
+    const Shape *shape = dictionary->shape, *aux;
+    long long comparisons = 0;
+
+    if (!shape)
+        return findElement(dictionary, accessor->key);
+
+    // La forma no se libera mientras el diccionario la tenga, y sus claves y padres no cambian, asi que no hace
+    // falta tomar shapesLock
+    if (shape->id != accessor->shapeId)
+    {
+        for(aux = shape; aux->parent; aux = aux->parent)
+        {
+            comparisons++;
+            if (!strcmp(aux->key, accessor->key))
+                break;
+        }
+        accessor->shapeId = shape->id;
+        accessor->slot = aux->size - 1; // La forma sin claves tiene size 0, asi que el slot queda en -1
+    }
+
+    STATS_ADD(lookups, 1);
+    STATS_ADD(lookupComparisons, comparisons);
+    STATS_MAX(maxLookupComparisons, comparisons);
+    return accessor->slot >= 0 ? dictionary->slots[accessor->slot] : NULL;
+}
+
+// Like getEntry, finding the key with the accessor
+int getEntryAt(const Dictionary *dictionary, DictionaryAccessor *accessor, DictionaryEntry *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = accessElement(dictionary, accessor)))
+        return 0;
+
+    fillEntry(aux, result);
+    return 1;
+}
+
+// Like getNumber, finding the key with the accessor
+int getNumberAt(const Dictionary *dictionary, DictionaryAccessor *accessor, double *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = accessElement(dictionary, accessor)) || aux->type != 'n')
+        return 0;
+
+    *result = *((double *) aux->value);
+    return 1;
+}
+
+// Like getBool, finding the key with the accessor
+int getBoolAt(const Dictionary *dictionary, DictionaryAccessor *accessor, Bool *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = accessElement(dictionary, accessor)) || aux->type != 'b')
+        return 0;
+
+    *result = *((Bool *) aux->value);
+    return 1;
+}
+
+// Like getString, finding the key with the accessor
+char *getStringAt(const Dictionary *dictionary, DictionaryAccessor *accessor)
+{
+    if (!dictionary)
+        return NULL;
+
+    Element *aux;
+    if (!(aux = accessElement(dictionary, accessor)) || aux->type != 's')
+        return NULL;
+
+    return copyString(dictionary->allocator, aux->value);
+}
+
+// Guarda en result el elemento sin copiar su valor
+void fillEntry(const Element *element, DictionaryEntry *result)
+{
+    fillValue(element->key, element->type, element->value, result);
+}
+
+// Guarda en result la clave y el valor de tipo type sin copiarlo, igual que para un elemento
+void fillValue(const char *key, char type, const void *value, DictionaryEntry *result)
+{
+    result->key = key;
+    result->type = type;
+    result->value = value;
+    result->arrayType = 0;
+    result->size = 0;
+    result->array = NULL;
+
+    if (type == 'a')
+    {
+        const Array *array = (const Array *) value;
+        result->array = array;
+        result->size = array->size;
+        if (array->type == 'c') // Los diccionarios guardados por columnas no existen como tales
+        {
+            result->arrayType = 'd';
+            result->value = NULL;
+        }
+        else
+        {
+            result->arrayType = array->type;
+            result->value = array->elements;
+        }
+    }
+}
+
+// Saves the element with the given key in result without copying its value.
+// For boolean arrays value points to the bits of the array, element i is bit i % 64 of the unsigned long long i / 64.
+// For arrays of dictionaries with the same keys, which are saved by columns, value is NULL; getEntryRow reads their rows.
+// Returns 1 if it was able to get it otherwise returns 0
+int getEntry(const Dictionary *dictionary, const char *key, DictionaryEntry *result)
+{
+    if (!dictionary)
+        return 0;
+
+    Element *aux;
+    if (!(aux = findElement(dictionary, key)))
+        return 0;
+
+    fillEntry(aux, result);
+    return 1;
+}
+
+// Saves in result the element with the key column of the dictionary number row of the array of dictionaries in entry,
+// without copying its value, also when the array is saved by columns. entry must come from getEntry or an iteration and
+// result is valid while entry is. Returns 1 if it was able to get it otherwise returns 0
+int getEntryRow(const DictionaryEntry *entry, int row, const char *column, DictionaryEntry *result)
+{
+    if (!entry || entry->type != 'a' || entry->arrayType != 'd' || row < 0 || row >= entry->size || !column)
+        return 0;
+
+    const Array *array = (const Array *) entry->array;
+    if (array->type == 'd')
+        return getEntry(((Dictionary **) array->elements)[row], column, result);
+
+    const Table *table = (const Table *) array->elements;
+    int i;
+
+    for(i = 0; i < table->columns; i++) // Todas las filas tienen las mismas claves, las de las columnas
+        if (!strcmp(table->keys[i], column))
+        {
+            fillValue(table->keys[i], table->types[i], cellValue(table, i, row), result);
+            return 1;
+        }
+    return 0;
+}
+
+// Starts an iteration over the elements of the dictionary in the order they were set
+void startIteration(const Dictionary *dictionary, DictionaryCursor *cursor)
+{
+    cursor->element = dictionary ? dictionary->first : NULL;
+    cursor->ordered = 0;
+}
+
+// Agrega al camino del cursor el nodo y los primeros hijos hasta llegar a una hoja
+void descendLeft(DictionaryCursor *cursor, const IndexNode *node)
+{
+    for(;;)
+    {
+        cursor->nodes[cursor->depth] = node;
+        cursor->positions[cursor->depth] = 0;
+        cursor->depth++;
+        if (node->leaf)
+            break;
+        node = node->children[0];
+    }
+}
+
+// Deja el cursor en el primer elemento cuya clave es mayor o igual a from, o en el primero si from es NULL.
+// En cada nivel se guarda el nodo y la posicion del siguiente elemento a visitar en el
+void seekCursor(DictionaryCursor *cursor, const IndexNode *root, const char *from)
+{
+    long long comparisons = 0;
+    const IndexNode *node = root;
+
+    cursor->depth = 0;
+    if (!from)
+        descendLeft(cursor, root);
+    else
+    {
+        for(;;)
+        {
+            cursor->nodes[cursor->depth] = node;
+            cursor->positions[cursor->depth] = indexPosition(node, from, &comparisons);
+            cursor->depth++;
+            if (node->leaf)
+                break;
+            node = node->children[cursor->positions[cursor->depth - 1]];
+        }
+    }
+
+    // Se suben los niveles que ya no tienen elementos
+    while (cursor->depth > 0 && cursor->positions[cursor->depth - 1] == cursor->nodes[cursor->depth - 1]->count)
+        cursor->depth--;
+}
+
+// Starts an iteration in key order over the elements whose keys are greater or equal to from and less than to.
+// NULL from starts from the smallest key and NULL to goes up to the greatest one.
+// Returns 1 if it was able to do it otherwise returns 0, which happens if the dictionary has no ordered index
+int startOrderedIteration(const Dictionary *dictionary, DictionaryCursor *cursor, const char *from, const char *to)
+{
+    if (!dictionary || !dictionary->orderedIndex)
+        return 0;
+
+    cursor->ordered = 1;
+    cursor->bounded = to != NULL;
+    if (to)
+    {
+        strncpy(cursor->end, to, sizeof(cursor->end) - 1);
+        cursor->end[sizeof(cursor->end) - 1] = '\0';
+    }
+    seekCursor(cursor, dictionary->orderedIndex, from);
+    return 1;
+}
+
+// Saves the next element of the iteration in result, like getEntry, so the rows of an array of dictionaries saved by
+// columns are read with getEntryRow. Returns 1 if it was able to get it otherwise returns 0, which happens at the end of the iteration
+int nextEntry(DictionaryCursor *cursor, DictionaryEntry *result)
+{
+    if (!cursor->ordered)
+    {
+        if (!cursor->element)
+            return 0;
+        fillEntry(cursor->element, result);
+        cursor->element = cursor->element->next;
+        return 1;
+    }
+
+    if (cursor->depth == 0)
+        return 0;
+
+    int level = cursor->depth - 1;
+    const IndexNode *node = cursor->nodes[level];
+    const Element *element = node->elements[cursor->positions[level]];
+
+    if (cursor->bounded && strcmp(element->key, cursor->end) >= 0)
+    {
+        cursor->depth = 0;
+        return 0;
+    }
+    fillEntry(element, result);
+
+    // El siguiente es el primero del subarbol a la derecha del elemento, o si es una hoja el que le sigue en el nodo
+    cursor->positions[level]++;
+    if (!node->leaf)
+        descendLeft(cursor, node->children[cursor->positions[level]]);
+    while (cursor->depth > 0 && cursor->positions[cursor->depth - 1] == cursor->nodes[cursor->depth - 1]->count)
+        cursor->depth--;
+    return 1;
+}
+
+// Calls callback with each element of the dictionary in the order they were set, until it returns 0. The entries are
+// like the ones of getEntry, so the rows of an array of dictionaries saved by columns are read with getEntryRow.
+// Returns 1 if every element was visited otherwise returns 0
+int forEachEntry(const Dictionary *dictionary, int (*callback)(const DictionaryEntry *entry, void *data), void *data)
+{
+    DictionaryCursor cursor;
+    DictionaryEntry entry;
+
+    startIteration(dictionary, &cursor);
+    while (nextEntry(&cursor, &entry))
+        if (!callback(&entry, data))
+            return 0;
+    return 1;
+}
+
+// Calls callback in key order with each element whose key is greater or equal to from and less than to, until it
+// returns 0. NULL from starts from the smallest key and NULL to goes up to the greatest one.
+// Returns 1 if every element was visited otherwise returns 0, which also happens if the dictionary has no ordered index
+int forEachEntryInRange(const Dictionary *dictionary, const char *from, const char *to,
+                        int (*callback)(const DictionaryEntry *entry, void *data), void *data)
+{
+    DictionaryCursor cursor;
+    DictionaryEntry entry;
+
+    if (!startOrderedIteration(dictionary, &cursor, from, to))
+        return 0;
+    while (nextEntry(&cursor, &entry))
+        if (!callback(&entry, data))
+            return 0;
+    return 1;
+}
+
+// Saves in result the element with the smallest key greater or equal to key.
+// Returns 1 if it was able to get it otherwise returns 0, which also happens if the dictionary has no ordered index
+int lowerBoundEntry(const Dictionary *dictionary, const char *key, DictionaryEntry *result)
+{
+    DictionaryCursor cursor;
+
+    if (!startOrderedIteration(dictionary, &cursor, key, NULL))
+        return 0;
+    return nextEntry(&cursor, result);
+}
+
+// Mezcla los bits de x, es el paso final de splitmix64
+unsigned long long mixHash(unsigned long long x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Hash FNV-1a del string, mezclado para que strings parecidos no den hashes parecidos
+unsigned long long hashText(const char *s)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    for(; *s; s++)
+        hash = (hash ^ (unsigned char) *s) * 0x100000001b3ULL;
+    return mixHash(hash);
+}
+
+// Agrega a hash los size numeros. Se usan cuatro acumuladores independientes para no esperar a cada multiplicacion,
+// porque los arreglos numericos se vuelven a hashear cada vez que se cambian en su lugar
+unsigned long long hashNumbers(const double *values, int size, unsigned long long hash)
+{
+    unsigned long long lanes[4] = {hash, hash + 1, hash + 2, hash + 3}, bits;
+    double number;
+    int i;
+
+    for(i = 0; i < size; i++)
+    {
+        number = values[i] == 0 ? 0 : values[i]; // -0 es igual a 0, asi que debe tener el mismo hash
+        memcpy(&bits, &number, sizeof(bits));
+        lanes[i & 3] = (lanes[i & 3] ^ bits) * 0x9e3779b97f4a7c15ULL;
+        lanes[i & 3] ^= lanes[i & 3] >> 29;
+    }
+    return mixHash(lanes[0] ^ mixHash(lanes[1] ^ mixHash(lanes[2] ^ mixHash(lanes[3]))));
+}
+
+// Retorna el hash de un valor de tipo type. Los valores iguales segun equalValues tienen el mismo hash
+unsigned long long hashValue(char type, const void *value)
+{
+    switch (type)
+    {
+        case 'n':
+            return hashNumbers(value, 1, 0);
+        case 'b':
+            return mixHash(*(const Bool *) value == true ? 1 : 2);
+        case 's':
+            return hashText(value);
+        case 'd':
+            return ((const Dictionary *) value)->hash;
+        case 'a':
+            return ((const Array *) value)->hash;
+    }
+    return 0;
+}
+
+// Retorna el hash de un elemento. El de un diccionario es la suma de los de sus elementos, asi no depende
+// del orden de las claves y se actualiza restando el del elemento que sale y sumando el del que entra
+unsigned long long hashElement(const char *key, char type, const void *value)
+{
+    return mixHash((hashText(key) + (unsigned char) type) ^ hashValue(type, value));
+}
+
+// Calcula el hash de los elementos del arreglo. Una tabla tiene el mismo que el arreglo de los mismos diccionarios,
+// porque cada fila suma los hashes de sus celdas igual que un diccionario
+unsigned long long hashArray(const Array *array)
+{
+    char type = array->type == 'c' ? 'd' : array->type;
+    unsigned long long hash = mixHash(((unsigned long long) array->size << 8) | (unsigned char) type), row;
+    const Table *table = (const Table *) array->elements;
+    int i, j;
+
+    switch (array->type)
+    {
+        case 'n':
+            return hashNumbers(array->elements, array->size, hash);
+        case 'b': // Los bits que sobran estan en 0
+            for(i = 0; i < wordCount(array->size); i++)
+                hash = mixHash(hash ^ ((unsigned long long *) array->elements)[i]);
+            break;
+        case 's':
+            for(i = 0; i < array->size; i++)
+                hash = mixHash(hash ^ hashText(((char **) array->elements)[i]));
+            break;
+        case 'd':
+            for(i = 0; i < array->size; i++)
+                hash = mixHash(hash ^ ((Dictionary **) array->elements)[i]->hash);
+            break;
+        case 'c':
+            for(i = 0; i < array->size; i++)
+            {
+                for(row = 0, j = 0; j < table->columns; j++)
+                    row += hashElement(table->keys[j], table->types[j], cellValue(table, j, i));
+                hash = mixHash(hash ^ row);
+            }
+            break;
+    }
+    return hash;
+}
+
+// Actualiza el hash del arreglo del elemento, que se cambio en su lugar, y con el el del diccionario
+void rehashArray(Dictionary *dictionary, Element *element)
+{
+    Array *array = (Array *) element->value;
+    unsigned long long before = hashElement(element->key, 'a', array);
+
+    array->hash = hashArray(array);
+    dictionary->hash += hashElement(element->key, 'a', array) - before;
+}
+
+// Returns a hash of the keys and values of the dictionary. Equal dictionaries, as told by equalDictionaries, have
+// the same hash whatever the order of their keys. The hash is kept up to date as the dictionary changes, so this
+// doesn't go through the dictionary. Returns 0 for NULL
+unsigned long long hashDictionary(const Dictionary *dictionary)
+{
+    return dictionary ? dictionary->hash : 0;
+}
+
+// Retorna 1 si los diccionarios tienen las mismas claves en el mismo orden con los mismos valores. Solo se comparten
+// diccionarios identicos, asi el json de uno compartido es el mismo que tendria la copia
+int identicalDictionaries(const Dictionary *dictionary, const Dictionary *other)
+{
+    Element *aux, *otherAux;
+    int sameKeys = dictionary->shape && dictionary->shape == other->shape;
+
+    if (dictionary->hash != other->hash)
+        return 0;
+
+    for(aux = dictionary->first, otherAux = other->first; aux && otherAux; aux = aux->next, otherAux = otherAux->next)
+        if (aux->type != otherAux->type || (!sameKeys && strcmp(aux->key, otherAux->key)) ||
+            !identicalValues(aux->type, aux->value, otherAux->value))
+            return 0;
+
+    return !aux && !otherAux;
+}
+
+// Retorna 1 si los valores de tipo type son identicos: iguales, y los diccionarios que contienen con las claves en el
+// mismo orden. Lo anidado se comparte antes que lo que lo contiene, y solo hay uno compartido igual a cada diccionario,
+// asi que dos diccionarios compartidos distintos no son identicos y no hace falta recorrerlos
+int identicalValues(char type, const void *value, const void *other)
+{
+    if (type == 'd')
+        return value == other || (!(isShared(value) && isShared(other)) && identicalDictionaries(value, other));
+    if (type == 'a')
+        return identicalArrays(value, other);
+    return equalValues(type, value, other);
+}
+
+// Retorna 1 si los arreglos son identicos, como identicalValues, sin importar si los diccionarios se guardaron por columnas
+int identicalArrays(const Array *array, const Array *other)
+{
+    int i;
+
+    if ((array->type != 'd' && array->type != 'c') || (other->type != 'd' && other->type != 'c'))
+        return equalArrays(array, other);
+    if (array == other)
+        return 1;
+    if (array->hash != other->hash || array->size != other->size)
+        return 0;
+
+    for(i = 0; i < array->size; i++)
+        if (!identicalRows(array, i, other, i))
+            return 0;
+    return 1;
+}
+
+// Retorna 1 si el diccionario row de array es identico al diccionario otherRow de other. Cada arreglo puede ser de
+// diccionarios o una tabla, cuyas filas tienen las claves en el orden de las columnas
+int identicalRows(const Array *array, int row, const Array *other, int otherRow)
+{
+    const Table *table, *otherTable;
+    const Element *aux;
+    int i;
+
+    if (array->type == 'd' && other->type == 'd')
+        return identicalValues('d', ((Dictionary **) array->elements)[row], ((Dictionary **) other->elements)[otherRow]);
+    if (array->type == 'd') // Asi la tabla queda en array
+        return identicalRows(other, otherRow, array, row);
+
+    table = (const Table *) array->elements;
+    if (other->type == 'c')
+    {
+        otherTable = (const Table *) other->elements;
+        if (table->columns != otherTable->columns)
+            return 0;
+        for(i = 0; i < table->columns; i++)
+            if (table->types[i] != otherTable->types[i] || strcmp(table->keys[i], otherTable->keys[i]) ||
+                !identicalValues(table->types[i], cellValue(table, i, row), cellValue(otherTable, i, otherRow)))
+                return 0;
+        return 1;
+    }
+
+    aux = ((Dictionary **) other->elements)[otherRow]->first;
+    for(i = 0; i < table->columns && aux; i++, aux = aux->next)
+        if (table->types[i] != aux->type || strcmp(table->keys[i], aux->key) ||
+            !identicalValues(aux->type, cellValue(table, i, row), aux->value))
+            return 0;
+    return i == table->columns && !aux;
+}
+
+// Retorna 1 si el diccionario es compartido. Las referencias cambian desde varios hilos, pero uno compartido lo
+// sigue siendo mientras quien pregunta lo tenga
+int isShared(const Dictionary *dictionary)
+{
+    return __atomic_load_n(&dictionary->references, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Retorna el diccionario compartido igual a dictionary que usa allocator, sumandole una referencia, o NULL si no hay.
+// Se llama con internLock tomado
+Dictionary *findInterned(const DictionaryAllocator *allocator, const Dictionary *dictionary)
+{
+    Dictionary *aux;
+
+    if (!internCapacity)
+        return NULL;
+
+    for(aux = internBuckets[dictionary->hash & (internCapacity - 1)]; aux; aux = aux->nextInterned)
+        if (aux->allocator == allocator && identicalDictionaries(aux, dictionary))
+        {
+            __atomic_add_fetch(&aux->references, 1, __ATOMIC_RELAXED);
+            return aux;
+        }
+    return NULL;
+}
+
+// Agrega el diccionario a la tabla de compartidos, con una referencia. Si la tabla no puede crecer por falta de
+// memoria el diccionario queda como una copia normal. Se llama con internLock tomado
+void addInterned(Dictionary *dictionary)
+{
+    if (internCount >= internCapacity)
+    {
+        // La tabla es de todos los diccionarios, asi que no usa el allocator de ninguno
+        unsigned long capacity = internCapacity ? 2 * internCapacity : 64, i;
+        Dictionary **buckets, *aux, *next;
+
+        if ((buckets = (Dictionary **) calloc(capacity, sizeof(Dictionary *))) != NULL)
+        {
+            for(i = 0; i < internCapacity; i++)
+                for(aux = internBuckets[i]; aux; aux = next)
+                {
+                    next = aux->nextInterned;
+                    aux->nextInterned = buckets[aux->hash & (capacity - 1)];
+                    buckets[aux->hash & (capacity - 1)] = aux;
+                }
+            free(internBuckets);
+            internBuckets = buckets;
+            internCapacity = capacity;
+        }
+        else if (!internCapacity)
+            return;
+    }
+
+    Dictionary **bucket = &internBuckets[dictionary->hash & (internCapacity - 1)];
+    dictionary->nextInterned = *bucket;
+    *bucket = dictionary;
+    dictionary->references = 1;
+    internCount++;
+}
+
+// Quita de la tabla de compartidos el diccionario, que ya no tiene referencias. Se llama con internLock tomado
+void removeInterned(Dictionary *dictionary)
+{
+    Dictionary **link;
+
+    for(link = &internBuckets[dictionary->hash & (internCapacity - 1)]; *link != dictionary; link = &(*link)->nextInterned);
+    *link = dictionary->nextInterned;
+    dictionary->nextInterned = NULL;
+    internCount--;
+}
+
+// Retorna el diccionario compartido igual a dictionary que usa allocator, con una referencia mas, o NULL si no hay
+Dictionary *findShared(const DictionaryAllocator *allocator, const Dictionary *dictionary)
+{
+    Dictionary *shared;
+
+    pthread_mutex_lock(&internLock);
+    shared = findInterned(allocator, dictionary);
+    pthread_mutex_unlock(&internLock);
+    if (shared)
+        STATS_ADD(sharedDictionaries, 1);
+    return shared;
+}
+
+// Agrega a los compartidos la copia recien hecha, cuyos valores ya se guardaron compartidos, y la retorna. Si otro
+// hilo agrego uno igual mientras se copiaba, le hace free a la copia y retorna ese. La copia se hace sin el lock
+Dictionary *shareCopy(Dictionary *copy)
+{
+    Dictionary *shared;
+
+    pthread_mutex_lock(&internLock);
+    if (!(shared = findInterned(copy->allocator, copy)))
+        addInterned(copy);
+    pthread_mutex_unlock(&internLock);
+
+    if (!shared)
+        return copy;
+
+    freeDictionary(copy);
+    STATS_ADD(sharedDictionaries, 1);
+    return shared;
+}
+
+// When enabled, a dictionary stored inside another one (by setDictionary, setDictionaryArray, dictionaryFromJson,
+// applyMergePatch or a copy) is shared with an identical one stored before with the same allocator instead of copied,
+// together with its strings and nested values. Shared dictionaries don't change: applyMergePatch replaces one with
+// a copy before changing it, and their json is not cached. Dictionaries stored while it was enabled remain shared
+// after disabling it. Disabled by default
+void setInterning(int enabled)
+{
+    interning = enabled;
+}
+
+// Retorna cuantos elementos tiene el diccionario
+int countElements(const Dictionary *dictionary)
+{
+    Element *aux;
+    int count = 0;
+    for(aux = dictionary->first; aux; aux = aux->next)
+        count++;
+    return count;
+}
+
+// Retorna el elemento con la clave key. Como los diccionarios que se comparan suelen tener las claves en el mismo
+// orden, primero se prueba con hint, el elemento en la misma posicion, antes de buscarlo
+Element *matchElement(const Dictionary *dictionary, const Element *hint, const char *key)
+{
+    long long comparisons = 0;
+    if (hint && !strcmp(hint->key, key))
+        return (Element *) hint;
+    return lookupElement(dictionary, key, &comparisons);
+}
+
+// Retorna 1 si los valores de tipo type son iguales, de lo contrario retorna 0
+int equalValues(char type, const void *value, const void *other)
+{
+    switch (type)
+    {
+        case 'n':
+            return *(const double *) value == *(const double *) other;
+        case 'b':
+            return *(const Bool *) value == *(const Bool *) other;
+        case 's':
+            return !strcmp(value, other);
+        case 'd':
+            return equalDictionaries(value, other);
+        case 'a':
+            return equalArrays(value, other);
+        case 'z':
+            return 1;
+    }
+    return 0;
+}
+
+// Retorna 1 si los arreglos tienen los mismos elementos, sin importar si los diccionarios se guardaron por columnas
+int equalArrays(const Array *array, const Array *other)
+{
+    char type = array->type == 'c' ? 'd' : array->type, otherType = other->type == 'c' ? 'd' : other->type;
+    int i;
+
+    if (array == other)
+        return 1;
+    if (array->hash != other->hash || array->size != other->size || type != otherType)
+        return 0;
+
+    switch (type)
+    {
+        case 'n':
+            for(i = 0; i < array->size; i++)
+                if (((double *) array->elements)[i] != ((double *) other->elements)[i])
+                    return 0;
+            return 1;
+        case 'b': // Los bits que sobran estan en 0, asi que se pueden comparar las palabras completas
+            return !memcmp(array->elements, other->elements, sizeof(unsigned long long) * wordCount(array->size));
+        case 's':
+            for(i = 0; i < array->size; i++)
+                if (strcmp(((char **) array->elements)[i], ((char **) other->elements)[i]))
+                    return 0;
+            return 1;
+        case 'd':
+            for(i = 0; i < array->size; i++)
+                if (!equalRows(array, i, other, i))
+                    return 0;
+            return 1;
+    }
+    return 0;
+}
+
+// Retorna 1 si el diccionario row de array es igual al diccionario otherRow de other. Cada arreglo puede ser
+// de diccionarios o una tabla
+int equalRows(const Array *array, int row, const Array *other, int otherRow)
+{
+    if (array->type == 'd' && other->type == 'd')
+        return equalDictionaries(((Dictionary **) array->elements)[row], ((Dictionary **) other->elements)[otherRow]);
+    if (array->type == 'c' && other->type == 'c')
+        return equalTableRows(array->elements, row, other->elements, otherRow);
+    if (array->type == 'c')
+        return equalRowDictionary(array->elements, row, ((Dictionary **) other->elements)[otherRow]);
+    return equalRowDictionary(other->elements, otherRow, ((Dictionary **) array->elements)[row]);
+}
+
+// Retorna 1 si la fila row de table tiene los mismos valores que la fila otherRow de other
+int equalTableRows(const Table *table, int row, const Table *other, int otherRow)
+{
+    int i, j;
+
+    if (table->columns != other->columns)
+        return 0;
+
+    for(i = 0; i < table->columns; i++)
+    {
+        // Las columnas suelen estar en el mismo orden
+        if (strcmp(table->keys[i], other->keys[j = i]))
+            for(j = 0; j < other->columns && strcmp(table->keys[i], other->keys[j]); j++);
+
+        if (j == other->columns || table->types[i] != other->types[j] ||
+            !equalValues(table->types[i], cellValue(table, i, row), cellValue(other, j, otherRow)))
+            return 0;
+    }
+    return 1;
+}
+
+// Retorna 1 si la fila row de table tiene las mismas claves y valores que el diccionario
+int equalRowDictionary(const Table *table, int row, const Dictionary *dictionary)
+{
+    Element *aux = dictionary->first, *match;
+    int i;
+
+    if (countElements(dictionary) != table->columns)
+        return 0;
+
+    for(i = 0; i < table->columns; i++, aux = aux ? aux->next : NULL)
+    {
+        if (!(match = matchElement(dictionary, aux, table->keys[i])) || match->type != table->types[i] ||
+            !equalValues(match->type, cellValue(table, i, row), match->value))
+            return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if both dictionaries have the same keys with the same values, in any order, otherwise returns 0
+int equalDictionaries(const Dictionary *dictionary, const Dictionary *other)
+{
+    if (dictionary == other)
+        return 1;
+    if (!dictionary || !other || dictionary->hash != other->hash || countElements(dictionary) != countElements(other))
+        return 0;
+
+    Element *aux, *hint, *match;
+    for(aux = dictionary->first, hint = other->first; aux; aux = aux->next, hint = hint ? hint->next : NULL)
+    {
+        if (!(match = matchElement(other, hint, aux->key)) || match->type != aux->type ||
+            !equalValues(aux->type, aux->value, match->value))
+            return 0;
+    }
+    return 1;
+}
+
+// Agrega newp al final del diccionario, donde last es el ultimo elemento, sin verificar si la clave ya existe.
+// Si newp es NULL porque no hubo memoria retorna 0
+int appendElement(Dictionary *dictionary, Element **last, Element *newp)
+{
+    if (!newp)
+        return 0;
+
+    if (*last)
+        (*last)->next = newp;
+    else
+        dictionary->first = newp;
+    *last = newp;
+    dictionary->hash += hashElement(newp->key, newp->type, newp->value);
+    return 1;
+}
+
+// Returns a JSON Merge Patch (RFC 7396) that turns from into to: the keys that changed with their new value,
+// the removed keys with null, and the dictionaries that changed with a patch of their own.
+// Like in RFC 7396, null values in to can't be told apart from removed keys.
+// Returns NULL if there is no memory
+Dictionary *diffDictionaries(const Dictionary *from, const Dictionary *to)
+{
+    if (!from || !to)
+        return NULL;
+
+    const DictionaryAllocator *allocator = to->allocator;
+    Dictionary *patch;
+    if (!(patch = newDictionaryWithAllocator(allocator)))
+        return NULL;
+
+    Element *aux, *hint, *match, *last = NULL;
+    int added = 1;
+
+    // Las claves que ya no estan se quitan con null. Cada clave aparece una sola vez, asi que se agregan al final
+    for(aux = from->first, hint = to->first; aux && added; aux = aux->next, hint = hint ? hint->next : NULL)
+        if (!matchElement(to, hint, aux->key))
+            added = appendElement(patch, &last, newElement(allocator, aux->key, 'z', (void *) &nullValue));
+
+    for(aux = to->first, hint = from->first; aux && added; aux = aux->next, hint = hint ? hint->next : NULL)
+    {
+        match = matchElement(from, hint, aux->key);
+        if (match && match->type == aux->type && equalValues(aux->type, aux->value, match->value))
+            continue;
+
+        // Un diccionario que cambio se reemplaza por lo que cambio en el
+        if (match && match->type == 'd' && aux->type == 'd')
+            added = appendElement(patch, &last, newElement(allocator, aux->key, 'd', diffDictionaries(match->value, aux->value)));
+        else
+            added = appendElement(patch, &last, newElement(allocator, aux->key, aux->type, copyValue(allocator, aux->type, aux->value)));
+    }
+
+    if (!added)
+    {
+        freeDictionary(patch);
+        return NULL;
+    }
+    return patch;
+}
+
+// Applies a JSON Merge Patch (RFC 7396) to the dictionary in place, keeping the values the patch doesn't change.
+// Returns 1 if it was able to do it otherwise returns 0, in that case the patch may have been applied partially
+int applyMergePatch(Dictionary *dictionary, const Dictionary *patch)
+{
+    if (!dictionary || !patch)
+        return 0;
+
+    long long comparisons = 0;
+    Element *aux, *target;
+    Dictionary *nested;
+
+    for(aux = patch->first; aux; aux = aux->next)
+    {
+        if (aux->type == 'z') // null quita la clave
+            removeElement(dictionary, aux->key);
+        else if (aux->type == 'd')
+        {
+            // Un diccionario se aplica sobre el que ya existe, o si no existe sobre uno vacio, asi no quedan sus null
+            target = lookupElement(dictionary, aux->key, &comparisons);
+            if (target && target->type == 'd')
+            {
+                unsigned long long before = hashElement(target->key, 'd', target->value);
+
+                // Un diccionario compartido no se puede cambiar, se reemplaza por una copia propia
+                nested = target->value;
+                if (isShared(nested))
+                {
+                    if (!(nested = copyDictionary(dictionary->allocator, target->value)))
+                        return 0;
+                    freeDictionary(target->value);
+                    target->value = nested;
+                }
+
+                invalidateJson(dictionary); // El anidado cambia, y con el este diccionario
+                int applied = applyMergePatch(nested, aux->value);
+                dictionary->hash += hashElement(target->key, 'd', nested) - before;
+                if (dictionary->store) // El log solo ve los cambios del diccionario, asi que se guarda el anidado entero
+                    logElement(dictionary, target, 'U');
+                if (!applied)
+                    return 0;
+                continue;
+            }
+
+            if (!(nested = newDictionaryWithAllocator(dictionary->allocator)))
+                return 0;
+            if (!applyMergePatch(nested, aux->value))
+            {
+                freeDictionary(nested);
+                return 0;
+            }
+            if (!(target = newElement(dictionary->allocator, aux->key, 'd', nested)) || !putElement(dictionary, target))
+                return 0;
+        }
+        else if (!setValue(dictionary, aux->key, aux->value, aux->type))
+            return 0;
+    }
+    return 1;
+}
+
+// Elige la version de las operaciones sobre arreglos numericos segun lo que soporte el procesador
+void chooseNumberKernels()
+{
+#ifdef NUMBER_KERNELS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        numberKernels = &avx2Kernels;
+    else if (__builtin_cpu_supports("sse2"))
+        numberKernels = &sse2Kernels;
+#endif
+}
+
+// Retorna las operaciones sobre arreglos numericos a usar
+const NumberKernels *kernels()
+{
+    pthread_once(&kernelsOnce, chooseNumberKernels);
+    return numberKernels;
+}
+
+// Versiones escalares, se usan si el procesador no tiene instrucciones vectoriales y para los elementos
+// que sobran al final de las versiones vectoriales
+
+double scalarSum(const double *values, int size)
+{
+    double sum = 0;
+    int i;
+    for(i = 0; i < size; i++)
+        sum += values[i];
+    return sum;
+}
+
+double scalarMin(const double *values, int size)
+{
+    double min = values[0];
+    int i;
+    for(i = 1; i < size; i++)
+        if (values[i] < min)
+            min = values[i];
+    return min;
+}
+
+double scalarMax(const double *values, int size)
+{
+    double max = values[0];
+    int i;
+    for(i = 1; i < size; i++)
+        if (values[i] > max)
+            max = values[i];
+    return max;
+}
+
+double scalarSquaredDeviation(const double *values, int size, double mean)
+{
+    double sum = 0;
+    int i;
+    for(i = 0; i < size; i++)
+        sum += (values[i] - mean) * (values[i] - mean);
+    return sum;
+}
+
+double scalarDot(const double *values, const double *others, int size)
+{
+    double sum = 0;
+    int i;
+    for(i = 0; i < size; i++)
+        sum += values[i] * others[i];
+    return sum;
+}
+
+void scalarScale(double *values, int size, double factor)
+{
+    int i;
+    for(i = 0; i < size; i++)
+        values[i] *= factor;
+}
+
+void scalarAdd(double *values, int size, double addend)
+{
+    int i;
+    for(i = 0; i < size; i++)
+        values[i] += addend;
+}
+
+int scalarCountAbove(const double *values, int size, double threshold)
+{
+    int i, count = 0;
+    for(i = 0; i < size; i++)
+        count += values[i] > threshold;
+    return count;
+}
+
+#ifdef NUMBER_KERNELS_SIMD
+// Versiones SSE2, procesan 2 elementos a la vez. Los arreglos no necesariamente estan alineados
+
+__attribute__((target("sse2")))
+double sse2Sum(const double *values, int size)
+{
+    __m128d sum = _mm_setzero_pd();
+    double lanes[2];
+    int i;
+    for(i = 0; i + 2 <= size; i += 2)
+        sum = _mm_add_pd(sum, _mm_loadu_pd(values + i));
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + scalarSum(values + i, size - i);
+}
+
+__attribute__((target("sse2")))
+double sse2Min(const double *values, int size)
+{
+    if (size < 2)
+        return scalarMin(values, size);
+
+    __m128d min = _mm_loadu_pd(values);
+    double lanes[2];
+    int i;
+    for(i = 2; i + 2 <= size; i += 2)
+        min = _mm_min_pd(min, _mm_loadu_pd(values + i));
+    _mm_storeu_pd(lanes, min);
+    lanes[0] = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    return i < size && values[i] < lanes[0] ? values[i] : lanes[0];
+}
+
+__attribute__((target("sse2")))
+double sse2Max(const double *values, int size)
+{
+    if (size < 2)
+        return scalarMax(values, size);
+
+    __m128d max = _mm_loadu_pd(values);
+    double lanes[2];
+    int i;
+    for(i = 2; i + 2 <= size; i += 2)
+        max = _mm_max_pd(max, _mm_loadu_pd(values + i));
+    _mm_storeu_pd(lanes, max);
+    lanes[0] = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    return i < size && values[i] > lanes[0] ? values[i] : lanes[0];
+}
+
+__attribute__((target("sse2")))
+double sse2SquaredDeviation(const double *values, int size, double mean)
+{
+    __m128d sum = _mm_setzero_pd(), m = _mm_set1_pd(mean), d;
+    double lanes[2];
+    int i;
+    for(i = 0; i + 2 <= size; i += 2)
+    {
+        d = _mm_sub_pd(_mm_loadu_pd(values + i), m);
+        sum = _mm_add_pd(sum, _mm_mul_pd(d, d));
+    }
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + scalarSquaredDeviation(values + i, size - i, mean);
+}
+
+__attribute__((target("sse2")))
+double sse2Dot(const double *values, const double *others, int size)
+{
+    __m128d sum = _mm_setzero_pd();
+    double lanes[2];
+    int i;
+    for(i = 0; i + 2 <= size; i += 2)
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(values + i), _mm_loadu_pd(others + i)));
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + scalarDot(values + i, others + i, size - i);
+}
+
+__attribute__((target("sse2")))
+void sse2Scale(double *values, int size, double factor)
+{
+    __m128d f = _mm_set1_pd(factor);
+    int i;
+    for(i = 0; i + 2 <= size; i += 2)
+        _mm_storeu_pd(values + i, _mm_mul_pd(_mm_loadu_pd(values + i), f));
+    scalarScale(values + i, size - i, factor);
+}
+
+__attribute__((target("sse2")))
+void sse2Add(double *values, int size, double addend)
+{
+    __m128d a = _mm_set1_pd(addend);
+    int i;
+    for(i = 0; i + 2 <= size; i += 2)
+        _mm_storeu_pd(values + i, _mm_add_pd(_mm_loadu_pd(values + i), a));
+    scalarAdd(values + i, size - i, addend);
+}
+
+__attribute__((target("sse2")))
+int sse2CountAbove(const double *values, int size, double threshold)
+{
+    __m128d t = _mm_set1_pd(threshold);
+    int i, count = 0;
+    for(i = 0; i + 2 <= size; i += 2)
+        count += __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(values + i), t)));
+    return count + scalarCountAbove(values + i, size - i, threshold);
+}
+
+// Versiones AVX2, procesan 4 elementos a la vez
+
+__attribute__((target("avx2")))
+double avx2Sum(const double *values, int size)
+{
+    __m256d sum = _mm256_setzero_pd();
+    double lanes[4];
+    int i;
+    for(i = 0; i + 4 <= size; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(values + i));
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarSum(values + i, size - i);
+}
+
+__attribute__((target("avx2")))
+double avx2Min(const double *values, int size)
+{
+    if (size < 4)
+        return scalarMin(values, size);
+
+    __m256d min = _mm256_loadu_pd(values);
+    double lanes[4];
+    int i;
+    for(i = 4; i + 4 <= size; i += 4)
+        min = _mm256_min_pd(min, _mm256_loadu_pd(values + i));
+    _mm256_storeu_pd(lanes, min);
+    for(; i < size; i++)  // Los que sobran se comparan con el primer carril
+        if (values[i] < lanes[0])
+            lanes[0] = values[i];
+    return scalarMin(lanes, 4);
+}
+
+__attribute__((target("avx2")))
+double avx2Max(const double *values, int size)
+{
+    if (size < 4)
+        return scalarMax(values, size);
+
+    __m256d max = _mm256_loadu_pd(values);
+    double lanes[4];
+    int i;
+    for(i = 4; i + 4 <= size; i += 4)
+        max = _mm256_max_pd(max, _mm256_loadu_pd(values + i));
+    _mm256_storeu_pd(lanes, max);
+    for(; i < size; i++)
+        if (values[i] > lanes[0])
+            lanes[0] = values[i];
+    return scalarMax(lanes, 4);
+}
+
+__attribute__((target("avx2")))
+double avx2SquaredDeviation(const double *values, int size, double mean)
+{
+    __m256d sum = _mm256_setzero_pd(), m = _mm256_set1_pd(mean), d;
+    double lanes[4];
+    int i;
+    for(i = 0; i + 4 <= size; i += 4)
+    {
+        d = _mm256_sub_pd(_mm256_loadu_pd(values + i), m);
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(d, d));
+    }
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarSquaredDeviation(values + i, size - i, mean);
+}
+
+__attribute__((target("avx2")))
+double avx2Dot(const double *values, const double *others, int size)
+{
+    __m256d sum = _mm256_setzero_pd();
+    double lanes[4];
+    int i;
+    for(i = 0; i + 4 <= size; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(values + i), _mm256_loadu_pd(others + i)));
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarDot(values + i, others + i, size - i);
+}
+
+__attribute__((target("avx2")))
+void avx2Scale(double *values, int size, double factor)
+{
+    __m256d f = _mm256_set1_pd(factor);
+    int i;
+    for(i = 0; i + 4 <= size; i += 4)
+        _mm256_storeu_pd(values + i, _mm256_mul_pd(_mm256_loadu_pd(values + i), f));
+    scalarScale(values + i, size - i, factor);
+}
+
+__attribute__((target("avx2")))
+void avx2Add(double *values, int size, double addend)
+{
+    __m256d a = _mm256_set1_pd(addend);
+    int i;
+    for(i = 0; i + 4 <= size; i += 4)
+        _mm256_storeu_pd(values + i, _mm256_add_pd(_mm256_loadu_pd(values + i), a));
+    scalarAdd(values + i, size - i, addend);
+}
+
+__attribute__((target("avx2")))
+int avx2CountAbove(const double *values, int size, double threshold)
+{
+    __m256d t = _mm256_set1_pd(threshold);
+    int i, count = 0;
+    for(i = 0; i + 4 <= size; i += 4)
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), t, _CMP_GT_OQ)));
+    return count + scalarCountAbove(values + i, size - i, threshold);
+}
+#endif
+
+// Prepara un texto vacio con lugar para capacity caracteres, o al menos 64. Retorna 0 si no hay memoria
+int initBuffer(Buffer *buffer, const DictionaryAllocator *allocator, size_t capacity)
+{
+    buffer->allocator = allocator;
+    buffer->length = 0;
+    buffer->capacity = capacity > 64 ? capacity : 64;
+    buffer->failed = 0;
+    if ((buffer->text = (char *) allocate(allocator, buffer->capacity)) == NULL)
+        return 0;
+
+    buffer->text[0] = '\0';
+    return 1;
+}
+
+// Le hace free al texto y lo marca como fallido, porque no hubo memoria
+void failBuffer(Buffer *buffer)
+{
+    release(buffer->allocator, buffer->text);
+    buffer->text = NULL;
+    buffer->failed = 1;
+}
+
+// Agrega length caracteres de s al final del texto, duplicando su capacidad cuando no alcanza.
+// Si no hay memoria le hace free al texto y lo marca como fallido
+void appendBytes(Buffer *buffer, const char *s, size_t length)
+{
+    if (buffer->failed)
+        return;
+
+    if (buffer->length + length + 1 > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity;
+        char *aux;
+
+        while (buffer->length + length + 1 > capacity)
+            capacity *= 2;
+
+        if ((aux = (char *) reallocate(buffer->allocator, buffer->text, capacity)) == NULL)
+        {
+            failBuffer(buffer);
+            return;
+        }
+        buffer->text = aux;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->text + buffer->length, s, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+}
+
+// Agrega el string s al final del texto
+void appendText(Buffer *buffer, const char *s)
+{
+    appendBytes(buffer, s, strlen(s));
+}
+
+// Hace free al json guardado del diccionario porque cambio, pero mantiene su largo. Los diccionarios que lo contienen tambien cambian, pero
+// solo se pueden modificar a traves de ellos, asi que quien lo modifica tambien invalida el de ellos
+void invalidateJson(Dictionary *dictionary)
+{
+    if (dictionary->json)
+    {
+        release(dictionary->allocator, dictionary->json);
+        dictionary->json = NULL;
+    }
+}
+
+// Hace free al json guardado del diccionario y de sus diccionarios anidados
+void releaseJson(const Dictionary *dictionary)
+{
+    Element *aux;
+
+    invalidateJson((Dictionary *) dictionary);
+    for(aux = dictionary->first; aux; aux = aux->next)
+        releaseNestedJson(aux->type, aux->value);
+}
+
+// Hace free al json guardado de los diccionarios que contiene un valor de tipo type
+void releaseNestedJson(char type, const void *value)
+{
+    const Array *array = (const Array *) value;
+    int i, j;
+
+    if (type == 'd')
+        releaseJson(value);
+    else if (type == 'a' && array->type == 'd')
+        for(i = 0; i < array->size; i++)
+            releaseJson(((Dictionary **) array->elements)[i]);
+    else if (type == 'a' && array->type == 'c')
+    {
+        const Table *table = (const Table *) array->elements;
+        for(i = 0; i < table->columns; i++)
+            if (table->types[i] == 'd' || table->types[i] == 'a')
+                for(j = 0; j < array->size; j++)
+                    releaseNestedJson(table->types[i], cellValue(table, i, j));
+    }
+}
+
+// Makes jsonFromDictionary keep the json of the dictionary and of each nested dictionary, and reuse it for the ones
+// that didn't change since then. The dictionary must then not be serialized from several threads at once.
+// Disabling it releases the kept json
+void setJsonCache(Dictionary *dictionary, int enabled)
+{
+    if (!dictionary)
+        return;
+
+    dictionary->cacheJson = enabled != 0;
+    if (!enabled)
+        releaseJson(dictionary);
+}
+
+// Limits the json accepted by dictionaryFromJson and the json lines functions: at most maxDepth nested dictionaries and
+// arrays, counting the outer dictionary, and at most maxLength characters per dictionary. Json past a limit is rejected
+// like invalid json. 0 means no limit, the default for both. Parsing, copying, serializing and freeing don't use more
+// stack for deeper dictionaries, so the limits are only needed to bound the time and memory given to untrusted json.
+// A dictionary of INT_MAX characters or more is always rejected
+void setJsonLimits(int maxDepth, size_t maxLength)
+{
+    maxJsonDepth = maxDepth > 0 ? maxDepth : 0;
+    maxJsonLength = maxLength;
+}
+
+// Returns the json representation string for the given dictionary. If it can't do it returns NULL
+char *jsonFromDictionary(const Dictionary *dictionary)
+{
+    if (!dictionary)
+        return NULL;
+
+    long long start = STATS_CLOCK();
+    Buffer buffer;
+
+    if (dictionary->cacheJson && dictionary->json) // Si no cambio basta con copiar el json guardado
+    {
+        buffer.length = dictionary->jsonLength;
+        if ((buffer.text = (char *) allocate(dictionary->allocator, buffer.length + 1)) == NULL)
+            return NULL;
+        memcpy(buffer.text, dictionary->json, buffer.length + 1);
+    }
+    else
+    {
+        // Con el json guardado, el largo del ultimo json sirve para reservar el espacio de una vez
+        if (!initBuffer(&buffer, dictionary->allocator, dictionary->cacheJson ? dictionary->jsonLength + 1 : 0))
+            return NULL;
+
+        serializeDictionary(&buffer, dictionary, dictionary->cacheJson);
+        if (buffer.failed)
+            return NULL;
+    }
+
+    STATS_ADD(serializations, 1);
+    STATS_ADD(serializedBytes, buffer.length);
+    STATS_ADD(serializeNanoseconds, STATS_CLOCK() - start);
+    return buffer.text;
+}
+
+// Agrega al final del texto el json del diccionario. Lo anidado se recorre con una pila de marcos en lugar de
+// recursion, asi el stack que se usa no depende de la profundidad.
+// Si cache no es 0 se usa el json guardado de los diccionarios que no cambiaron, y se guarda el de los demas
+void serializeDictionary(Buffer *buffer, const Dictionary *dictionary, int cache)
+{
+    FrameStack stack;
+    SerializeFrame *frame;
+
+    initFrames(&stack, buffer->allocator, sizeof(SerializeFrame));
+    beginSerialize(buffer, &stack, 'd', dictionary, cache);
+    while (!buffer->failed && (frame = (SerializeFrame *) topFrame(&stack)))
+        continueSerialize(buffer, &stack, frame);
+    freeFrames(&stack);
+}
+
+// Agrega al final del texto el valor de tipo type. Los diccionarios, arreglos de diccionarios y tablas solo se abren,
+// y su contenido se agrega despues con un marco en la pila
+void beginSerialize(Buffer *buffer, FrameStack *stack, char type, const void *value, int cache)
+{
+    const Dictionary *dictionary = (const Dictionary *) value;
+    SerializeFrame *frame;
+
+    if (type == 'd')
+    {
+        // Un diccionario compartido puede estarse serializando desde otro hilo, asi que ni el ni lo que contiene guardan json
+        if (isShared(dictionary))
+            cache = 0;
+
+        if (cache && dictionary->json)
+        {
+            appendBytes(buffer, dictionary->json, dictionary->jsonLength);
+            return;
+        }
+    }
+    else if (!hasDictionaries(type, value))
+    {
+        serializeValue(buffer, type, value);
+        return;
+    }
+
+    if (!(frame = (SerializeFrame *) pushFrame(stack)))
+    {
+        failBuffer(buffer);
+        return;
+    }
+
+    frame->kind = type;
+    frame->cache = cache;
+    frame->value = value;
+    frame->next = type == 'd' ? dictionary->first : NULL;
+    frame->start = buffer->length;
+    appendText(buffer, type == 'd' ? "{" : "["); // El json de un diccionario empieza en '{'
+}
+
+// Agrega lo siguiente del marco del tope de la pila, y lo quita si ya termino
+void continueSerialize(Buffer *buffer, FrameStack *stack, SerializeFrame *frame)
+{
+    const Array *array = (const Array *) frame->value;
+    const Table *table = (const Table *) frame->value;
+    const Element *aux;
+    int cache = frame->cache, i;
+
+    switch (frame->kind)
+    {
+        case 'd':
+            if ((aux = frame->next) != NULL) // Para cada elemento del diccionario
+            {
+                frame->next = aux->next;
+                if (aux != ((const Dictionary *) frame->value)->first) // Si no es el primer elemento del diccionario
+                    appendText(buffer, ",");
+                appendText(buffer, "\""); // Empieza en comillas
+                appendText(buffer, aux->key); // Luego se copia la clave
+                appendText(buffer, "\":"); // Seguidamente comillas
+                beginSerialize(buffer, stack, aux->type, aux->value, cache); // Se copia el valor en string dependiendo del tipo
+                return;
+            }
+
+            appendText(buffer, "}"); // Termina en '}'
+
+            // Guardar el json es opcional, asi que si no hay memoria para hacerlo no es un error.
+            // El diccionario es const para quien serializa, pero el json guardado no es parte de su contenido
+            if (cache && !buffer->failed)
+            {
+                Dictionary *d = (Dictionary *) frame->value;
+                if ((d->json = (char *) allocate(d->allocator, buffer->length - frame->start + 1)) != NULL)
+                {
+                    d->jsonLength = buffer->length - frame->start;
+                    memcpy(d->json, buffer->text + frame->start, d->jsonLength + 1);
+                }
+            }
+            break;
+        case 'a':
+            if ((i = frame->index) < array->size)
+            {
+                frame->index++;
+                if (i) // Si no es el primer elemento
+                    appendText(buffer, ",");
+
+                if (array->type == 'd')
+                    beginSerialize(buffer, stack, 'd', ((Dictionary **) array->elements)[i], cache);
+                else if ((frame = (SerializeFrame *) pushFrame(stack)) != NULL) // Cada fila de la tabla es un diccionario
+                {
+                    frame->kind = 'r';
+                    frame->cache = cache;
+                    frame->value = array->elements;
+                    frame->row = i;
+                    appendText(buffer, "{");
+                }
+                else
+                    failBuffer(buffer);
+                return;
+            }
+
+            appendText(buffer, "]");
+            break;
+        case 'r':
+            if ((i = frame->index) < table->columns)
+            {
+                frame->index++;
+                if (i)
+                    appendText(buffer, ",");
+                appendText(buffer, "\"");
+                appendText(buffer, table->keys[i]);
+                appendText(buffer, "\":");
+                beginSerialize(buffer, stack, table->types[i], cellValue(table, i, frame->row), cache);
+                return;
+            }
+
+            appendText(buffer, "}");
+            break;
+    }
+
+    popFrame(stack);
+}
+
+// Agrega al final del texto el valor de tipo type, que no es un diccionario ni un arreglo de diccionarios
+void serializeValue(Buffer *buffer, char type, const void *value)
+{
+    const Array *array = (const Array *) value;
+    char num[30];
+    Bool bit;
+    int i;
+
+    switch (type)
+    {
+        case 'n':
+            appendBytes(buffer, num, sprintf(num, "%.3f", *((double *) value)));
+            break;
+        case 'b':
+            appendText(buffer, *((Bool *) value) == true ? "true" : "false");
+            break;
+        case 's':
+            appendText(buffer, "\"");
+            appendText(buffer, (char *) value);
+            appendText(buffer, "\"");
+            break;
+        case 'z':
+            appendText(buffer, "null");
+            break;
+        case 'a':
+            appendText(buffer, "[");
+            for(i = 0; i < array->size; i++)
+            {
+                switch(array->type)
+                {
+                    case 'n':
+                        serializeValue(buffer, 'n', (double *) array->elements + i);
+                        break;
+                    case 'b':
+                        bit = bitValue(array->elements, i);
+                        serializeValue(buffer, 'b', &bit);
+                        break;
+                    case 's':
+                        serializeValue(buffer, 's', ((char **) array->elements)[i]);
+                        break;
+                }
+                if (i != array->size - 1) // Si no es el ltimo elemento
+                    appendText(buffer, ",");
+            }
+            appendText(buffer, "]");
+            break;
+    }
+}
+
+// Retorna 1 si str corresponde a un nmero vlido, de lo contrario retorna 0
+int isNumber(char *str)
+{
+    if (*str == '\0')
+        return 0;
+
+    int len = strlen(str);
+
+    int i;
+    for(i = 0; i < len; i++)
+        if ((str[i] < '0' || str[i] > '9') && str[i] != '.' && str[i] != '-') // Verifica que solo haya numeros o puntos
+            return 0;
+
+    // Primera ocurrencia de '-' y '.'
+    char *minus = strchr(str, '-'), *dot = strchr(str, '.');
+
+    if (minus && dot) // Si hay tanto menos como punto
+    {
+        // Verifica que solo haya un menos y que est al inicio,
+        // que haya un solo punto y no est inmediatamente despus del menos ni al final
+        if (minus == strrchr(str, '-') && minus == str && dot == strrchr(str, '.') && dot > minus+1 && dot != str+len-1)
+            return 1;
+        return 0;
+    }
+    if (minus) // Si hay menos pero no punto
+    {
+        // Verifica que haya uno solo y no est en el inicio
+        if (minus == strrchr(str, '-') && minus == str)
+            return 1;
+        return 0;
+    }
+    if (dot) // Si hay punto pero no menos
+    {
+        // Verifica que solo haya uno y no est ni al inicio ni al final
+        if(dot == strrchr(str, '.') && dot != str && dot != str+len-1)
+            return 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+// Retorna donde termina el valor en formato json que empieza en s, sin leerlo, o NULL si no termina. Un string se salta
+// hasta sus comillas y un diccionario o un arreglo hasta el cierre que le corresponde
+char *skipValue(char *s)
+{
+    int depth = 0;
+
+    for(; *s; s++)
+    {
+        if (*s == '"')
+        {
+            if (!(s = strchr(s + 1, '"')))
+                return NULL;
+        }
+        else if (*s == '{' || *s == '[')
+            depth++;
+        else if (*s == '}' || *s == ']')
+        {
+            if (!depth)
+                return s;
+            if (!--depth)
+                return s + 1;
+        }
+        else if (*s == ',' && !depth)
+            return s;
+    }
+    return depth ? NULL : s;
+}
+
+// Duplica la tabla de hash de las claves ya leidas del diccionario del marco, o la crea con 16 lugares.
+// Retorna 0 si no hay memoria
+int growParsedKeys(const DictionaryAllocator *allocator, ParseFrame *frame)
+{
+    int capacity = frame->keyCapacity ? 2 * frame->keyCapacity : 16, i, j, length;
+    const char **keys;
+    char key[sizeof(frame->key)];
+
+    if (!(keys = (const char **) allocate(allocator, capacity * sizeof(char *))))
+        return 0;
+    memset(keys, 0, capacity * sizeof(char *));
+
+    for(i = 0; i < frame->keyCapacity; i++)
+        if (frame->keys[i])
+        {
+            for(length = 0; frame->keys[i][length] != '"'; length++) // Las claves en el json terminan en comillas
+                key[length] = frame->keys[i][length];
+            key[length] = '\0';
+
+            for(j = hashText(key) & (capacity - 1); keys[j]; j = (j + 1) & (capacity - 1))
+                ;
+            keys[j] = frame->keys[i];
+        }
+
+    release(allocator, frame->keys);
+    frame->keys = keys;
+    frame->keyCapacity = capacity;
+    return 1;
+}
+
+// Agrega la clave del miembro que se esta leyendo, que esta en frame->key y empieza en start en el json, a las ya
+// leidas del diccionario del marco. Retorna 0 si estaba repetida o no hay memoria. Se busca en una tabla de hash con
+// al menos el doble de lugares que claves, asi un diccionario ancho no compara con todas
+int addParsedKey(const DictionaryAllocator *allocator, ParseFrame *frame, const char *start)
+{
+    const char *key = frame->key;
+    int length = strlen(key), i;
+
+    if (2 * frame->next > frame->keyCapacity && !growParsedKeys(allocator, frame))
+        return 0;
+
+    for (i = hashText(key) & (frame->keyCapacity - 1); frame->keys[i]; i = (i + 1) & (frame->keyCapacity - 1))
+        if (!strncmp(frame->keys[i], key, length) && frame->keys[i][length] == '"')
+            return 0;
+
+    frame->keys[i] = start;
+    return 1;
+}
+
+// Returns a new dictionary created from its json representation. If it can't parse the json returns NULL
+Dictionary *dictionaryFromJson(const char *json)
+{
+    return dictionaryFromJsonWithAllocator(json, NULL);
+}
+
+// Like dictionaryFromJson, but the new dictionary uses the given allocator, NULL means the default one
+Dictionary *dictionaryFromJsonWithAllocator(const char *json, const DictionaryAllocator *allocator)
+{
+    if (!json)
+        return NULL;
+
+    return parseDictionary(allocator ? allocator : defaultAllocator, json, strlen(json), NULL);
+}
+
+// Returns a projection that selects the given paths, made of keys separated by '/' like "order/price". A path selects
+// the whole value of its last key, and the dictionaries on the way keep only the selected keys. Returns NULL if a path
+// has an empty key or one longer than 79 characters, or if there is no memory
+DictionaryProjection *newProjection(int size, const char *paths[size])
+{
+    ProjectionNode *root;
+    int i;
+
+    if (!(root = newProjectionNode(NULL, NULL, "", 0)))
+        return NULL;
+
+    for (i = 0; i < size; i++)
+        if (!addProjectionPath(root, paths[i]))
+        {
+            freeProjection(root);
+            return NULL;
+        }
+    return root;
+}
+
+// Releases the memory of the given projection
+void freeProjection(DictionaryProjection *projection)
+{
+    ProjectionNode *next;
+
+    for (; projection; projection = next)
+    {
+        next = projection->nextAllocated;
+        release(&mallocAllocator, projection);
+    }
+}
+
+// Like dictionaryFromJsonWithAllocator, but the dictionary only has the keys selected by the projection. When a
+// dictionary on the way to a selected key is in an array of dictionaries, each of them keeps the selected keys, and
+// when it is neither it is left out. The values of the other keys are skipped matching only their quotes and
+// brackets, without creating them, so json that is invalid only inside those values is accepted
+Dictionary *dictionaryFromJsonWithProjection(const char *json, const DictionaryProjection *projection,
+                                             const DictionaryAllocator *allocator)
+{
+    if (!json || !projection)
+        return NULL;
+
+    return parseDictionary(allocator ? allocator : defaultAllocator, json, strlen(json), projection);
+}
+
+// Returns 1 if dictionaryFromJson would accept the json, checking it without creating the dictionary, otherwise
+// returns 0
+int validateJson(const char *json)
+{
+    return json && parseJson(defaultAllocator, json, strlen(json), NULL, NULL);
+}
+
+// Crea un nodo con la clave de length caracteres como ultimo hijo de parent, o la raiz si parent es NULL.
+// Todos los nodos se encadenan despues de la raiz para hacerles free. Retorna NULL si no hay memoria
+ProjectionNode *newProjectionNode(ProjectionNode *root, ProjectionNode *parent, const char *key, int length)
+{
+    ProjectionNode *node, **last;
+
+    if (!(node = (ProjectionNode *) allocate(&mallocAllocator, sizeof(ProjectionNode))))
+        return NULL;
+
+    memset(node, 0, sizeof(ProjectionNode));
+    memcpy(node->key, key, length);
+    if (parent)
+    {
+        for (last = &parent->child; *last; last = &(*last)->sibling)
+            ;
+        *last = node;
+        node->nextAllocated = root->nextAllocated;
+        root->nextAllocated = node;
+    }
+    return node;
+}
+
+// Agrega a la proyeccion los nodos del camino que faltan y marca el ultimo como entero. Si un nodo del camino ya
+// era entero no cambia nada. Retorna 0 si una clave no es valida o no hay memoria
+int addProjectionPath(ProjectionNode *root, const char *path)
+{
+    ProjectionNode *node = root, *child;
+    const char *end;
+    int length;
+
+    if (!path)
+        return 0;
+
+    for (;; path = end + 1)
+    {
+        end = strchr(path, '/');
+        length = end ? end - path : (int) strlen(path);
+        if (length == 0 || length >= (int) sizeof(node->key))
+            return 0;
+        if (node->whole)
+            return 1;
+
+        for (child = node->child; child && (strncmp(child->key, path, length) || child->key[length]); child = child->sibling)
+            ;
+        if (!child && !(child = newProjectionNode(root, node, path, length)))
+            return 0;
+
+        node = child;
+        if (!end)
+        {
+            node->whole = 1;
+            return 1;
+        }
+    }
+}
+
+// Retorna el hijo del nodo con la clave, o NULL si la clave no se pidio
+const ProjectionNode *findProjection(const ProjectionNode *node, const char *key)
+{
+    for (node = node->child; node; node = node->sibling)
+        if (!strcmp(node->key, key))
+            return node;
+    return NULL;
+}
+
+// Crea un diccionario a partir de los len caracteres del json, que no tiene que terminar en '\0', con las claves
+// de la proyeccion o con todas si es NULL
+Dictionary *parseDictionary(const DictionaryAllocator *allocator, const char *json, size_t len, const ProjectionNode *projection)
+{
+    long long start = STATS_CLOCK();
+    Dictionary *d = NULL;
+
+    parseJson(allocator, json, len, projection, &d);
+
+    STATS_ADD(parses, 1);
+    STATS_ADD(parsedBytes, (long long) len);
+    STATS_ADD(parseNanoseconds, STATS_CLOCK() - start);
+    return d;
+}
+
+// Hace el trabajo de parseDictionary y deja el diccionario en result. Lo anidado se lee con una pila de marcos en lugar
+// de recursion, asi el stack que se usa no depende de la profundidad, y sobre una sola copia del json que se recorre
+// una vez: cada marco sigue desde donde termino el que leyo su ultimo valor, asi el tiempo no depende de la
+// profundidad. Si result es NULL solo se verifica el json, sin crear nada. Retorna 0 si no es valido o no hay memoria
+int parseJson(const DictionaryAllocator *allocator, const char *json, size_t len, const ProjectionNode *projection, Dictionary **result)
+{
+    if (len < 2 || *json != '{' || json[len - 1] != '}') // Verifica que empiece por '{' y termine en '}'
+        return 0;
+
+    if (maxJsonLength && len > maxJsonLength)
+        return 0;
+
+    if (len >= INT_MAX || memchr(json, '\0', len)) // Los miembros se cuentan con int, y un '\0' cortaria el json
+        return 0;
+
+    char *text;
+    if ((text = (char *) allocate(allocator, len + 1)) == NULL)
+        return 0;
+
+    memcpy(text, json, len);
+    text[len] = '\0';
+
+    FrameStack stack;
+    ParseFrame *frame;
+    Dictionary *d = NULL;
+    int ok;
+
+    initFrames(&stack, allocator, sizeof(ParseFrame));
+    ok = beginParse(&stack, text, projection, !result);
+    while (ok && (frame = (ParseFrame *) topFrame(&stack)))
+        ok = continueParse(&stack, frame, &d);
+
+    // Si hubo algn error en el json se libera lo que se alcanzo a leer
+    while ((frame = (ParseFrame *) topFrame(&stack)))
+    {
+        releaseParseFrame(allocator, frame);
+        popFrame(&stack);
+    }
+
+    freeFrames(&stack);
+    release(allocator, text);
+    if (result)
+        *result = d;
+    return ok;
+}
+
+// Empieza a leer el diccionario en formato json que empieza en s con un marco nuevo en la pila. Guarda solo las claves
+// de la proyeccion, o todas si es NULL, y con validate solo lo verifica, sin crear el diccionario.
+// Retorna 0 si no es un diccionario, pasa de la profundidad maxima o no hay memoria
+int beginParse(FrameStack *stack, char *s, const ProjectionNode *projection, int validate)
+{
+    if (*s != '{')
+        return 0;
+
+    if (maxJsonDepth && stack->count >= maxJsonDepth)
+        return 0;
+
+    Dictionary *d = NULL;
+    if (!validate && !(d = newDictionaryWithAllocator(stack->allocator)))
+        return 0;
+
+    ParseFrame *frame;
+    if (!(frame = (ParseFrame *) pushFrame(stack)))
+    {
+        freeDictionary(d);
+        return 0;
+    }
+
+    frame->kind = 'd';
+    frame->position = s + 1;
+    frame->dictionary = d;
+    frame->projection = projection;
+    return 1;
+}
+
+// Lee lo siguiente del marco del tope de la pila. Cuando ya termino lo quita y entrega lo que leyo al marco de abajo,
+// o deja el diccionario en result si no hay otro. Retorna 0 si el json no es valido o no hay memoria
+int continueParse(FrameStack *stack, ParseFrame *frame, Dictionary **result)
+{
+    char *s = frame->position;
+    Dictionary **array;
+
+    if (frame->kind == 'a')
+    {
+        if (frame->next && *s == ']')
+        {
+            frame->position = s + 1;
+            frame->size = frame->next;
+            return finishDictionaryArray(stack, frame);
+        }
+        if (frame->next && *s++ != ',')
+            return 0;
+
+        if (frame->dictionary && frame->next == frame->size) // Se duplican los lugares, porque no se sabe cuantos son
+        {
+            if (!(array = (Dictionary **) reallocate(stack->allocator, frame->array,
+                                                     sizeof(Dictionary *) * 2 * frame->size)))
+                return 0;
+            frame->array = array;
+            frame->size *= 2;
+        }
+        return beginParse(stack, s, frame->projection, !frame->dictionary);
+    }
+
+    if (*s == '}')
+    {
+        if (stack->count == 1 && s[1] != '\0') // Despues del diccionario de afuera no puede haber nada
+            return 0;
+        frame->position = s + 1;
+
+        // Si se llega a este punto quiere decir que no hubo errores en el json y que ya se aadieron todos los elementos del diccionario
+        return finishDictionary(stack, frame, result);
+    }
+
+    if (frame->next && *s++ != ',')
+        return 0;
+    frame->next++;
+    return parseMember(stack, frame, s);
+}
+
+// Quita el marco de un arreglo de diccionarios que ya se termino de leer y agrega el arreglo a su diccionario.
+// Retorna 0 si no hay memoria
+int finishDictionaryArray(FrameStack *stack, ParseFrame *frame)
+{
+    const DictionaryAllocator *allocator = stack->allocator;
+    int added = 1, i;
+    Element *newp;
+
+    // Si se guardan por columnas se copian a la tabla, si no el arreglo se guarda sin copiar los diccionarios
+    if (!frame->dictionary) // Si solo se verifica no hay nada que guardar
+        ;
+    else if (sameShape(frame->size, frame->array))
+        added = setDictionaryArray(frame->dictionary, frame->key, frame->size, frame->array);
+    else
+    {
+        for(i = 0; interning && i < frame->size; i++)
+            frame->array[i] = shareCopy(frame->array[i]);
+        newp = newElement(allocator, frame->key, 'a', newArray(allocator, frame->array, frame->size, 'd'));
+        added = newp && putElement(frame->dictionary, newp);
+        frame->array = NULL; // Ya se guardaron, o newArray les hizo free
+        frame->next = 0;
+    }
+
+    char *position = frame->position;
+    releaseParseFrame(allocator, frame);
+    popFrame(stack);
+    ((ParseFrame *) topFrame(stack))->position = position; // El diccionario sigue despues del arreglo
+    return added;
+}
+
+// Quita el marco de un diccionario que ya se termino de leer y lo entrega al marco de abajo, o lo deja en result
+// si no hay otro. Retorna 0 si no hay memoria
+int finishDictionary(FrameStack *stack, ParseFrame *frame, Dictionary **result)
+{
+    const DictionaryAllocator *allocator = stack->allocator;
+    Dictionary *d = frame->dictionary;
+    char *position = frame->position;
+    Element *newp;
+
+    release(allocator, frame->keys);
+    popFrame(stack);
+    if (d)
+        shapeDictionary(d); // La forma se asigna al final para no tomar shapesLock por cada clave
+
+    if (!(frame = (ParseFrame *) topFrame(stack)))
+    {
+        *result = d;
+        return 1;
+    }
+    frame->position = position; // El marco de abajo sigue despues del diccionario
+
+    if (frame->kind == 'a')
+    {
+        if (d)
+            frame->array[frame->next] = d;
+        frame->next++;
+        return 1;
+    }
+
+    if (!d)
+        return 1;
+
+    // El diccionario anidado se guarda sin copiarlo, salvo que ya haya uno compartido igual
+    if (interning)
+        d = shareCopy(d);
+    if (!(newp = newElement(allocator, frame->key, 'd', d)))
+        return 0;
+    return putElement(frame->dictionary, newp);
+}
+
+// Lee el miembro del diccionario del marco que empieza en s y lo agrega al diccionario, si no solo se verifica y su clave
+// esta en la proyeccion. Si es un diccionario o un arreglo de diccionarios se empieza a leer con un marco nuevo en la
+// pila, si no el marco sigue despues del valor. Retorna 0 si no es valido o no hay memoria
+int parseMember(FrameStack *stack, ParseFrame *frame, char *s)
+{
+    Dictionary *d = frame->dictionary;
+    const ProjectionNode *projection = NULL;
+    char *key = frame->key, *start, *end, c;
+    int j, added;
+
+    if (*s++ != '"') // Verifica que la clave empiece en comillas
+        return 0;
+
+    start = s;
+    for(j = 0; *s != '"' && *s != '\0' && j < (int) sizeof(frame->key) - 1; j++) // Copia la clave
+        key[j] = *s++;
+    key[j] = '\0';
+
+    if(key[0] == '\0') // Verifica que la clave no sea un string vaco
+        return 0;
+
+    if (*s++ != '"') // Verifica que la clave haya terminado en comillas y que no sea demasiado larga
+        return 0;
+
+    if (*s++ != ':') // Verifica que haya ':' luego de la clave
+        return 0;
+
+    if (!addParsedKey(stack->allocator, frame, start)) // Verifica que no haya claves repetidas
+        return 0;
+
+    // Las claves que no estan en la proyeccion se saltan sin leer su valor
+    if (frame->projection)
+    {
+        if (!(projection = findProjection(frame->projection, key)))
+            return (frame->position = skipValue(s)) != NULL;
+        if (projection->whole)
+            projection = NULL;
+        else if (*s != '{' && *s != '[') // Solo se pidieron claves de adentro, y no es un diccionario
+            return (frame->position = skipValue(s)) != NULL;
+    }
+
+    // En este punto s guarda lo que corresponde al valor
+
+    if (*s == '"') // Si es un string
+    {
+        if (!(end = strchr(s + 1, '"')))
+            return 0;
+        *end = '\0';
+        frame->position = end + 1;
+        return !d || setString(d, key, s+1);
+    }
+    if (*s == '{') // Si es un diccionario
+        return beginParse(stack, s, projection, !d);
+    if (*s == '[') // Si es un arreglo
+        return parseArray(stack, frame, s, projection);
+
+    // Los demas valores terminan donde sigue otro miembro o se cierra el diccionario
+    end = s + strcspn(s, ",}]");
+    c = *end;
+    *end = '\0';
+    frame->position = end;
+
+    if (!strcmp(s, "true")) // Si es true
+        added = !d || setBool(d, key, true);
+    else if (!strcmp(s, "false")) // Si es false
+        added = !d || setBool(d, key, false);
+    else if (!strcmp(s, "null")) // Si es null
+        added = !d || setNull(d, key);
+    else if (isNumber(s)) // Si es un numero
+        added = !d || setNumber(d, key, atof(s));
+    else
+        added = 0;
+
+    *end = c;
+    return added;
+}
+
+// Lee el arreglo que empieza en s, que es el valor de la clave del marco, y lo agrega al diccionario si no solo se
+// verifica. Si es un arreglo de diccionarios se lee con un marco nuevo en la pila, y cada diccionario guarda las claves
+// de la proyeccion. Si hay proyeccion y no es un arreglo de diccionarios se salta. Retorna 0 si no es valido, pasa de la
+// profundidad maxima o no hay memoria
+int parseArray(FrameStack *stack, ParseFrame *frame, char *s, const ProjectionNode *projection)
+{
+    const DictionaryAllocator *allocator = stack->allocator;
+    Dictionary *d = frame->dictionary;
+    Dictionary **array = NULL;
+    char key[sizeof(frame->key)];
+
+    if (maxJsonDepth && stack->count >= maxJsonDepth)
+        return 0;
+    if (projection && s[1] != '{')
+        return (frame->position = skipValue(s)) != NULL;
+    if (s[1] != '{')
+        return parseScalarArray(frame, s, allocator);
+
+    // Es un arreglo de diccionarios, que se leen con su propio marco. Se reservan lugares para algunos y despues se
+    // duplican
+    strcpy(key, frame->key);
+    if ((!d || (array = (Dictionary **) allocateArray(allocator, 8, sizeof(Dictionary *))) != NULL) &&
+        (frame = (ParseFrame *) pushFrame(stack)) != NULL)
+    {
+        frame->kind = 'a';
+        frame->position = s + 1;
+        frame->size = 8;
+        frame->dictionary = d;
+        frame->array = array;
+        frame->projection = projection;
+        strcpy(frame->key, key);
+        return 1;
+    }
+
+    release(allocator, array);
+    return 0;
+}
+
+// Lee el arreglo de numeros, strings o booleanos que empieza en s, que es el valor de la clave del marco, y lo agrega
+// al diccionario si no solo se verifica. Primero se cuentan sus elementos, que no tienen nada anidado, y el marco sigue
+// despues del arreglo. Retorna 0 si no es valido o no hay memoria
+int parseScalarArray(ParseFrame *frame, char *s, const DictionaryAllocator *allocator)
+{
+    Dictionary *d = frame->dictionary;
+    int arraySize = 1, added = 0, j;
+    char *end, *p, *next;
+    void *array = NULL;
+
+    if (s[1] == '"') // Si es un arreglo de strings, se cuentan saltando lo que hay entre comillas
+    {
+        for(arraySize = 0, p = s + 1; ; p = end + 2)
+        {
+            if (*p != '"' || !(end = strchr(p + 1, '"')))
+                return 0;
+            arraySize++;
+            if (end[1] == ']')
+                break;
+            if (end[1] != ',')
+                return 0;
+        }
+        frame->position = end + 2;
+
+        char **strings = NULL;
+        if (!d || (array = strings = (char **) allocateArray(allocator, arraySize, sizeof(char *))) != NULL)
+        {
+            for(j = 0, p = s + 1; j < arraySize; j++, p = end + 2)
+            {
+                end = strchr(p + 1, '"');
+                *end = '\0';
+                if (strings)
+                    strings[j] = p + 1; // Guarda el string sin las comillas del inicio y del final
+            }
+            added = !d || setStringArray(d, frame->key, arraySize, strings);
+        }
+        release(allocator, array);
+        return added;
+    }
+
+    // Los numeros y booleanos no pueden tener ']', asi que el arreglo termina en el primero
+    if (!(end = strchr(s, ']')))
+        return 0;
+    for(p = s + 1; p < end; p++)
+        if (*p == ',')
+            arraySize++;
+    *end = '\0';
+    frame->position = end + 1;
+
+    if ((s[1] >= '0' && s[1] <= '9') || s[1] == '-') // Si es un arreglo de nmeros
+    {
+        double *numbers = NULL;
+        if (!d || (array = numbers = (double *) allocateArray(allocator, arraySize, sizeof(double))) != NULL)
+        {
+            for(j = 0, p = s + 1; j < arraySize; j++, p = next + 1)
+            {
+                next = p + strcspn(p, ","); // Cada elemento termina en una coma o en el final del arreglo
+                *next = '\0';
+                if (!isNumber(p))
+                    break;
+                if (numbers)
+                    numbers[j] = atof(p);
+            }
+
+            added = j == arraySize && (!d || setNumberArray(d, frame->key, arraySize, numbers));
+        }
+    }
+    else if (s[1] == 't' || s[1] == 'f') // Si es un arreglo booleano
+    {
+        Bool *bools = NULL;
+        if (!d || (array = bools = (Bool *) allocateArray(allocator, arraySize, sizeof(Bool))) != NULL)
+        {
+            for(j = 0, p = s + 1; j < arraySize; j++, p = next + 1)
+            {
+                next = p + strcspn(p, ",");
+                *next = '\0';
+                if (strcmp(p, "true") && strcmp(p, "false"))
+                    break;
+                if (bools)
+                    bools[j] = p[0] == 't' ? true : false;
+            }
+
+            added = j == arraySize && (!d || setBoolArray(d, frame->key, arraySize, bools));
+        }
+    }
+
+    release(allocator, array);
+    return added;
+}
+
+// Hace free a lo que se alcanzo a leer en un marco de parseJson y a sus miembros
+void releaseParseFrame(const DictionaryAllocator *allocator, ParseFrame *frame)
+{
+    int i;
+
+    if (frame->kind == 'd')
+        freeDictionary(frame->dictionary);
+    else
+    {
+        for(i = 0; frame->array && i < frame->next; i++)
+            freeDictionary(frame->array[i]);
+        release(allocator, frame->array);
+    }
+
+    release(allocator, frame->keys);
+}
+
+// Retorna el numero de hilos a usar, si threads no es positivo se usa uno por procesador. Nunca son mas de MAX_THREADS
+int threadCount(int threads)
+{
+    if (threads > 0)
+        return threads < MAX_THREADS ? threads : MAX_THREADS;
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > MAX_THREADS ? MAX_THREADS : processors > 0 ? processors : 1;
+}
+
+// Ejecuta worker con el trabajo job en threads hilos, hasta MAX_THREADS, uno de ellos es el hilo actual
+void runInParallel(void *(*worker)(void *), void *job, int threads)
+{
+    pthread_t ids[MAX_THREADS];
+    int i, created = 0;
+
+    for(i = 1; i < threads && i < MAX_THREADS; i++) // Si no se puede crear un hilo el resto del trabajo lo hacen los que ya existen
+        if (!pthread_create(&ids[created], NULL, worker, job))
+            created++;
+
+    worker(job);
+
+    for(i = 0; i < created; i++)
+        pthread_join(ids[i], NULL);
+}
+
+// Separa el texto en lineas sin copiarlas, ignorando las lineas vacias.
+// Guarda en lines el inicio, la longitud y el numero de cada linea y retorna cuantas hay, o -1 si no hay memoria
+int splitLines(const char *text, size_t len, Line **lines)
+{
+    const char *end = text + len, *newline;
+    int size = 0, capacity = 0, number;
+    *lines = NULL;
+
+    for(number = 1; text < end; text = newline + 1, number++)
+    {
+        if (!(newline = memchr(text, '\n', end - text)))
+            newline = end;
+
+        size_t lineLength = newline - text;
+        if (lineLength && text[lineLength - 1] == '\r') // Admite lineas terminadas en "\r\n"
+            lineLength--;
+
+        if (!lineLength)
+            continue;
+
+        if (size == capacity) // Se duplica la capacidad para no hacer un realloc por linea
+        {
+            Line *aux;
+            if (capacity > INT_MAX / 2) // Ya no caben mas lineas en un int
+            {
+                release(defaultAllocator, *lines);
+                *lines = NULL;
+                return -1;
+            }
+            capacity = capacity ? capacity * 2 : 1024;
+            if ((aux = (Line *) reallocate(defaultAllocator, *lines, sizeof(Line) * capacity)) == NULL)
+            {
+                release(defaultAllocator, *lines);
+                *lines = NULL;
+                return -1;
+            }
+            *lines = aux;
+        }
+
+        (*lines)[size].text = text;
+        (*lines)[size].length = lineLength;
+        (*lines)[size].number = number;
+        size++;
+    }
+
+    return size;
+}
+
+// Trabajo de cada hilo al leer json lines: toma bloques de lineas hasta que no queden mas
+void *parseLinesWorker(void *job)
+{
+    ParseJob *p = (ParseJob *) job;
+    int i, j;
+
+    while ((i = __atomic_fetch_add(&p->next, LINES_PER_TASK, __ATOMIC_RELAXED)) < p->size)
+        for(j = i; j < i + LINES_PER_TASK && j < p->size; j++)
+            p->results[j] = parseDictionary(defaultAllocator, p->lines[j].text, p->lines[j].length, NULL);
+
+    return NULL;
+}
+
+// Interpreta en paralelo las size lineas de lines y guarda los diccionarios en results
+void parseLines(Line *lines, int size, Dictionary **results, int threads)
+{
+    ParseJob job = {lines, results, size, 0};
+
+    threads = threadCount(threads);
+    if (threads > (size + LINES_PER_TASK - 1) / LINES_PER_TASK) // No tiene sentido tener hilos sin trabajo
+        threads = (size + LINES_PER_TASK - 1) / LINES_PER_TASK;
+
+    if (threads > 1)
+        runInParallel(parseLinesWorker, &job, threads);
+    else
+        parseLinesWorker(&job);
+}
+
+// Returns an array with the dictionaries parsed from each line of the given json lines text of length len, using the given
+// number of threads (0 means one per processor). Blank lines are skipped and lines that can't be parsed are NULL in the array.
+// Saves the number of lines in sizeResult. Returns NULL if it can't do it
+Dictionary **dictionariesFromJsonLines(const char *jsonLines, size_t len, int threads, int *sizeResult)
+{
+    if (!jsonLines)
+        return NULL;
+
+    Line *lines;
+    int size = splitLines(jsonLines, len, &lines);
+
+    if (size < 0)
+        return NULL;
+
+    Dictionary **dictionaries;
+    if ((dictionaries = (Dictionary **) allocate(defaultAllocator, sizeof(Dictionary *) * (size ? size : 1))) == NULL)
+    {
+        release(defaultAllocator, lines);
+        return NULL;
+    }
+
+    parseLines(lines, size, dictionaries, threads);
+    release(defaultAllocator, lines);
+
+    *sizeResult = size;
+    return dictionaries;
+}
+
+// Lee todo el contenido de fd en memoria dinamica, guardando su longitud en len. Retorna NULL si no puede hacerlo
+char *readAll(int fd, size_t *len)
+{
+    size_t capacity = 65536;
+    ssize_t bytes;
+    char *text, *aux;
+
+    if ((text = (char *) allocate(defaultAllocator, capacity)) == NULL)
+        return NULL;
+
+    *len = 0;
+    while ((bytes = read(fd, text + *len, capacity - *len)) != 0)
+    {
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            release(defaultAllocator, text);
+            return NULL;
+        }
+
+        *len += bytes;
+        if (*len == capacity)
+        {
+            capacity *= 2;
+            if ((aux = (char *) reallocate(defaultAllocator, text, capacity)) == NULL)
+            {
+                release(defaultAllocator, text);
+                return NULL;
+            }
+            text = aux;
+        }
+    }
+
+    return text;
+}
+
+// Returns an array with the dictionaries parsed from each line read from the given file descriptor until its end.
+// Works like dictionariesFromJsonLines
+Dictionary **dictionariesFromJsonLinesFd(int fd, int threads, int *sizeResult)
+{
+    size_t len;
+    char *text = readAll(fd, &len);
+
+    if (!text)
+        return NULL;
+
+    Dictionary **dictionaries = dictionariesFromJsonLines(text, len, threads, sizeResult);
+    release(defaultAllocator, text);
+    return dictionaries;
+}
+
+// Returns an array with the dictionaries parsed from each line of the file in the given path.
+// Works like dictionariesFromJsonLines
+Dictionary **dictionariesFromJsonLinesFile(const char *path, int threads, int *sizeResult)
+{
+    int fd;
+    struct stat info;
+    Dictionary **dictionaries;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        // Si no es un archivo regular no se puede proyectar en memoria
+        dictionaries = dictionariesFromJsonLinesFd(fd, threads, sizeResult);
+        close(fd);
+        return dictionaries;
+    }
+
+    // Se proyecta el archivo en memoria para no tener que copiarlo
+    void *text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (text == MAP_FAILED)
+        return NULL;
+
+    dictionaries = dictionariesFromJsonLines(text, info.st_size, threads, sizeResult);
+    munmap(text, info.st_size);
+    return dictionaries;
+}
+
+// Parses each line of the given json lines text of length len using the given number of threads (0 means one per processor)
+// and calls callback in order with the line number (starting at 1), the parsed dictionary or NULL if the line can't be parsed,
+// and data. The callback owns the dictionary. Blank lines are skipped.
+// Returns the number of lines that couldn't be parsed, or -1 if it can't do it
+int forEachJsonLine(const char *jsonLines, size_t len, int threads,
+                    void (*callback)(int line, Dictionary *dictionary, void *data), void *data)
+{
+    if (!jsonLines || !callback)
+        return -1;
+
+    Line *lines;
+    int size = splitLines(jsonLines, len, &lines);
+
+    if (size < 0)
+        return -1;
+
+    // Se procesa por lotes para no tener todos los diccionarios en memoria al mismo tiempo
+    Dictionary **batch;
+    int batchSize = size < LINES_PER_BATCH ? size : LINES_PER_BATCH;
+    if ((batch = (Dictionary **) allocate(defaultAllocator, sizeof(Dictionary *) * (batchSize ? batchSize : 1))) == NULL)
+    {
+        release(defaultAllocator, lines);
+        return -1;
+    }
+
+    int i, j, errors = 0;
+    for(i = 0; i < size; i += batchSize)
+    {
+        int count = size - i < batchSize ? size - i : batchSize;
+
+        parseLines(lines + i, count, batch, threads);
+
+        for(j = 0; j < count; j++)
+        {
+            if (!batch[j])
+                errors++;
+            callback(lines[i + j].number, batch[j], data);
+        }
+    }
+
+    release(defaultAllocator, batch);
+    release(defaultAllocator, lines);
+    return errors;
+}
+
+// Trabajo de cada hilo al escribir json lines: toma bloques de diccionarios hasta que no queden mas
+void *serializeWorker(void *job)
+{
+    SerializeJob *p = (SerializeJob *) job;
+    int i, j;
+
+    while ((i = __atomic_fetch_add(&p->next, LINES_PER_TASK, __ATOMIC_RELAXED)) < p->size)
+        for(j = i; j < i + LINES_PER_TASK && j < p->size; j++)
+            p->results[j] = jsonFromDictionary(p->dictionaries[j]);
+
+    return NULL;
+}
+
+// Obtiene en paralelo el json de los size diccionarios y los guarda en results
+void serializeDictionaries(Dictionary **dictionaries, int size, char **results, int threads)
+{
+    SerializeJob job = {dictionaries, results, size, 0};
+
+    threads = threadCount(threads);
+    if (threads > (size + LINES_PER_TASK - 1) / LINES_PER_TASK)
+        threads = (size + LINES_PER_TASK - 1) / LINES_PER_TASK;
+
+    if (threads > 1)
+        runInParallel(serializeWorker, &job, threads);
+    else
+        serializeWorker(&job);
+}
+
+// Returns the json lines representation of the given dictionaries, one line per dictionary, serialized using the given
+// number of threads (0 means one per processor). NULL dictionaries are skipped. If it can't do it returns NULL
+char *jsonLinesFromDictionaries(int size, Dictionary *dictionaries[size], int threads)
+{
+    char **jsons;
+    if ((jsons = (char **) allocate(defaultAllocator, sizeof(char *) * (size > 0 ? size : 1))) == NULL)
+        return NULL;
+
+    serializeDictionaries(dictionaries, size, jsons, threads);
+
+    size_t len = 0, *lengths;
+    if ((lengths = (size_t *) allocate(defaultAllocator, sizeof(size_t) * (size > 0 ? size : 1))) == NULL)
+    {
+        release(defaultAllocator, jsons);
+        return NULL;
+    }
+
+    int i, failed = 0;
+    for(i = 0; i < size; i++) // Calcula el tamano total para reservarlo de una vez
+    {
+        lengths[i] = jsons[i] ? strlen(jsons[i]) : 0;
+        len += lengths[i] + 1;
+        if (!jsons[i] && dictionaries[i])
+            failed = 1;
+    }
+
+    char *text = NULL, *aux;
+    if (!failed && (text = (char *) allocate(defaultAllocator, len + 1)) != NULL)
+    {
+        for(aux = text, i = 0; i < size; i++)
+        {
+            if (!jsons[i])
+                continue;
+            memcpy(aux, jsons[i], lengths[i]);
+            aux += lengths[i];
+            *aux++ = '\n';
+        }
+        *aux = '\0';
+    }
+
+    for(i = 0; i < size; i++)
+        if (jsons[i])
+            release(dictionaries[i]->allocator, jsons[i]);
+    release(defaultAllocator, jsons);
+    release(defaultAllocator, lengths);
+
+    return text;
+}
+
+// Escribe los len bytes de text en fd. Retorna 1 si pudo hacerlo, de lo contrario retorna 0
+int writeAll(int fd, const char *text, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t bytes = write(fd, text, len);
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        text += bytes;
+        len -= bytes;
+    }
+
+    return 1;
+}
+
+// Writes the json lines representation of the given dictionaries to the given file descriptor, like jsonLinesFromDictionaries.
+// Returns 1 if it was able to do it otherwise returns 0
+int writeJsonLines(int fd, int size, Dictionary *dictionaries[size], int threads)
+{
+    int i;
+
+    // Se escribe por lotes para no tener todo el texto en memoria al mismo tiempo
+    for(i = 0; i < size; i += LINES_PER_BATCH)
+    {
+        int count = size - i < LINES_PER_BATCH ? size - i : LINES_PER_BATCH;
+        char *text = jsonLinesFromDictionaries(count, dictionaries + i, threads);
+
+        if (!text)
+            return 0;
+
+        int written = writeAll(fd, text, strlen(text));
+        release(defaultAllocator, text);
+
+        if (!written)
+            return 0;
+    }
+
+    return 1;
+}
+
+// Writes the json lines representation of the given dictionaries to the file in the given path, replacing its content.
+// Returns 1 if it was able to do it otherwise returns 0
+int writeJsonLinesFile(const char *path, int size, Dictionary *dictionaries[size], int threads)
+{
+    int fd;
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+        return 0;
+
+    int written = writeJsonLines(fd, size, dictionaries, threads);
+
+    if (close(fd) < 0)
+        written = 0;
+
+    return written;
+}
+
+// Agrega una clave precedida por su largo
+void encodeKey(Buffer *buffer, const char *key)
+{
+    unsigned char length = strlen(key);
+
+    appendBytes(buffer, (const char *) &length, 1);
+    appendBytes(buffer, key, length);
+}
+
+// Agrega un string precedido por su largo. Si no cabe en 32 bits el texto queda fallido
+void encodeString(Buffer *buffer, const char *s, size_t length)
+{
+    unsigned int size = length;
+
+    if (length > UINT_MAX)
+    {
+        failBuffer(buffer);
+        return;
+    }
+    appendBytes(buffer, (const char *) &size, 4);
+    appendBytes(buffer, s, length);
+}
+
+// Agrega al final del texto el valor de tipo type en binario, como se guarda en los registros y el snapshot de un store:
+// su tipo y su contenido. Los numeros y los arreglos numericos y booleanos se copian como estan en memoria, los strings
+// van precedidos por su largo, los diccionarios por su cantidad de elementos y cada elemento por su clave, y las tablas
+// se guardan como arreglos de diccionarios. Lo anidado se recorre con una pila de marcos
+void encodeValue(Buffer *buffer, char type, const void *value)
+{
+    FrameStack stack;
+    SerializeFrame *frame;
+
+    initFrames(&stack, buffer->allocator, sizeof(SerializeFrame));
+    beginEncode(buffer, &stack, type, value);
+    while (!buffer->failed && (frame = (SerializeFrame *) topFrame(&stack)) != NULL)
+        continueEncode(buffer, &stack, frame);
+    freeFrames(&stack);
+}
+
+// Agrega el valor de tipo type. El contenido de un diccionario o de un arreglo de diccionarios se agrega despues, con
+// un marco nuevo en la pila
+void beginEncode(Buffer *buffer, FrameStack *stack, char type, const void *value)
+{
+    const Array *array = (const Array *) value;
+    SerializeFrame *frame;
+    unsigned int size;
+    char c;
+    int i;
+
+    appendBytes(buffer, &type, 1);
+    switch (type)
+    {
+        case 'n':
+            appendBytes(buffer, (const char *) value, sizeof(double));
+            return;
+        case 'b':
+            c = *(const Bool *) value == true;
+            appendBytes(buffer, &c, 1);
+            return;
+        case 's':
+            encodeString(buffer, (const char *) value, strlen((const char *) value));
+            return;
+        case 'z':
+            return;
+        case 'd':
+            size = countElements((const Dictionary *) value);
+            appendBytes(buffer, (const char *) &size, 4);
+            break;
+        default: // 'a'
+            c = array->type == 'c' ? 'd' : array->type;
+            size = array->size;
+            appendBytes(buffer, &c, 1);
+            appendBytes(buffer, (const char *) &size, 4);
+            if (array->type == 'n')
+                appendBytes(buffer, (const char *) array->elements, (size_t) size * sizeof(double));
+            else if (array->type == 'b')
+                appendBytes(buffer, (const char *) array->elements, (size_t) wordCount(size) * sizeof(unsigned long long));
+            else if (array->type == 's')
+                for(i = 0; i < array->size; i++)
+                    encodeString(buffer, ((char **) array->elements)[i], strlen(((char **) array->elements)[i]));
+            if (c != 'd')
+                return;
+    }
+
+    if (!(frame = (SerializeFrame *) pushFrame(stack)))
+    {
+        failBuffer(buffer);
+        return;
+    }
+    frame->kind = type;
+    frame->value = value;
+    frame->next = type == 'd' ? ((const Dictionary *) value)->first : NULL;
+    frame->index = 0;
+}
+
+// Agrega lo siguiente del marco del tope de la pila, o lo quita si ya termino
+void continueEncode(Buffer *buffer, FrameStack *stack, SerializeFrame *frame)
+{
+    const Array *array = (const Array *) frame->value;
+    const Table *table = (const Table *) frame->value;
+    const Element *aux;
+    unsigned int columns;
+    int i;
+
+    switch (frame->kind)
+    {
+        case 'd':
+            if ((aux = frame->next) != NULL)
+            {
+                frame->next = aux->next;
+                encodeKey(buffer, aux->key);
+                beginEncode(buffer, stack, aux->type, aux->value);
+                return;
+            }
+            break;
+        case 'a':
+            if ((i = frame->index) < array->size)
+            {
+                frame->index++;
+                if (array->type == 'd')
+                    beginEncode(buffer, stack, 'd', ((Dictionary **) array->elements)[i]);
+                else if ((frame = (SerializeFrame *) pushFrame(stack)) != NULL) // Cada fila de la tabla es un diccionario
+                {
+                    table = (const Table *) array->elements;
+                    columns = table->columns;
+                    appendBytes(buffer, "d", 1);
+                    appendBytes(buffer, (const char *) &columns, 4);
+                    frame->kind = 'r';
+                    frame->value = table;
+                    frame->index = 0;
+                    frame->row = i;
+                }
+                else
+                    failBuffer(buffer);
+                return;
+            }
+            break;
+        case 'r':
+            if ((i = frame->index) < table->columns)
+            {
+                frame->index++;
+                encodeKey(buffer, table->keys[i]);
+                beginEncode(buffer, stack, table->types[i], cellValue(table, i, frame->row));
+                return;
+            }
+            break;
+    }
+    popFrame(stack);
+}
+
+// Copia en result los siguientes length bytes. Retorna 0 si no quedan tantos
+int readBytes(Reader *reader, void *result, size_t length)
+{
+    if (length > reader->length - reader->position)
+        return 0;
+
+    memcpy(result, reader->data + reader->position, length);
+    reader->position += length;
+    return 1;
+}
+
+// Salta los siguientes length bytes y retorna donde empiezan, o NULL si no quedan tantos
+const char *skipBytes(Reader *reader, size_t length)
+{
+    if (length > reader->length - reader->position)
+        return NULL;
+
+    reader->position += length;
+    return reader->data + reader->position - length;
+}
+
+// Lee una clave a key, que tiene lugar para la de un elemento. Retorna 0 si no es valida
+int readKey(Reader *reader, char *key)
+{
+    unsigned char length;
+
+    if (!readBytes(reader, &length, 1) || !length || length >= 80 || !readBytes(reader, key, length) ||
+        memchr(key, '\0', length))
+        return 0;
+
+    key[length] = '\0';
+    return 1;
+}
+
+// Lee count elementos al diccionario, reemplazando los que tengan la misma clave. Lo anidado se lee con una pila de
+// marcos como la de parseJson, cuyo primer marco es el del diccionario y no se termina. Retorna 0 si no son validos o no
+// hay memoria, y en ese caso el diccionario queda con los elementos que se alcanzaron a leer
+int decodeMembers(Reader *reader, Dictionary *dictionary, unsigned int count)
+{
+    FrameStack stack;
+    ParseFrame *frame;
+    int decoded = 0;
+
+    initFrames(&stack, dictionary->allocator, sizeof(ParseFrame));
+    if (count <= INT_MAX && count <= reader->length - reader->position &&
+        (frame = (ParseFrame *) pushFrame(&stack)) != NULL)
+    {
+        memset(frame, 0, sizeof(ParseFrame));
+        frame->kind = 'd';
+        frame->dictionary = dictionary;
+        frame->size = count;
+        decoded = 1;
+        while (decoded && (frame = (ParseFrame *) topFrame(&stack)) != NULL && (stack.count > 1 || frame->next < frame->size))
+            decoded = continueDecode(&stack, frame, reader);
+    }
 
-    if (minus && dot) // Si hay tanto menos como punto
+    // Si hubo un error se libera lo que se alcanzo a leer de los anidados
+    while (stack.count > 1)
     {
-        // Verifica que solo haya un menos y que est al inicio,
-        // que haya un solo punto y no est inmediatamente despus del menos ni al final
-        if (minus == strrchr(str, '-') && minus == str && dot == strrchr(str, '.') && dot > minus+1 && dot != str+len-1)
-            return 1;
-        return 0;
+        frame = (ParseFrame *) topFrame(&stack);
+        releaseParseFrame(stack.allocator, frame);
+        popFrame(&stack);
     }
-    if (minus) // Si hay menos pero no punto
+    freeFrames(&stack);
+    return decoded;
+}
+
+// Lee la cantidad de elementos de un diccionario anidado y empieza a leerlo con un marco nuevo en la pila.
+// Retorna 0 si no es valida o no hay memoria
+int beginDecode(FrameStack *stack, Reader *reader)
+{
+    unsigned int count;
+    Dictionary *d;
+    ParseFrame *frame;
+
+    // Cada elemento ocupa al menos un byte, asi una cantidad danada no pide memoria de mas
+    if (!readBytes(reader, &count, 4) || count > INT_MAX || count > reader->length - reader->position ||
+        !(d = newDictionaryWithAllocator(stack->allocator)))
+        return 0;
+
+    if (!(frame = (ParseFrame *) pushFrame(stack)))
     {
-        // Verifica que haya uno solo y no est en el inicio
-        if (minus == strrchr(str, '-') && minus == str)
-            return 1;
+        freeDictionary(d);
         return 0;
     }
-    if (dot) // Si hay punto pero no menos
+    memset(frame, 0, sizeof(ParseFrame));
+    frame->kind = 'd';
+    frame->dictionary = d;
+    frame->size = count;
+    return 1;
+}
+
+// Lee lo siguiente del marco del tope de la pila, o lo termina como continueParse.
+// Retorna 0 si no es valido o no hay memoria
+int continueDecode(FrameStack *stack, ParseFrame *frame, Reader *reader)
+{
+    char type;
+
+    if (frame->kind == 'a')
     {
-        // Verifica que solo haya uno y no est ni al inicio ni al final
-        if(dot == strrchr(str, '.') && dot != str && dot != str+len-1)
-            return 1;
-        return 0;
+        if (frame->next < frame->size)
+            return readBytes(reader, &type, 1) && type == 'd' && beginDecode(stack, reader);
+        return finishDictionaryArray(stack, frame);
     }
 
-    return 1;
+    if (frame->next < frame->size)
+    {
+        frame->next++;
+        return decodeMember(stack, frame, reader);
+    }
+    return finishDictionary(stack, frame, NULL);
 }
 
-// Separa en subcadenas los elementos de un diccionario o un arreglo en formato json
-char **split(char *str, int *size)
+// Lee un elemento y lo agrega al diccionario del marco. Si es un diccionario o un arreglo de diccionarios se empieza a
+// leer con un marco nuevo en la pila. Retorna 0 si no es valido o no hay memoria
+int decodeMember(FrameStack *stack, ParseFrame *frame, Reader *reader)
 {
-    int i, j, len = strlen(str),
-        count1 = 0, // Se encarga de los ""
-        count2 = 0, // Se encarga de los {}
-        count3 = 0; // Se encarga de los []
-    *size = 0;
-    char **array = NULL;
+    Dictionary *d = frame->dictionary;
+    const char *bytes;
+    unsigned int length;
+    double number;
+    char type, c;
+
+    if (!readKey(reader, frame->key) || !readBytes(reader, &type, 1))
+        return 0;
 
-    for(i = 0, j = 0; i <= len; i++)
+    switch (type)
     {
-        if (str[i] == '"')
-            count1 = !count1;
-        else if (str[i] == '{')
-            count2++;
-        else if (str[i] == '}')
-            count2--;
-        else if (str[i] == '[')
-            count3++;
-        else if (str[i] == ']')
-            count3--;
-        else if ((str[i] == ',' && !count1 && !count2 && !count3) || str[i] == '\0')
-        {
-            str[i] = '\0';
-            (*size)++;
-            array = (char **) realloc(array, sizeof(char *) * (*size));
-            array[*size - 1] = str + j;
-            j = i + 1;
-        }
+        case 'n':
+            return readBytes(reader, &number, sizeof(double)) && setNumber(d, frame->key, number);
+        case 'b':
+            return readBytes(reader, &c, 1) && setBool(d, frame->key, c ? true : false);
+        case 's':
+            return readBytes(reader, &length, 4) && (bytes = skipBytes(reader, length)) != NULL &&
+                   setStringWithLength(d, frame->key, bytes, length);
+        case 'z':
+            return setNull(d, frame->key);
+        case 'd':
+            return beginDecode(stack, reader);
+        case 'a':
+            return decodeArray(stack, frame, reader);
     }
-    return array;
+    return 0;
 }
 
-// Retorna 1 si la clave ya existe en el diccionario, de lo contrario retorna 0
-int keyExists(const char *key, const Dictionary *dictionary)
+// Lee un arreglo y lo agrega al diccionario del marco. Si es de diccionarios se leen con un marco nuevo en la pila.
+// Retorna 0 si no es valido o no hay memoria
+int decodeArray(FrameStack *stack, ParseFrame *frame, Reader *reader)
 {
-    if (!dictionary)
+    const DictionaryAllocator *allocator = stack->allocator;
+    Dictionary *d = frame->dictionary;
+    char key[80], type, **strings;
+    const char *bytes;
+    unsigned int size, length, i;
+    size_t elementSize, minimum;
+    void *elements;
+    Element *newp;
+
+    if (!readBytes(reader, &type, 1) || !readBytes(reader, &size, 4) || size > INT_MAX)
         return 0;
 
-    Element *aux;
+    // Antes de pedir memoria se verifica que queden los bytes de los elementos, o al menos los que ocupan como minimo
+    // los strings, con su largo, y los diccionarios, con su tipo y su cantidad de elementos. Asi un largo danado no
+    // pide memoria de mas
+    if (type == 'n')
+        minimum = (size_t) size * sizeof(double);
+    else if (type == 'b')
+        minimum = (size_t) wordCount(size) * sizeof(unsigned long long);
+    else
+        minimum = (size_t) size * (type == 's' ? 4 : 5);
+    if (minimum > reader->length - reader->position)
+        return 0;
 
-    for (aux = dictionary->first; aux; aux = aux->next)
-        if (!strcmp(aux->key, key))
+    switch (type)
+    {
+        case 'n':
+        case 'b':
+            length = type == 'n' ? size : (unsigned int) wordCount(size);
+            elementSize = type == 'n' ? sizeof(double) : sizeof(unsigned long long);
+            if (!(bytes = skipBytes(reader, length * elementSize)) || !(elements = allocateArray(allocator, length, elementSize)))
+                return 0;
+            memcpy(elements, bytes, length * elementSize);
+            break;
+        case 's':
+            if (!(strings = (char **) allocateArray(allocator, size, sizeof(char *))))
+                return 0;
+            for(i = 0; i < size; i++)
+            {
+                if (!readBytes(reader, &length, 4) || !(bytes = skipBytes(reader, length)) || memchr(bytes, '\0', length) ||
+                    !(strings[i] = (char *) allocate(allocator, (size_t) length + 1)))
+                {
+                    freeArrayElements(allocator, 's', strings, i);
+                    release(allocator, strings);
+                    return 0;
+                }
+                memcpy(strings[i], bytes, length);
+                strings[i][length] = '\0';
+            }
+            elements = strings;
+            break;
+        case 'd':
+            if (!(elements = allocateArray(allocator, size, sizeof(Dictionary *))))
+                return 0;
+            strcpy(key, frame->key);
+            if (!(frame = (ParseFrame *) pushFrame(stack)))
+            {
+                release(allocator, elements);
+                return 0;
+            }
+            memset(frame, 0, sizeof(ParseFrame));
+            frame->kind = 'a';
+            frame->dictionary = d;
+            frame->array = (Dictionary **) elements;
+            frame->size = size;
+            strcpy(frame->key, key);
             return 1;
+        default:
+            return 0;
+    }
 
-    return 0;
+    newp = newElement(allocator, frame->key, 'a', newArray(allocator, elements, size, type));
+    return newp && putElement(d, newp);
 }
 
-// Returns a new dictionary created from its json representation. If it can't parse the json returns NULL
-Dictionary *dictionaryFromJson(const char *json)
+// Llena la tabla del CRC-32C, con el polinomio de Castagnoli reflejado
+void createCrcTable(void)
 {
-    if (!json || *json != '{') // Verifica la existencia del string y que empience por '{'
-        return NULL;
+    unsigned int i, j, crc;
+
+    for(i = 0; i < 256; i++)
+    {
+        crc = i;
+        for(j = 0; j < 8; j++)
+            crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+        crcTable[i] = crc;
+    }
+}
 
-    int len = strlen(json);
+// CRC-32C de los bytes, para reconocer un registro escrito a medias o danado
+unsigned int checksum(const char *data, size_t length)
+{
+    unsigned int crc = 0xffffffff;
 
-    if (json[len - 1] != '}') // Vertifica que el json termine en '}'
-        return NULL;
+    pthread_once(&crcOnce, createCrcTable);
+    while (length--)
+        crc = crcTable[(crc ^ (unsigned char) *data++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
 
-    char jsonCopy[len];
+// Retorna la ruta del archivo del store de nombre name, seguido de la generacion si no es 0, o NULL si no hay memoria
+char *storePath(const DictionaryStore *store, const char *name, unsigned long long generation)
+{
+    size_t length = strlen(store->directory) + strlen(name) + 32;
+    char *path;
 
-    strcpy(jsonCopy, json+1); // Borra las llaves de inicio y fin
-    jsonCopy[len - 2] = '\0';
+    if (!(path = (char *) allocate(&mallocAllocator, length)))
+        return NULL;
 
-    Dictionary *d = newDictionary();
+    if (generation)
+        snprintf(path, length, "%s/%s.%llu", store->directory, name, generation);
+    else
+        snprintf(path, length, "%s/%s", store->directory, name);
+    return path;
+}
 
-    int size, i, j;
-    char **jsonArray = split(jsonCopy, &size); // Separa el json
+// Abre un archivo del store como open. Retorna su descriptor o -1 si no puede, con la causa en errno
+int openStoreFile(const DictionaryStore *store, const char *name, unsigned long long generation, int flags)
+{
+    char *path;
+    int fd, error;
 
-    if (jsonArray[0][0] == '\0') // Si era un diccionario vacio
+    if (!(path = storePath(store, name, generation)))
     {
-        free(jsonArray);
-        return d;
+        errno = ENOMEM;
+        return -1;
     }
 
-    char key[80];
+    fd = open(path, flags, 0666);
+    error = errno;
+    release(&mallocAllocator, path);
+    errno = error;
+    return fd;
+}
 
-    for(i = 0; i < size; i++)
+// Borra un archivo del store, si existe
+void unlinkStoreFile(const DictionaryStore *store, const char *name, unsigned long long generation)
+{
+    char *path;
+
+    if ((path = storePath(store, name, generation)) != NULL)
     {
-        char *s = jsonArray[i]; // Para facilitar la lectura
+        unlink(path);
+        release(&mallocAllocator, path);
+    }
+}
 
-        if (*s++ != '"') // Verifica que la clave empiece en comillas
-            break;
+// Hace fsync al directorio, asi los archivos que se crearon, renombraron o borraron quedan en disco.
+// Retorna 1 si pudo hacerlo, de lo contrario retorna 0
+int syncDirectory(const char *directory)
+{
+    int fd, synced;
 
-        for(j = 0; *s != '"' && *s != '\0'; j++) // Copia la clave
-            key[j] = *s++;
-        key[j] = '\0';
+    if ((fd = open(directory, O_RDONLY)) < 0)
+        return 0;
 
-        if(key[0] == '\0') // Verifica que la clave no sea un string vaco
-            break;
+    synced = !fsync(fd);
+    if (close(fd) < 0)
+        synced = 0;
+    return synced;
+}
 
-        if (*s++ == '\0') // Verifica que la clave haya terminado en comillas
-            break;
+// Crea el log de la generacion, vacio salvo por su encabezado y ya en disco.
+// Retorna su descriptor, abierto para agregar al final, o -1 si no puede
+int createLog(DictionaryStore *store, unsigned long long generation)
+{
+    char header[LOG_HEADER_BYTES];
+    unsigned int version = STORE_VERSION;
+    int fd;
+
+    memcpy(header, "DLOG", 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &generation, 8);
+    if ((fd = openStoreFile(store, "log", generation, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND)) < 0)
+        return -1;
+
+    if (!writeAll(fd, header, LOG_HEADER_BYTES) || fsync(fd) < 0 || !syncDirectory(store->directory))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Aplica al diccionario los registros del log de la generacion, y guarda en valid el largo del log hasta el ultimo
+// registro completo. Retorna 0 si el log no existe, 1 si se aplico entero, 2 si termina en un registro escrito a medias,
+// que se ignora, o -1 si no se puede leer o tiene un registro completo que no es valido
+int replayLog(DictionaryStore *store, Dictionary *dictionary, unsigned long long generation, size_t *valid)
+{
+    unsigned long long logGeneration;
+    unsigned int version, length, crc;
+    Reader reader;
+    size_t size;
+    char *data;
+    int fd, replayed = 1;
+
+    if ((fd = openStoreFile(store, "log", generation, O_RDONLY)) < 0)
+        return errno == ENOENT ? 0 : -1;
+    data = readAll(fd, &size);
+    close(fd);
+    if (!data)
+        return -1;
+
+    *valid = 0;
+    if (size < LOG_HEADER_BYTES) // Se corto al crearlo
+        replayed = 2;
+    else
+    {
+        memcpy(&version, data + 4, 4);
+        memcpy(&logGeneration, data + 8, 8);
+        if (memcmp(data, "DLOG", 4) || version != STORE_VERSION || logGeneration != generation)
+            replayed = -1;
+        *valid = LOG_HEADER_BYTES;
+    }
 
-        if (*s++ != ':') // Verifica que haya ':' luego de la clave
+    while (replayed == 1 && *valid < size)
+    {
+        if (size - *valid < RECORD_HEADER_BYTES)
+        {
+            replayed = 2;
             break;
+        }
 
-        if (keyExists(key, d)) // Verifica que no haya claves repetidas
+        memcpy(&length, data + *valid, 4);
+        memcpy(&crc, data + *valid + 4, 4);
+        if (length > size - *valid - RECORD_HEADER_BYTES || checksum(data + *valid + RECORD_HEADER_BYTES, length) != crc)
+        {
+            replayed = 2;
             break;
+        }
+
+        reader.data = data + *valid + RECORD_HEADER_BYTES;
+        reader.length = length;
+        reader.position = 0;
+        if (!applyRecord(dictionary, &reader))
+            replayed = -1;
+        *valid += RECORD_HEADER_BYTES + length;
+    }
+
+    release(defaultAllocator, data);
+    return replayed;
+}
 
-        // En este punto s guarda lo que corresponde al valor
+// Aplica al diccionario un registro del log: 'S' y un elemento lo agrega, 'U' y un elemento le cambia el valor sin
+// moverlo, y 'R' y una clave la quita. Retorna 0 si no es valido o no hay memoria
+int applyRecord(Dictionary *dictionary, Reader *reader)
+{
+    long long comparisons = 0;
+    Dictionary *update;
+    Element *target, *aux;
+    char operation, key[80], type;
+    void *value;
+    int updated;
+
+    if (!readBytes(reader, &operation, 1))
+        return 0;
 
-        if (*s == '"') // Si es un string
+    if (operation == 'S')
+        return decodeMembers(reader, dictionary, 1) && reader->position == reader->length;
+    if (operation == 'U') // El valor nuevo se lee aparte y se intercambia con el del elemento
+    {
+        if (!(update = newDictionaryWithAllocator(dictionary->allocator)))
+            return 0;
+        updated = decodeMembers(reader, update, 1) && reader->position == reader->length && (aux = update->first) &&
+                  (target = lookupElement(dictionary, aux->key, &comparisons)) != NULL;
+        if (updated)
         {
-            int lastChar = strlen(s) - 1;
-            if(s[lastChar] != '"')
-                break;
-            s[lastChar] = '\0';
-            setString(d, key, s+1);
-        }
-        else if (!strcmp(s, "true")) // Si es true
-            setBool(d, key, true);
-        else if (!strcmp(s, "false")) // Si es false
-            setBool(d, key, false);
-        else if (isNumber(s)) // Si es un numero
-            setNumber(d, key, atof(s));
-        else if (*s == '{') // Si es un diccionario
-        {
-            Dictionary *dAux;
-            if ((dAux = dictionaryFromJson(s))) // Si es un diccionario valido
-            {
-                setDictionary(d, key, dAux);
-                freeDictionary(dAux);
-            }
-            else
-                break;
+            dictionary->hash -= hashElement(target->key, target->type, target->value);
+            type = target->type;
+            value = target->value;
+            target->type = aux->type;
+            target->value = aux->value;
+            aux->type = type;
+            aux->value = value;
+            dictionary->hash += hashElement(target->key, target->type, target->value);
+            invalidateJson(dictionary);
         }
-        else if (*s == '[') // Si es un arreglo
-        {
-            int arraySize, valid = 1, lastChar = strlen(s) - 1;
-            if(s[lastChar] != ']')
-                break;
-            s[lastChar] = '\0';
+        freeDictionary(update);
+        return updated;
+    }
+    if (operation == 'R' && readKey(reader, key) && reader->position == reader->length)
+    {
+        removeElement(dictionary, key);
+        return 1;
+    }
+    return 0;
+}
 
-            char **arrayElements = split(s+1, &arraySize);
+// Lee el snapshot del store al diccionario vacio. Retorna la generacion del primer log que no esta en el snapshot, 1 si
+// no hay snapshot o 0 si no se puede leer o no es valido
+unsigned long long loadSnapshot(DictionaryStore *store, Dictionary *dictionary)
+{
+    unsigned long long generation = 0, length;
+    unsigned int version, crc, count;
+    Reader reader;
+    size_t size;
+    char *data, type;
+    int fd;
+
+    if ((fd = openStoreFile(store, "snapshot", 0, O_RDONLY)) < 0)
+        return errno == ENOENT ? 1 : 0;
+    data = readAll(fd, &size);
+    close(fd);
+    if (!data)
+        return 0;
 
-            if ((arrayElements[0][0] >= '0' && arrayElements[0][0] <= '9') || arrayElements[0][0] == '-') // Si es un arreglo de nmeros
-            {
-                double array[arraySize];
+    if (size >= SNAPSHOT_HEADER_BYTES && !memcmp(data, "DSNP", 4))
+    {
+        memcpy(&version, data + 4, 4);
+        memcpy(&generation, data + 8, 8);
+        memcpy(&length, data + 16, 8);
+        memcpy(&crc, data + 24, 4);
+        reader.data = data + SNAPSHOT_HEADER_BYTES;
+        reader.length = size - SNAPSHOT_HEADER_BYTES;
+        reader.position = 0;
+        if (version != STORE_VERSION || length != reader.length || checksum(reader.data, reader.length) != crc ||
+            !readBytes(&reader, &type, 1) || type != 'd' || !readBytes(&reader, &count, 4) ||
+            !decodeMembers(&reader, dictionary, count) || reader.position != reader.length)
+            generation = 0;
+    }
 
-                for(j = 0; j < arraySize; j++)
-                {
-                    if (!isNumber(arrayElements[j]))
-                    {
-                        valid = 0;
-                        break;
-                    }
+    release(defaultAllocator, data);
+    return generation;
+}
 
-                    array[j] = atof(arrayElements[j]);
-                }
+// Empieza un registro del log con la operacion y la clave al final de pending, y toma el lock, que suelta endRecord.
+// Retorna 0 sin tomarlo si el store ya fallo
+int beginRecord(DictionaryStore *store, char operation, const char *key, size_t *start)
+{
+    pthread_mutex_lock(&store->lock);
+    if (store->failed)
+    {
+        pthread_mutex_unlock(&store->lock);
+        return 0;
+    }
 
-                free(arrayElements);
+    *start = store->pending.length;
+    appendBytes(&store->pending, "\0\0\0\0\0\0\0\0", RECORD_HEADER_BYTES); // Se completa en endRecord
+    appendBytes(&store->pending, &operation, 1);
+    encodeKey(&store->pending, key);
+    return 1;
+}
 
-                if (!valid)
-                    break;
+// Completa el encabezado del registro que empieza en start, se lo entrega al flusher y suelta el lock.
+// Si con el el log llega a compactAt empieza una compactacion
+void endRecord(Dictionary *dictionary, size_t start)
+{
+    DictionaryStore *store = dictionary->store;
+    unsigned int size, crc;
+    size_t length = 0;
 
-                setNumberArray(d, key, arraySize, array);
-            }
-            else if (arrayElements[0][0] == '"') // Si es un arreglo de strings
-            {
-                char *array[arraySize];
+    if (store->pending.failed || store->pending.length - start - RECORD_HEADER_BYTES > UINT_MAX)
+        store->failed = 1; // Sin memoria se pierde lo pendiente, asi que nada de lo que sigue puede ser durable
+    else
+    {
+        length = store->pending.length - start;
+        size = length - RECORD_HEADER_BYTES;
+        crc = checksum(store->pending.text + start + RECORD_HEADER_BYTES, size);
+        memcpy(store->pending.text + start, &size, 4);
+        memcpy(store->pending.text + start + 4, &crc, 4);
+        store->appended += length;
+        if (!start) // Si ya habia registros el flusher ya fue avisado
+            pthread_cond_signal(&store->changed);
+    }
+    pthread_mutex_unlock(&store->lock);
 
-                for(j = 0; j < arraySize; j++)
-                {
-                    lastChar = strlen(arrayElements[j]) - 1;
-                    if(arrayElements[j][0] != '"' || arrayElements[j][lastChar] != '"')
-                    {
-                        valid = 0;
-                        break;
-                    }
+    if (!length)
+        return;
 
-                    arrayElements[j][lastChar] = '\0';
-                    // Guarda el string sin las comillas del inicio y del final
-                    array[j] = arrayElements[j] + 1;
-                }
+    STATS_ADD(loggedChanges, 1);
+    store->logBytes += length;
+    if (store->logBytes >= store->compactAt && !startCompaction(dictionary, 0))
+        store->compactAt = store->logBytes + store->compactBytes; // Se vuelve a intentar cuando crezca otro tanto
+}
 
-                free(arrayElements);
+// Agrega al log el valor que quedo en el elemento del diccionario. La operacion es 'S' si se agrego o reemplazo, que lo
+// deja al final, o 'U' si se cambio su valor sin moverlo
+void logElement(Dictionary *dictionary, const Element *element, char operation)
+{
+    size_t start;
 
-                if (!valid)
-                    break;
+    if (beginRecord(dictionary->store, operation, element->key, &start))
+    {
+        encodeValue(&dictionary->store->pending, element->type, element->value);
+        endRecord(dictionary, start);
+    }
+}
 
-                setStringArray(d, key, arraySize, array);
-            }
-            else if (arrayElements[0][0] == 't' || arrayElements[0][0] == 'f') // Si es un arreglo booleano
+// Agrega al log que se quito la clave del diccionario
+void logRemoval(Dictionary *dictionary, const char *key)
+{
+    size_t start;
+
+    if (beginRecord(dictionary->store, 'R', key, &start))
+        endRecord(dictionary, start);
+}
+
+// Hilo que escribe los registros al log y hace fsync. Cuando llega uno espera syncMilliseconds a que lleguen mas, salvo
+// que alguien espere en syncDictionaryStore o se este cerrando, y escribe juntos todos los que hay. Si startCompaction
+// pidio un log nuevo termina el actual con los registros anteriores a rotateAt y sigue en el nuevo. Termina cuando se
+// cierra y no queda nada por escribir
+void *flushStore(void *argument)
+{
+    DictionaryStore *store = (DictionaryStore *) argument;
+    unsigned long long appended, generation = 0;
+    struct timespec deadline;
+    size_t before;
+    Buffer aux;
+    int fd, newFd = -1, written;
+
+    pthread_mutex_lock(&store->lock);
+    for (;;)
+    {
+        while (!store->closing && (store->failed || (!store->pending.length && !store->rotating)))
+            pthread_cond_wait(&store->changed, &store->lock);
+        if (store->failed || (!store->pending.length && !store->rotating))
+            break;
+
+        if (store->syncMilliseconds && !store->waiting && !store->closing)
+        {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += store->syncMilliseconds / 1000;
+            deadline.tv_nsec += store->syncMilliseconds % 1000 * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
             {
-                Bool array[arraySize];
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            while (!store->waiting && !store->closing &&
+                   pthread_cond_timedwait(&store->changed, &store->lock, &deadline) != ETIMEDOUT)
+                ;
+            if (store->failed)
+                continue;
+        }
 
-                for(j = 0; j < arraySize; j++)
-                {
-                    int isTrue =  !strcmp(arrayElements[j], "true"),
-                        isFalse = !strcmp(arrayElements[j], "false");
+        // Los registros que llegan mientras se escribe quedan para el siguiente fsync
+        aux = store->pending;
+        store->pending = store->writing;
+        store->writing = aux;
+        appended = store->appended;
+        fd = store->logFd;
+        before = store->writing.length;
+        if (store->rotating)
+        {
+            before -= appended - store->rotateAt;
+            generation = store->generation;
+        }
+        pthread_mutex_unlock(&store->lock);
+
+        // El log anterior tiene que estar en disco antes de crear el nuevo, que es el que se sigue en la recuperacion
+        written = !before || (writeAll(fd, store->writing.text, before) && !fsync(fd));
+        if (written && generation)
+            written = (newFd = createLog(store, generation)) >= 0;
+        if (written && before < store->writing.length)
+            written = writeAll(newFd >= 0 ? newFd : fd, store->writing.text + before, store->writing.length - before) &&
+                      !fsync(newFd >= 0 ? newFd : fd);
+        store->writing.length = 0;
+        STATS_ADD(logSyncs, 1);
+
+        pthread_mutex_lock(&store->lock);
+        if (newFd >= 0)
+        {
+            close(store->logFd);
+            store->logFd = newFd;
+            newFd = -1;
+        }
+        if (generation)
+        {
+            store->rotating = 0;
+            generation = 0;
+        }
+        if (written)
+            store->durable = appended;
+        else
+            store->failed = 1;
+        pthread_cond_broadcast(&store->synced);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
 
-                    if (!isTrue && !isFalse)
-                    {
-                        valid = 0;
-                        break;
-                    }
+// Le pide al flusher que empiece un log nuevo despues de los registros agregados hasta ahora, y empieza un hilo que
+// escribe el snapshot con lo anterior a ese log. Si la compactacion anterior no termino la espera con wait, y si no no
+// hace nada. Retorna 0 si no puede empezarla
+int startCompaction(Dictionary *dictionary, int wait)
+{
+    DictionaryStore *store = dictionary->store;
+    int done;
 
-                    array[j] = isTrue ? true : false;
-                }
+    if (store->compacting)
+    {
+        pthread_mutex_lock(&store->lock);
+        done = store->compacted;
+        pthread_mutex_unlock(&store->lock);
+        if (!done && !wait)
+            return 1;
+        pthread_join(store->compactor, NULL);
+        store->compacting = 0;
+    }
 
-                free(arrayElements);
+    // El hilo que cambia el diccionario no espera al disco: el flusher escribe el log y crea el siguiente
+    pthread_mutex_lock(&store->lock);
+    if (store->failed)
+    {
+        pthread_mutex_unlock(&store->lock);
+        return 0;
+    }
+    store->generation++;
+    store->rotating = 1;
+    store->rotateAt = store->appended;
+    store->compacted = 0;
+    pthread_cond_signal(&store->changed);
+    pthread_mutex_unlock(&store->lock);
+    store->logBytes = LOG_HEADER_BYTES;
+    store->compactAt = store->compactBytes;
+
+    // Sin el snapshot nuevo siguen valiendo el anterior y todos los logs
+    if (pthread_create(&store->compactor, NULL, compactStore, store))
+        return 0;
+    store->compacting = 1;
+    return 1;
+}
 
-                if (!valid)
-                    break;
+// Hilo de compactacion: espera a que los logs anteriores al de la generacion actual esten en disco, arma con ellos y
+// con el snapshot anterior el diccionario como lo recuperaria openDictionaryStore, lo escribe como snapshot y despues
+// borra los logs que ya estan en el snapshot
+void *compactStore(void *argument)
+{
+    DictionaryStore *store = (DictionaryStore *) argument;
+    unsigned long long generation = store->generation, first = 0, length, i;
+    unsigned int version = STORE_VERSION, crc;
+    char *temporary = NULL, *path = NULL;
+    Dictionary *snapshot;
+    Buffer buffer;
+    size_t valid;
+    int fd, ready, written = 0;
+
+    pthread_mutex_lock(&store->lock);
+    store->waiting++; // Que el flusher no espere syncMilliseconds
+    pthread_cond_signal(&store->changed);
+    while (!store->failed && (store->rotating || store->durable < store->rotateAt))
+        pthread_cond_wait(&store->synced, &store->lock);
+    store->waiting--;
+    ready = !store->failed;
+    pthread_mutex_unlock(&store->lock);
+
+    if (ready && (snapshot = newDictionary()) != NULL)
+    {
+        for(i = first = loadSnapshot(store, snapshot); i && i < generation && replayLog(store, snapshot, i, &valid) == 1;
+            i++)
+            ;
+        if (first && i == generation && initBuffer(&buffer, &mallocAllocator, 0))
+        {
+            appendBytes(&buffer, "DSNP", 4);
+            appendBytes(&buffer, (const char *) &version, 4);
+            appendBytes(&buffer, (const char *) &generation, 8);
+            appendBytes(&buffer, "\0\0\0\0\0\0\0\0\0\0\0\0", 12); // Largo y checksum, se completan al final
+            encodeValue(&buffer, 'd', snapshot);
 
-                setBoolArray(d, key, arraySize, array);
-            }
-            else if (arrayElements[0][0] == '{') // Si es un arreglo de diccionarios
+            if (!buffer.failed)
             {
-                Dictionary *array[arraySize];
+                length = buffer.length - SNAPSHOT_HEADER_BYTES;
+                crc = checksum(buffer.text + SNAPSHOT_HEADER_BYTES, length);
+                memcpy(buffer.text + 16, &length, 8);
+                memcpy(buffer.text + 24, &crc, 4);
 
-                for(j = 0; j < arraySize; j++)
+                // Se escribe a otro archivo y se renombra, asi siempre hay un snapshot completo
+                if ((fd = openStoreFile(store, "snapshot.tmp", 0, O_WRONLY | O_CREAT | O_TRUNC)) >= 0)
                 {
-                    if (!(array[j] = dictionaryFromJson(arrayElements[j]))) // Si no es un diccionario valido
-                    {
-                        valid = 0;
-                        break;
-                    }
+                    written = writeAll(fd, buffer.text, buffer.length) && !fsync(fd);
+                    if (close(fd) < 0)
+                        written = 0;
                 }
+                written = written && (temporary = storePath(store, "snapshot.tmp", 0)) != NULL &&
+                          (path = storePath(store, "snapshot", 0)) != NULL && !rename(temporary, path) &&
+                          syncDirectory(store->directory);
+                release(&mallocAllocator, temporary);
+                release(&mallocAllocator, path);
+            }
+            release(&mallocAllocator, buffer.text);
+        }
+        freeDictionary(snapshot);
+    }
 
-                free(arrayElements);
+    if (written)
+    {
+        for(i = first; i < generation; i++)
+            unlinkStoreFile(store, "log", i);
+        store->snapshotGeneration = generation;
+    }
 
-                if (!valid) // Si se encontr un elemento invlido, debe hacrsele free
-                {           // a todos los diccionarios anteriores creados
-                    int k;
-                    for(k = 0; k < j; k++)
-                        freeDictionary(array[k]);
+    pthread_mutex_lock(&store->lock);
+    store->compacted = 1;
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
 
-                    break;
-                }
+// Opens the dictionary kept in the given directory, creating the directory if it doesn't exist, and recovers it from its
+// last snapshot and the log of the changes made after it. From then on every change to the dictionary is appended to the
+// log as a binary record, and a background thread writes the log and syncs it to disk: the changes made while a sync is
+// in progress, or within syncMilliseconds of the first one, are synced together, and no change waits for the disk.
+// A crash loses at most the changes that were not synced yet. When the log grows past compactBytes (0 means 16 MB)
+// the background thread starts a new log after the change that makes it grow, and another thread rebuilds the
+// dictionary from the last snapshot and the previous logs and writes it as the new snapshot, so no change waits for
+// the disk or copies the dictionary. freeDictionary waits for the pending writes and closes the files.
+// The files use the byte order of the machine. Returns NULL if the directory or its files can't be read or are not
+// valid, or if there is no memory
+Dictionary *openDictionaryStore(const char *directory, int syncMilliseconds, size_t compactBytes)
+{
+    DictionaryStore *store;
+    Dictionary *d = NULL;
+    unsigned long long generation;
+    size_t valid;
+    int replayed = 0, fd = -1;
 
-                setDictionaryArray(d, key, arraySize, array);
+    if (!directory || syncMilliseconds < 0 || (mkdir(directory, 0777) < 0 && errno != EEXIST))
+        return NULL;
 
-                for(j = 0; j < arraySize; j++)
-                    freeDictionary(array[j]);
-            }
-            else
-                break;
+    if (!(store = (DictionaryStore *) allocate(&mallocAllocator, sizeof(DictionaryStore))))
+        return NULL;
+    memset(store, 0, sizeof(DictionaryStore));
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->changed, NULL);
+    pthread_cond_init(&store->synced, NULL);
+    store->logFd = -1;
+    store->syncMilliseconds = syncMilliseconds;
+    store->compactBytes = compactBytes ? compactBytes : STORE_COMPACT_BYTES;
+    store->compactAt = store->compactBytes;
+
+    if (!(store->directory = copyString(&mallocAllocator, directory)) || !initBuffer(&store->pending, &mallocAllocator, 0) ||
+        !initBuffer(&store->writing, &mallocAllocator, 0) || !(d = newDictionary()) ||
+        !(store->snapshotGeneration = loadSnapshot(store, d)))
+        replayed = -1;
+    else if (store->snapshotGeneration > 1) // Queda si la compactacion se corto antes de borrarlo
+        unlinkStoreFile(store, "log", store->snapshotGeneration - 1);
+
+    // Se aplican los logs desde el primero que no esta en el snapshot. Solo el ultimo puede terminar en un registro
+    // escrito a medias
+    for(generation = store->snapshotGeneration; !replayed && (replayed = replayLog(store, d, generation, &valid)) > 0;
+        generation++)
+    {
+        store->generation = generation;
+        store->logBytes = valid;
+        if (replayed == 1)
+            replayed = 0;
+        else if ((fd = openStoreFile(store, "log", generation + 1, O_RDONLY)) >= 0 || errno != ENOENT)
+            replayed = -1;
+    }
+    if (fd >= 0)
+        close(fd);
 
+    // Se sigue en el ultimo log, sin lo que haya despues del ultimo registro completo
+    fd = -1;
+    if (replayed >= 0)
+    {
+        if (!store->generation)
+            store->generation = store->snapshotGeneration;
+        if (store->logBytes < LOG_HEADER_BYTES)
+        {
+            fd = createLog(store, store->generation);
+            store->logBytes = LOG_HEADER_BYTES;
         }
-        else
-            break;
-
-        // Si se llega a este punto quiere decir que no hubo errores en el json y que ya se aadieron todos los elementos del diccionario
-        if (i == size - 1)
+        else if ((fd = openStoreFile(store, "log", store->generation, O_WRONLY | O_APPEND)) >= 0 &&
+                 (ftruncate(fd, store->logBytes) < 0 || fsync(fd) < 0))
         {
-            free(jsonArray);
-            return d;
+            close(fd);
+            fd = -1;
         }
     }
 
-    // Si se llega a este punto quiere decir que hubo algn error en el json
-    free(jsonArray);
-    freeDictionary(d);
-    return NULL;
+    if ((store->logFd = fd) < 0 || pthread_create(&store->flusher, NULL, flushStore, store))
+    {
+        freeDictionary(d);
+        releaseStore(store);
+        return NULL;
+    }
+
+    d->store = store; // Lo que se aplico de los logs no se vuelve a agregar
+    return d;
+}
+
+// Waits until every change made so far to a dictionary opened with openDictionaryStore is on disk.
+// Returns 1 if it was able to do it otherwise returns 0: a write failed or there was no memory to log a change,
+// and from then on the changes are only made in memory
+int syncDictionaryStore(Dictionary *dictionary)
+{
+    DictionaryStore *store;
+    unsigned long long appended;
+    int synced;
+
+    if (!dictionary || !(store = dictionary->store))
+        return 0;
+
+    pthread_mutex_lock(&store->lock);
+    appended = store->appended;
+    store->waiting++;
+    pthread_cond_signal(&store->changed); // Asi el flusher no espera a que lleguen mas registros
+    while (!store->failed && store->durable < appended)
+        pthread_cond_wait(&store->synced, &store->lock);
+    store->waiting--;
+    synced = !store->failed;
+    pthread_mutex_unlock(&store->lock);
+    return synced;
+}
+
+// Starts writing a snapshot of a dictionary opened with openDictionaryStore, like when its log grows past compactBytes,
+// waiting first for the previous one. Returns 1 if it was able to start it otherwise returns 0
+int compactDictionaryStore(Dictionary *dictionary)
+{
+    if (!dictionary || !dictionary->store)
+        return 0;
+
+    return startCompaction(dictionary, 1);
+}
+
+// Espera a la compactacion y a que se escriban los registros pendientes, y libera el store
+void closeStore(DictionaryStore *store)
+{
+    if (store->compacting)
+        pthread_join(store->compactor, NULL);
+
+    pthread_mutex_lock(&store->lock);
+    store->closing = 1;
+    pthread_cond_signal(&store->changed);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->flusher, NULL);
+    releaseStore(store);
+}
+
+// Cierra el log y libera la memoria del store
+void releaseStore(DictionaryStore *store)
+{
+    if (store->logFd >= 0)
+        close(store->logFd);
+    release(&mallocAllocator, store->pending.text);
+    release(&mallocAllocator, store->writing.text);
+    release(&mallocAllocator, store->directory);
+    pthread_mutex_destroy(&store->lock);
+    pthread_cond_destroy(&store->changed);
+    pthread_cond_destroy(&store->synced);
+    release(&mallocAllocator, store);
 }
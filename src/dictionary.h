@@ -1,3 +1,16 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stddef.h>
+
+// The header can be included from C++, see dictionary.hpp for a C++ interface
+#ifdef __cplusplus
+#define DICTIONARY_SIZE(size)  // C++ doesn't allow the size of an array parameter to be another parameter
+extern "C" {
+#else
+#define DICTIONARY_SIZE(size) size
+#endif
+
 typedef struct element
 {
     char key[80];
@@ -6,16 +19,138 @@ typedef struct element
     struct element *next;
 } Element;
 
+// Functions used by a dictionary to manage its memory, context is passed to each of them.
+// They may be called from several threads at the same time by the json lines functions
+typedef struct dictionaryAllocator
+{
+    void *(*allocate)(size_t size, void *context);
+    void *(*reallocate)(void *pointer, size_t size, void *context);
+    void (*release)(void *pointer, void *context);
+    void *context;
+} DictionaryAllocator;
+
 typedef struct dictionary
 {
     Element *first;
+    const DictionaryAllocator *allocator;
+    struct indexNode *orderedIndex;  // Keys sorted in a B-tree, NULL unless createOrderedIndex was called
+    struct prefixNode *prefixIndex;  // Keys in a radix tree, NULL unless createPrefixIndex was called
+    struct shape *shape;             // Sequence of keys shared with other dictionaries, NULL unless it has a shape
+    Element **slots;                 // Elements in the order of the shape
+    int slotCapacity;
+    unsigned long long hash;         // See hashDictionary
+    int references;                  // Dictionaries that share it, 0 unless it was shared by setInterning
+    struct dictionary *nextInterned;
+    int cacheJson;                   // Set by setJsonCache
+    char *json;                      // Last json of the dictionary, kept while it doesn't change if json is cached
+    size_t jsonLength;
+    struct dictionaryStore *store;   // Files that keep the dictionary, NULL unless it was opened with openDictionaryStore
 } Dictionary;
 
+#ifdef __cplusplus
+typedef enum {boolTrue, boolFalse} Bool;  // true and false are keywords in C++, the values are the same as in C
+#else
 typedef enum {true, false} Bool;
+#endif
+
+// Element of a dictionary as returned by getEntry and the iteration functions. Nothing is copied, so key and value
+// belong to the dictionary and are valid until the element is overridden or removed
+typedef struct
+{
+    const char *key;
+    char type;          // 'n' number, 'b' boolean, 's' string, 'd' dictionary, 'a' array or 'z' null
+    const void *value;  // double *, Bool *, char * or Dictionary * depending on type. For arrays, their elements:
+                        // double *, char ** or Dictionary ** by arrayType, and for booleans unsigned long long *
+                        // with element i in bit i % 64 of word i / 64
+    char arrayType;     // Type of the elements of an array
+    int size;           // Number of elements of an array
+    const void *array;  // Internal, the array read by getEntryRow
+} DictionaryEntry;
+
+// Position of an iteration over a dictionary, its fields are internal. The dictionary must not be changed while
+// it is being iterated
+typedef struct
+{
+    const Element *element;             // Next element in insertion order
+    const struct indexNode *nodes[16];  // Path to the next element in key order
+    int positions[16];
+    int depth;
+    int ordered;
+    int bounded;
+    char end[80];                       // When bounded, keys greater or equal to this one are not visited
+} DictionaryCursor;
+
+// Key to find in dictionaries that share a shape, see initAccessor. Its fields are internal
+typedef struct
+{
+    char key[80];
+    unsigned long long shapeId;  // Shape of the last dictionary the accessor was used with, 0 if none
+    int slot;                    // Slot of key in that shape, -1 if it doesn't have the key
+} DictionaryAccessor;
+
+// Counters of the whole library. Byte and element counts are what is currently held, the rest are cumulative
+typedef struct
+{
+    long long mallocs;               // Memory allocation calls
+    long long reallocs;
+    long long frees;
+    long long pooledBlocks;          // Elements, arrays and scalars taken from the block pool instead of malloc
+    long long elements;              // Elements held by all the dictionaries
+    long long keyBytes;              // Bytes held by keys
+    long long scalarBytes;           // Bytes held by numbers and booleans
+    long long stringBytes;           // Bytes held by strings, including the ones inside arrays
+    long long arrayBytes;            // Bytes held by arrays, without the strings they contain
+    long long lookups;               // Keys searched by the get functions
+    long long lookupComparisons;     // Keys compared by those searches, divided by lookups it is the average chain length
+    long long maxLookupComparisons;  // Most keys compared by a single search
+    long long dictionaryCopies;      // Calls to copy a dictionary, counting nested ones
+    long long sharedDictionaries;    // Nested dictionaries shared instead of copied, see setInterning
+    long long stringCopies;
+    long long parses;                // Calls to dictionaryFromJson
+    long long parsedBytes;
+    long long parseNanoseconds;
+    long long serializations;        // Calls to jsonFromDictionary
+    long long serializedBytes;
+    long long serializeNanoseconds;
+    long long loggedChanges;         // Changes appended to the log of a dictionary opened with openDictionaryStore
+    long long logSyncs;              // Writes of those logs to disk, each one with all the changes logged meanwhile
+} DictionaryStats;
+
+// Memory held by a dictionary, including its nested dictionaries. Shared dictionaries are counted every time they appear
+typedef struct
+{
+    long long dictionaries;
+    long long elements;
+    long long keyBytes;
+    long long scalarBytes;
+    long long stringBytes;
+    long long arrayBytes;
+    long long indexBytes;   // Bytes held by ordered and prefix indexes and by shape slots
+    long long jsonBytes;    // Bytes held by cached json
+    long long allocations;  // Memory blocks held
+} DictionaryUsage;
+
+// Memory returned by the library (strings, arrays, dictionaries and json) is allocated with the allocator of the dictionary
+// it comes from, by default malloc, so it must be released with freeDictionaryMemory or with the matching function.
+// Every function that needs memory returns 0 or NULL if it can't get it, leaving the dictionary unchanged.
+// With the default allocator, elements, arrays and scalars come from a block pool with a cache per thread: freed blocks
+// are kept for reuse instead of returned to the system, and a thread's free blocks go back to the pool when it ends.
+// The pool can be disabled compiling the library with DICTIONARY_NO_POOL
 
-// Creates a new empty dictionary
+// Sets the allocator used by new dictionaries, NULL restores malloc, realloc and free.
+// The allocator must remain valid while any dictionary created with it exists
+void setDefaultAllocator(const DictionaryAllocator *allocator);
+
+// Creates a new empty dictionary. Returns NULL if there is no memory
 Dictionary *newDictionary();
 
+// Creates a new empty dictionary that uses the given allocator, NULL means the default one.
+// Returns NULL if there is no memory
+Dictionary *newDictionaryWithAllocator(const DictionaryAllocator *allocator);
+
+// Releases memory returned by the library for the given dictionary, like its strings, arrays or json
+void freeDictionaryMemory(const Dictionary *dictionary, void *pointer);
+
 // Saves the number associated to the corresponding key in result.
 // Returns 1 if it was able to get it otherwise returns 0
 int getNumber(const Dictionary *dictionary, const char *key, double *result);
@@ -33,15 +168,141 @@ Dictionary *getDictionary(const Dictionary *dictionary, const char *key);
 // Returns the numeric array associated to the corresponding key, otherwise returns NULL
 double *getNumberArray(const Dictionary *dictionary, const char *key, int *sizeResult);
 
+// Saves the sum of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int sumNumberArray(const Dictionary *dictionary, const char *key, double *result);
+
+// Saves the smallest element of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int minNumberArray(const Dictionary *dictionary, const char *key, double *result);
+
+// Saves the largest element of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int maxNumberArray(const Dictionary *dictionary, const char *key, double *result);
+
+// Saves the mean of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int meanNumberArray(const Dictionary *dictionary, const char *key, double *result);
+
+// Saves the population variance of the numeric array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int varianceNumberArray(const Dictionary *dictionary, const char *key, double *result);
+
+// Saves the dot product of the numeric array associated to key and the numeric array associated to otherKey in other
+// in result. Both arrays must have the same size.
+// Returns 1 if it was able to get it otherwise returns 0
+int dotNumberArrays(const Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey, double *result);
+
+// Saves how many elements of the numeric array associated to the corresponding key are greater than threshold in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int countNumberArrayAbove(const Dictionary *dictionary, const char *key, double threshold, int *result);
+
 // Returns the boolean array associated to the corresponding key, otherwise returns NULL
 Bool *getBoolArray(const Dictionary *dictionary, const char *key, int *sizeResult);
 
+// Saves the element at the given index of the boolean array associated to the corresponding key in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int getBoolArrayElement(const Dictionary *dictionary, const char *key, int index, Bool *result);
+
+// Saves how many elements of the boolean array associated to the corresponding key are true in result.
+// Returns 1 if it was able to get it otherwise returns 0
+int countBoolArray(const Dictionary *dictionary, const char *key, int *result);
+
 // Returns the array of strings associated to the corresponding key, otherwise returns NULL
 char **getStringArray(const Dictionary *dictionary, const char *key, int *sizeResult);
 
 // Returns the array of dictionaries associated to the corresponding key, otherwise returns NULL
 Dictionary **getDictionaryArray(const Dictionary *dictionary, const char *key, int *sizeResult);
 
+// Returns the numbers saved with the key column in each dictionary of the array associated to the corresponding key,
+// otherwise returns NULL
+double *getNumberColumn(const Dictionary *dictionary, const char *key, const char *column, int *sizeResult);
+
+// Saves the element with the given key in result without copying its value.
+// For boolean arrays value points to the bits of the array, element i is bit i % 64 of the unsigned long long i / 64.
+// For arrays of dictionaries with the same keys, which are saved by columns, value is NULL; getEntryRow reads their rows.
+// Returns 1 if it was able to get it otherwise returns 0
+int getEntry(const Dictionary *dictionary, const char *key, DictionaryEntry *result);
+
+// Saves in result the element with the key column of the dictionary number row of the array of dictionaries in entry,
+// without copying its value, also when the array is saved by columns. entry must come from getEntry or an iteration and
+// result is valid while entry is. Returns 1 if it was able to get it otherwise returns 0
+int getEntryRow(const DictionaryEntry *entry, int row, const char *column, DictionaryEntry *result);
+
+// Starts an iteration over the elements of the dictionary in the order they were set
+void startIteration(const Dictionary *dictionary, DictionaryCursor *cursor);
+
+// Starts an iteration in key order over the elements whose keys are greater or equal to from and less than to.
+// NULL from starts from the smallest key and NULL to goes up to the greatest one.
+// Returns 1 if it was able to do it otherwise returns 0, which happens if the dictionary has no ordered index
+int startOrderedIteration(const Dictionary *dictionary, DictionaryCursor *cursor, const char *from, const char *to);
+
+// Saves the next element of the iteration in result, like getEntry, so the rows of an array of dictionaries saved by
+// columns are read with getEntryRow. Returns 1 if it was able to get it otherwise returns 0, which happens at the end of the iteration
+int nextEntry(DictionaryCursor *cursor, DictionaryEntry *result);
+
+// Calls callback with each element of the dictionary in the order they were set, until it returns 0. The entries are
+// like the ones of getEntry, so the rows of an array of dictionaries saved by columns are read with getEntryRow.
+// Returns 1 if every element was visited otherwise returns 0
+int forEachEntry(const Dictionary *dictionary, int (*callback)(const DictionaryEntry *entry, void *data), void *data);
+
+// Calls callback in key order with each element whose key is greater or equal to from and less than to, until it
+// returns 0. NULL from starts from the smallest key and NULL to goes up to the greatest one.
+// Returns 1 if every element was visited otherwise returns 0, which also happens if the dictionary has no ordered index
+int forEachEntryInRange(const Dictionary *dictionary, const char *from, const char *to,
+                        int (*callback)(const DictionaryEntry *entry, void *data), void *data);
+
+// Saves in result the element with the smallest key greater or equal to key.
+// Returns 1 if it was able to get it otherwise returns 0, which also happens if the dictionary has no ordered index
+int lowerBoundEntry(const Dictionary *dictionary, const char *key, DictionaryEntry *result);
+
+// Keeps the keys of the dictionary sorted in a B-tree, used from then on to find keys and to iterate in key order.
+// Copies of the dictionary don't have the index. Returns 1 if it was able to do it otherwise returns 0
+int createOrderedIndex(Dictionary *dictionary);
+
+// Releases the ordered index of the dictionary, if it has one
+void dropOrderedIndex(Dictionary *dictionary);
+
+// Keeps the keys of the dictionary in a radix tree, used from then on to find keys and elements by prefix.
+// Copies of the dictionary don't have the index. Returns 1 if it was able to do it otherwise returns 0
+int createPrefixIndex(Dictionary *dictionary);
+
+// Releases the prefix index of the dictionary, if it has one
+void dropPrefixIndex(Dictionary *dictionary);
+
+// Calls callback in key order with each element whose key starts with prefix, until it returns 0, like forEachEntry.
+// Returns 1 if every element was visited otherwise returns 0, which also happens if the dictionary has no prefix index
+int forEachEntryWithPrefix(const Dictionary *dictionary, const char *prefix,
+                           int (*callback)(const DictionaryEntry *entry, void *data), void *data);
+
+// Saves in result how many keys start with prefix.
+// Returns 1 if it was able to get it otherwise returns 0, which happens if the dictionary has no prefix index
+int countEntriesWithPrefix(const Dictionary *dictionary, const char *prefix, int *result);
+
+// Gives the dictionary the shape of its keys, shared with every dictionary that has the same keys in the same order,
+// so accessors find them without searching. Setting a new key extends the shape and any other change recomputes it.
+// dictionaryFromJson and getDictionaryArray return dictionaries with shape, and copies keep it.
+// Returns 1 if it was able to do it otherwise returns 0
+int shapeDictionary(Dictionary *dictionary);
+
+// Prepares accessor to find key. The accessor remembers the slot of key in the shape of the last dictionary it was
+// used with, so using it with dictionaries of that shape doesn't search the key. An accessor must not be used by
+// several threads at the same time. Returns 1 if it was able to do it otherwise returns 0, which happens if the key is
+// too long to be in a dictionary
+int initAccessor(DictionaryAccessor *accessor, const char *key);
+
+// Like getEntry, finding the key with the accessor
+int getEntryAt(const Dictionary *dictionary, DictionaryAccessor *accessor, DictionaryEntry *result);
+
+// Like getNumber, finding the key with the accessor
+int getNumberAt(const Dictionary *dictionary, DictionaryAccessor *accessor, double *result);
+
+// Like getBool, finding the key with the accessor
+int getBoolAt(const Dictionary *dictionary, DictionaryAccessor *accessor, Bool *result);
+
+// Like getString, finding the key with the accessor
+char *getStringAt(const Dictionary *dictionary, DictionaryAccessor *accessor);
+
 // Removes the given key. Returns 1 if it was able to do it otherwise returns 0
 int removeElement(Dictionary *dictionary, const char *key);
 
@@ -57,31 +318,192 @@ int setBool(Dictionary *dictionary, const char *key, Bool value);
 // Returns 1 if it was able to do it otherwise returns 0
 int setString(Dictionary *dictionary, const char *key, const char *value);
 
+// Sets the first length characters of value as the string for the given key, like setString. value doesn't need to end
+// in '\0' but must not contain it. Returns 1 if it was able to do it otherwise returns 0
+int setStringWithLength(Dictionary *dictionary, const char *key, const char *value, size_t length);
+
 // Sets a dictionary for the given key, if the key does not exists it creates it else it overrides the previous value.
 // Returns 1 if it was able to do it otherwise returns 0
 int setDictionary(Dictionary *dictionary, const char *key, Dictionary *value);
 
+// Sets a dictionary for the given key like setDictionary, but takes value instead of copying it: from then on value
+// belongs to dictionary and must not be used or freed. It is still copied, and then freed, if it uses another allocator,
+// if it is shared, if setInterning is enabled or if it was opened with openDictionaryStore. value can't be dictionary itself.
+// Returns 1 if it was able to do it otherwise returns 0, and value is freed anyway unless it was dictionary
+int moveDictionary(Dictionary *dictionary, const char *key, Dictionary *value);
+
 // Sets a numeric array for the given key, if the key does not exists it creates it else it overrides the previous value.
 // Returns 1 if it was able to do it otherwise returns 0
-int setNumberArray(Dictionary *dictionary, const char *key, int size, double value[size]);
+int setNumberArray(Dictionary *dictionary, const char *key, int size, double value[DICTIONARY_SIZE(size)]);
+
+// Multiplies each element of the numeric array associated to the corresponding key by factor.
+// Returns 1 if it was able to do it otherwise returns 0
+int scaleNumberArray(Dictionary *dictionary, const char *key, double factor);
+
+// Adds addend to each element of the numeric array associated to the corresponding key.
+// Returns 1 if it was able to do it otherwise returns 0
+int addNumberArray(Dictionary *dictionary, const char *key, double addend);
 
 // Sets a boolean array for the given key, if the key does not exists it creates it else it overrides the previous value.
 // Returns 1 if it was able to do it otherwise returns 0
-int setBoolArray(Dictionary *dictionary, const char *key, int size, Bool value[size]);
+int setBoolArray(Dictionary *dictionary, const char *key, int size, Bool value[DICTIONARY_SIZE(size)]);
+
+// Replaces each element of the boolean array associated to key with its logical and with the same element of the boolean
+// array associated to otherKey in other. Both arrays must have the same size.
+// Returns 1 if it was able to do it otherwise returns 0
+int andBoolArray(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey);
+
+// Replaces each element of the boolean array associated to key with its logical or with the same element of the boolean
+// array associated to otherKey in other. Both arrays must have the same size.
+// Returns 1 if it was able to do it otherwise returns 0
+int orBoolArray(Dictionary *dictionary, const char *key, const Dictionary *other, const char *otherKey);
 
 // Sets an array of strings for the given key, if the key does not exists it creates it else it overrides the previous value.
 // Returns 1 if it was able to do it otherwise returns 0
-int setStringArray(Dictionary *dictionary, const char *key, int size, char *value[size]);
+int setStringArray(Dictionary *dictionary, const char *key, int size, char *value[DICTIONARY_SIZE(size)]);
 
 // Sets an array of dictionaries for the given key, if the key does not exists it creates it else it overrides the previous value.
 // Returns 1 if it was able to do it otherwise returns 0
-int setDictionaryArray(Dictionary *dictionary, const char *key, int size, Dictionary *value[size]);
+int setDictionaryArray(Dictionary *dictionary, const char *key, int size, Dictionary *value[DICTIONARY_SIZE(size)]);
+
+// Sets a null for the given key, if the key does not exists it creates it else it overrides the previous value.
+// Returns 1 if it was able to do it otherwise returns 0
+int setNull(Dictionary *dictionary, const char *key);
 
 // Returns a new dictionary created from its json representation. If it can't parse the json returns NULL
 Dictionary *dictionaryFromJson(const char *json);
 
+// Like dictionaryFromJson, but the new dictionary uses the given allocator, NULL means the default one
+Dictionary *dictionaryFromJsonWithAllocator(const char *json, const DictionaryAllocator *allocator);
+
+// Keys to keep when parsing json, see newProjection. Its fields are internal
+typedef struct projectionNode DictionaryProjection;
+
+// Returns a projection that selects the given paths, made of keys separated by '/' like "order/price". A path selects
+// the whole value of its last key, and the dictionaries on the way keep only the selected keys. Returns NULL if a path
+// has an empty key or one longer than 79 characters, or if there is no memory
+DictionaryProjection *newProjection(int size, const char *paths[DICTIONARY_SIZE(size)]);
+
+// Releases the memory of the given projection
+void freeProjection(DictionaryProjection *projection);
+
+// Like dictionaryFromJsonWithAllocator, but the dictionary only has the keys selected by the projection. When a
+// dictionary on the way to a selected key is in an array of dictionaries, each of them keeps the selected keys, and
+// when it is neither it is left out. The values of the other keys are skipped matching only their quotes and
+// brackets, without creating them, so json that is invalid only inside those values is accepted
+Dictionary *dictionaryFromJsonWithProjection(const char *json, const DictionaryProjection *projection,
+                                             const DictionaryAllocator *allocator);
+
+// Returns 1 if dictionaryFromJson would accept the json, checking it without creating the dictionary, otherwise
+// returns 0
+int validateJson(const char *json);
+
 // Returns the json representation string for the given dictionary. If it can't do it returns NULL
 char *jsonFromDictionary(const Dictionary *dictionary);
 
+// Makes jsonFromDictionary keep the json of the dictionary and of each nested dictionary, and reuse it for the ones
+// that didn't change since then. The dictionary must then not be serialized from several threads at once.
+// Disabling it releases the kept json
+void setJsonCache(Dictionary *dictionary, int enabled);
+
+// Limits the json accepted by dictionaryFromJson and the json lines functions: at most maxDepth nested dictionaries and
+// arrays, counting the outer dictionary, and at most maxLength characters per dictionary. Json past a limit is rejected
+// like invalid json. 0 means no limit, the default for both. Parsing, copying, serializing and freeing don't use more
+// stack for deeper dictionaries, so the limits are only needed to bound the time and memory given to untrusted json.
+// A dictionary of INT_MAX characters or more is always rejected
+void setJsonLimits(int maxDepth, size_t maxLength);
+
 // Releases the memory of the given dictionary
 void freeDictionary(Dictionary *dictionary);
+
+// Returns 1 if both dictionaries have the same keys with the same values, in any order, otherwise returns 0.
+// Dictionaries with different hashes are told apart without comparing their values
+int equalDictionaries(const Dictionary *dictionary, const Dictionary *other);
+
+// Returns a hash of the keys and values of the dictionary. Equal dictionaries, as told by equalDictionaries, have
+// the same hash whatever the order of their keys. The hash is kept up to date as the dictionary changes, so this
+// doesn't go through the dictionary. Returns 0 for NULL
+unsigned long long hashDictionary(const Dictionary *dictionary);
+
+// When enabled, a dictionary stored inside another one (by setDictionary, setDictionaryArray, dictionaryFromJson,
+// applyMergePatch or a copy) is shared with an identical one stored before with the same allocator instead of copied,
+// together with its strings and nested values. Shared dictionaries don't change: applyMergePatch replaces one with
+// a copy before changing it, and their json is not cached. Dictionaries stored while it was enabled remain shared
+// after disabling it. Disabled by default
+void setInterning(int enabled);
+
+// Returns a JSON Merge Patch (RFC 7396) that turns from into to: the keys that changed with their new value,
+// the removed keys with null, and the dictionaries that changed with a patch of their own.
+// Like in RFC 7396, null values in to can't be told apart from removed keys.
+// Returns NULL if there is no memory
+Dictionary *diffDictionaries(const Dictionary *from, const Dictionary *to);
+
+// Applies a JSON Merge Patch (RFC 7396) to the dictionary in place, keeping the values the patch doesn't change.
+// Returns 1 if it was able to do it otherwise returns 0, in that case the patch may have been applied partially
+int applyMergePatch(Dictionary *dictionary, const Dictionary *patch);
+
+// Returns an array with the dictionaries parsed from each line of the given json lines text of length len, using the given
+// number of threads (0 means one per processor). Blank lines are skipped and lines that can't be parsed are NULL in the array.
+// Saves the number of lines in sizeResult. Returns NULL if it can't do it
+Dictionary **dictionariesFromJsonLines(const char *jsonLines, size_t len, int threads, int *sizeResult);
+
+// Returns an array with the dictionaries parsed from each line read from the given file descriptor until its end.
+// Works like dictionariesFromJsonLines
+Dictionary **dictionariesFromJsonLinesFd(int fd, int threads, int *sizeResult);
+
+// Returns an array with the dictionaries parsed from each line of the file in the given path.
+// Works like dictionariesFromJsonLines
+Dictionary **dictionariesFromJsonLinesFile(const char *path, int threads, int *sizeResult);
+
+// Parses each line of the given json lines text of length len using the given number of threads (0 means one per processor)
+// and calls callback in order with the line number (starting at 1), the parsed dictionary or NULL if the line can't be parsed,
+// and data. The callback owns the dictionary. Blank lines are skipped.
+// Returns the number of lines that couldn't be parsed, or -1 if it can't do it
+int forEachJsonLine(const char *jsonLines, size_t len, int threads,
+                    void (*callback)(int line, Dictionary *dictionary, void *data), void *data);
+
+// Returns the json lines representation of the given dictionaries, one line per dictionary, serialized using the given
+// number of threads (0 means one per processor). NULL dictionaries are skipped. If it can't do it returns NULL
+char *jsonLinesFromDictionaries(int size, Dictionary *dictionaries[DICTIONARY_SIZE(size)], int threads);
+
+// Writes the json lines representation of the given dictionaries to the given file descriptor, like jsonLinesFromDictionaries.
+// Returns 1 if it was able to do it otherwise returns 0
+int writeJsonLines(int fd, int size, Dictionary *dictionaries[DICTIONARY_SIZE(size)], int threads);
+
+// Writes the json lines representation of the given dictionaries to the file in the given path, replacing its content.
+// Returns 1 if it was able to do it otherwise returns 0
+int writeJsonLinesFile(const char *path, int size, Dictionary *dictionaries[DICTIONARY_SIZE(size)], int threads);
+
+// Opens the dictionary kept in the given directory, creating the directory if it doesn't exist, and recovers it from its
+// last snapshot and the log of the changes made after it. From then on every change to the dictionary is appended to the
+// log as a binary record, and a background thread writes the log and syncs it to disk: the changes made while a sync is
+// in progress, or within syncMilliseconds of the first one, are synced together, and no change waits for the disk.
+// A crash loses at most the changes that were not synced yet. When the log grows past compactBytes (0 means 16 MB)
+// the background thread starts a new log after the change that makes it grow, and another thread rebuilds the
+// dictionary from the last snapshot and the previous logs and writes it as the new snapshot, so no change waits for
+// the disk or copies the dictionary. freeDictionary waits for the pending writes and closes the files.
+// The files use the byte order of the machine. Returns NULL if the directory or its files can't be read or are not
+// valid, or if there is no memory
+Dictionary *openDictionaryStore(const char *directory, int syncMilliseconds, size_t compactBytes);
+
+// Waits until every change made so far to a dictionary opened with openDictionaryStore is on disk.
+// Returns 1 if it was able to do it otherwise returns 0: a write failed or there was no memory to log a change,
+// and from then on the changes are only made in memory
+int syncDictionaryStore(Dictionary *dictionary);
+
+// Starts writing a snapshot of a dictionary opened with openDictionaryStore, like when its log grows past compactBytes,
+// waiting first for the previous one. Returns 1 if it was able to start it otherwise returns 0
+int compactDictionaryStore(Dictionary *dictionary);
+
+// Saves in result the counters of the whole library, added up over all the threads.
+// They are not updated if the library was compiled with DICTIONARY_NO_STATS
+void getDictionaryStats(DictionaryStats *result);
+
+// Saves in result the memory held by the given dictionary, including its nested dictionaries
+void getDictionaryUsage(const Dictionary *dictionary, DictionaryUsage *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
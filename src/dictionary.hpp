@@ -0,0 +1,996 @@
+// C++17 interface to the dictionary library, in namespace dict. dict::Dictionary owns a dictionary and frees it when
+// destroyed, keys are taken as std::string_view, and values are read in place instead of through the copies returned
+// by the C functions. Like the C functions, methods report failures returning false, std::nullopt or an empty
+// Dictionary. Only the constructors that create a dictionary and the standard containers that are returned throw
+// std::bad_alloc. Structs with a Binding are read from and written to json directly, see readJson
+#ifndef DICTIONARY_HPP
+#define DICTIONARY_HPP
+
+#include <array>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dictionary.h"
+
+namespace dict
+{
+
+class Dictionary;
+
+// Contiguous elements read in place, like std::span. Valid while the array it comes from doesn't change
+template<class T>
+class ArrayView
+{
+public:
+    ArrayView() = default;
+    ArrayView(const T *elements, std::size_t length) : elements(elements), length(length) {}
+
+    // Any container with data() and size(), like std::vector or std::array
+    template<class Container, class = std::enable_if_t<std::is_convertible_v<
+                 decltype(std::data(std::declval<const Container &>())), const T *>>>
+    ArrayView(const Container &container) : elements(std::data(container)), length(std::size(container)) {}
+
+    const T *data() const { return elements; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const T *begin() const { return elements; }
+    const T *end() const { return elements + length; }
+    const T &operator[](std::size_t i) const { return elements[i]; }
+
+private:
+    const T *elements = nullptr;
+    std::size_t length = 0;
+};
+
+// Elements of a boolean array read in place from its bits
+class BoolArrayView
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = bool;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = bool;
+
+        iterator(const BoolArrayView *array, std::size_t i) : array(array), i(i) {}
+        bool operator*() const { return (*array)[i]; }
+        iterator &operator++() { i++; return *this; }
+        iterator operator++(int) { iterator old = *this; i++; return old; }
+        bool operator==(const iterator &other) const { return i == other.i; }
+        bool operator!=(const iterator &other) const { return i != other.i; }
+
+    private:
+        const BoolArrayView *array;
+        std::size_t i;
+    };
+
+    BoolArrayView() = default;
+    BoolArrayView(const unsigned long long *bits, std::size_t length) : bits(bits), length(length) {}
+
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, length); }
+    bool operator[](std::size_t i) const { return bits[i / 64] >> (i % 64) & 1; }
+
+private:
+    const unsigned long long *bits = nullptr;
+    std::size_t length = 0;
+};
+
+namespace detail
+{
+
+// Copia una clave a un buffer del stack terminado en '\0', que es lo que piden las funciones de C. Si no cabe en un
+// elemento o contiene '\0' no es valida, y ningun elemento la puede tener
+class Key
+{
+public:
+    explicit Key(std::string_view key) : valid(key.size() < sizeof(Element::key) && key.find('\0') == key.npos)
+    {
+        if (valid)
+        {
+            std::memcpy(text, key.data(), key.size());
+            text[key.size()] = '\0';
+        }
+    }
+
+    explicit operator bool() const { return valid; }
+    const char *c_str() const { return text; }
+
+private:
+    char text[sizeof(Element::key)];
+    bool valid;
+};
+
+template<class T>
+struct Unsupported : std::false_type {};
+
+template<class T>
+std::optional<T> read(const DictionaryEntry &entry);
+
+}
+
+// Element of a dictionary, valid while the element isn't overridden or removed
+class Entry
+{
+public:
+    explicit Entry(const DictionaryEntry &entry) : entry(entry) {}
+
+    std::string_view key() const { return entry.key; }
+    char type() const { return entry.type; }
+    char arrayType() const { return entry.arrayType; }
+    int size() const { return entry.size; }
+
+    // Value if it has type T, like View::get except for arrays of dictionaries
+    template<class T>
+    std::optional<T> as() const { return detail::read<T>(entry); }
+
+    const DictionaryEntry &raw() const { return entry; }
+
+private:
+    DictionaryEntry entry;
+};
+
+// Iteration over the elements of a dictionary in the order they were set
+class EntryIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Entry *;
+    using reference = const Entry &;
+
+    EntryIterator() = default;
+    explicit EntryIterator(const ::Dictionary *dictionary)
+    {
+        startIteration(dictionary, &cursor);
+        ++*this;
+    }
+
+    const Entry &operator*() const { return *current; }
+    const Entry *operator->() const { return &*current; }
+    EntryIterator &operator++()
+    {
+        DictionaryEntry entry;
+        if (nextEntry(&cursor, &entry))
+            current.emplace(entry);
+        else
+            current.reset();
+        return *this;
+    }
+
+    // Only the end of the iteration is compared
+    bool operator==(const EntryIterator &other) const { return current.has_value() == other.current.has_value(); }
+    bool operator!=(const EntryIterator &other) const { return !(*this == other); }
+
+private:
+    DictionaryCursor cursor;
+    std::optional<Entry> current;
+};
+
+// Dictionary read in place, like a nested one. Valid while the dictionary it comes from exists and doesn't change
+class View
+{
+public:
+    using iterator = EntryIterator;
+
+    View() = default;
+    explicit View(const ::Dictionary *dictionary) : dictionary(dictionary) {}
+
+    const ::Dictionary *handle() const { return dictionary; }
+    explicit operator bool() const { return dictionary != nullptr; }
+
+    // Value of the key if it has type T: double, bool, std::string_view, View, ArrayView<double>, BoolArrayView,
+    // ArrayView<const char *> or std::vector<Dictionary>. Everything is read in place except the arrays of
+    // dictionaries, which are copied because the ones with the same keys are saved by columns
+    template<class T>
+    std::optional<T> get(std::string_view key) const;
+
+    std::optional<Entry> entry(std::string_view key) const;
+    bool contains(std::string_view key) const { return entry(key).has_value(); }
+
+    // Iterates over the elements in the order they were set
+    iterator begin() const;
+    iterator end() const;
+
+    // Json of the dictionary, empty if there is no memory
+    std::string toJson() const;
+
+    unsigned long long hash() const { return hashDictionary(dictionary); }
+    bool operator==(View other) const { return equalDictionaries(dictionary, other.dictionary); }
+    bool operator!=(View other) const { return !(*this == other); }
+
+protected:
+    const ::Dictionary *dictionary = nullptr;
+};
+
+// Dictionary that is freed when destroyed. It can be moved but not copied, and after being moved it is empty
+class Dictionary : public View
+{
+public:
+    Dictionary() : View(newDictionary())
+    {
+        if (!dictionary)
+            throw std::bad_alloc();
+    }
+
+    explicit Dictionary(const DictionaryAllocator *allocator) : View(newDictionaryWithAllocator(allocator))
+    {
+        if (!dictionary)
+            throw std::bad_alloc();
+    }
+
+    // Takes a dictionary returned by the C functions, which may be NULL
+    static Dictionary adopt(::Dictionary *owned)
+    {
+        Dictionary result(nullptr);
+        result.dictionary = owned;
+        return result;
+    }
+
+    // Parses json, the result is empty if it is not valid or there is no memory
+    static Dictionary fromJson(const char *json) { return adopt(dictionaryFromJson(json)); }
+    static Dictionary fromJson(const std::string &json) { return fromJson(json.c_str()); }
+
+    Dictionary(const Dictionary &) = delete;
+    Dictionary &operator=(const Dictionary &) = delete;
+    Dictionary(Dictionary &&other) noexcept : View(other.dictionary) { other.dictionary = nullptr; }
+    Dictionary &operator=(Dictionary &&other) noexcept
+    {
+        if (this != &other)
+        {
+            freeDictionary(handle());
+            dictionary = other.dictionary;
+            other.dictionary = nullptr;
+        }
+        return *this;
+    }
+    ~Dictionary() { freeDictionary(handle()); }
+
+    ::Dictionary *handle() const { return const_cast<::Dictionary *>(dictionary); }
+
+    // Stops owning the dictionary and returns it
+    ::Dictionary *release()
+    {
+        ::Dictionary *owned = handle();
+        dictionary = nullptr;
+        return owned;
+    }
+
+    // Setters, like the C ones return true if they were able to set the value. Numbers, strings and arrays are copied,
+    // a View is copied like setDictionary and a Dictionary passed with std::move is taken like moveDictionary
+    bool set(std::string_view key, double value)
+    {
+        detail::Key k(key);
+        return k && setNumber(handle(), k.c_str(), value);
+    }
+
+    template<class T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    bool set(std::string_view key, T value) { return set(key, static_cast<double>(value)); }
+
+    bool set(std::string_view key, bool value)
+    {
+        detail::Key k(key);
+        return k && setBool(handle(), k.c_str(), value ? boolTrue : boolFalse);
+    }
+
+    bool set(std::string_view key, std::string_view value)
+    {
+        detail::Key k(key);
+        return k && setStringWithLength(handle(), k.c_str(), value.data(), value.size());
+    }
+
+    bool set(std::string_view key, const char *value) { return set(key, std::string_view(value)); }
+    bool set(std::string_view key, const std::string &value) { return set(key, std::string_view(value)); }
+
+    bool set(std::string_view key, std::nullptr_t)
+    {
+        detail::Key k(key);
+        return k && setNull(handle(), k.c_str());
+    }
+
+    bool set(std::string_view key, View value)
+    {
+        detail::Key k(key);
+        return k && value && setDictionary(handle(), k.c_str(), const_cast<::Dictionary *>(value.handle()));
+    }
+
+    bool set(std::string_view key, Dictionary &&value)
+    {
+        detail::Key k(key);
+        return k && value && moveDictionary(handle(), k.c_str(), value.release());
+    }
+
+    bool set(std::string_view key, ArrayView<double> value)
+    {
+        detail::Key k(key);
+        return k && value.size() <= INT_MAX &&
+               setNumberArray(handle(), k.c_str(), (int) value.size(), const_cast<double *>(value.data()));
+    }
+
+    bool set(std::string_view key, ArrayView<Bool> value)
+    {
+        detail::Key k(key);
+        return k && value.size() <= INT_MAX &&
+               setBoolArray(handle(), k.c_str(), (int) value.size(), const_cast<Bool *>(value.data()));
+    }
+
+    bool set(std::string_view key, ArrayView<const char *> value)
+    {
+        detail::Key k(key);
+        return k && value.size() <= INT_MAX &&
+               setStringArray(handle(), k.c_str(), (int) value.size(), const_cast<char **>(value.data()));
+    }
+
+    bool set(std::string_view key, ArrayView<View> value)
+    {
+        detail::Key k(key);
+        std::vector<::Dictionary *> dictionaries;
+
+        if (!k || value.size() > INT_MAX)
+            return false;
+        for (View v : value)
+            dictionaries.push_back(const_cast<::Dictionary *>(v.handle()));
+        return setDictionaryArray(handle(), k.c_str(), (int) dictionaries.size(), dictionaries.data());
+    }
+
+    bool remove(std::string_view key)
+    {
+        detail::Key k(key);
+        return k && removeElement(handle(), k.c_str());
+    }
+
+    // Keeps the json of the dictionary while it doesn't change, see setJsonCache
+    void cacheJson(bool enabled) { setJsonCache(handle(), enabled); }
+
+private:
+    explicit Dictionary(std::nullptr_t) {}
+};
+
+namespace detail
+{
+
+// Valor de un elemento si es de tipo T, leido sin copiarlo
+template<class T>
+std::optional<T> read(const DictionaryEntry &entry)
+{
+    if constexpr (std::is_same_v<T, double>)
+    {
+        if (entry.type == 'n')
+            return *static_cast<const double *>(entry.value);
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        if (entry.type == 'b')
+            return *static_cast<const Bool *>(entry.value) == boolTrue;
+    }
+    else if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        if (entry.type == 's')
+            return std::string_view(static_cast<const char *>(entry.value));
+    }
+    else if constexpr (std::is_same_v<T, View>)
+    {
+        if (entry.type == 'd')
+            return View(static_cast<const ::Dictionary *>(entry.value));
+    }
+    else if constexpr (std::is_same_v<T, ArrayView<double>>)
+    {
+        if (entry.type == 'a' && entry.arrayType == 'n')
+            return ArrayView<double>(static_cast<const double *>(entry.value), entry.size);
+    }
+    else if constexpr (std::is_same_v<T, BoolArrayView>)
+    {
+        if (entry.type == 'a' && entry.arrayType == 'b')
+            return BoolArrayView(static_cast<const unsigned long long *>(entry.value), entry.size);
+    }
+    else if constexpr (std::is_same_v<T, ArrayView<const char *>>)
+    {
+        if (entry.type == 'a' && entry.arrayType == 's')
+            return ArrayView<const char *>(static_cast<const char *const *>(entry.value), entry.size);
+    }
+    else
+        static_assert(Unsupported<T>::value, "unsupported value type");
+
+    return std::nullopt;
+}
+
+}
+
+inline std::optional<Entry> View::entry(std::string_view key) const
+{
+    detail::Key k(key);
+    DictionaryEntry result;
+
+    if (!k || !getEntry(dictionary, k.c_str(), &result))
+        return std::nullopt;
+    return Entry(result);
+}
+
+template<class T>
+std::optional<T> View::get(std::string_view key) const
+{
+    if constexpr (std::is_same_v<T, std::vector<Dictionary>>)
+    {
+        // Los arreglos de diccionarios guardados por columnas no tienen los diccionarios, asi que se copian
+        detail::Key k(key);
+        ::Dictionary **copies;
+        int size;
+
+        if (!k || !(copies = getDictionaryArray(dictionary, k.c_str(), &size)))
+            return std::nullopt;
+
+        std::optional<std::vector<Dictionary>> result(std::in_place);
+        try
+        {
+            result->reserve(size);
+        }
+        catch (...)
+        {
+            for (int i = 0; i < size; i++)
+                freeDictionary(copies[i]);
+            freeDictionaryMemory(dictionary, copies);
+            throw;
+        }
+
+        for (int i = 0; i < size; i++)
+            result->push_back(Dictionary::adopt(copies[i]));
+        freeDictionaryMemory(dictionary, copies);
+        return result;
+    }
+    else
+    {
+        std::optional<Entry> found = entry(key);
+        return found ? found->as<T>() : std::nullopt;
+    }
+}
+
+inline EntryIterator View::begin() const
+{
+    return dictionary ? EntryIterator(dictionary) : EntryIterator();
+}
+
+inline EntryIterator View::end() const
+{
+    return EntryIterator();
+}
+
+inline std::string View::toJson() const
+{
+    char *json = jsonFromDictionary(dictionary);
+    std::string result = json ? json : "";
+
+    freeDictionaryMemory(dictionary, json);
+    return result;
+}
+
+// Key of a member of T in json, see Binding
+template<class T, class M>
+struct Field
+{
+    const char *key;
+    std::size_t length;
+    M T::*member;
+};
+
+template<class T, class M, std::size_t N>
+constexpr Field<T, M> field(const char (&key)[N], M T::*member)
+{
+    return {key, N - 1, member};
+}
+
+// Keys of the members of a struct, with a hash table to find them that is built at compile time
+template<class... F>
+class Fields
+{
+public:
+    static constexpr std::size_t count = sizeof...(F);
+    static constexpr std::size_t slots = count < 2 ? 4 : std::size_t(1) << (64 - __builtin_clzll(count * 2 - 1));
+
+    constexpr explicit Fields(F... fields)
+        : members(fields...), keys{fields.key...}, lengths{fields.length...}, table{}, seed(0), validKeys(true),
+          uniqueKeys(true)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            validKeys = validKeys && lengths[i] > 0 && lengths[i] < sizeof(Element::key);
+            for (std::size_t j = 0; j < lengths[i]; j++)
+                validKeys = validKeys && keys[i][j] != '"' && keys[i][j] != '\0';
+            for (std::size_t j = 0; j < i; j++)
+                uniqueKeys = uniqueKeys && !sameKey(keys[i], lengths[i], keys[j], lengths[j]);
+        }
+
+        // Se prueban varias semillas y se queda la que deja menos claves lejos de su posicion en la tabla
+        std::size_t best = ~std::size_t(0);
+        for (unsigned long long i = 1; i <= 64 && best; i++)
+        {
+            std::size_t displaced = fill(i * 0x9e3779b97f4a7c15ull);
+            if (displaced < best)
+            {
+                best = displaced;
+                seed = i * 0x9e3779b97f4a7c15ull;
+            }
+        }
+        fill(seed);
+    }
+
+    // Index of the member with the key, -1 if there is none
+    int find(const char *key, std::size_t length) const
+    {
+        for (std::size_t i = position(key, length, seed); table[i]; i = (i + 1) & (slots - 1))
+            if (lengths[table[i] - 1] == length && !std::memcmp(keys[table[i] - 1], key, length))
+                return table[i] - 1;
+        return -1;
+    }
+
+    std::tuple<F...> members;
+    const char *keys[count ? count : 1];
+    std::size_t lengths[count ? count : 1];
+    unsigned short table[slots];  // Indice mas uno de la clave en cada posicion, 0 si esta libre
+    unsigned long long seed;
+    bool validKeys;               // Each key has 1 to 79 characters and no quotes
+    bool uniqueKeys;
+
+private:
+    // La posicion depende del largo y de los dos primeros y dos ultimos caracteres, que se leen sin recorrer la clave
+    static constexpr std::size_t position(const char *key, std::size_t length, unsigned long long seed)
+    {
+        if (!length)
+            return 0;
+
+        unsigned long long x = length;
+        x = x << 8 | (unsigned char) key[0];
+        x = x << 8 | (unsigned char) key[length > 1];
+        x = x << 8 | (unsigned char) key[length - 1];
+        x = x << 8 | (unsigned char) key[length - 1 - (length > 1)];
+        x = (x ^ seed) * 0xff51afd7ed558ccdull;
+        return (x ^ x >> 32) & (slots - 1);
+    }
+
+    static constexpr bool sameKey(const char *key, std::size_t length, const char *other, std::size_t otherLength)
+    {
+        if (length != otherLength)
+            return false;
+        for (std::size_t i = 0; i < length; i++)
+            if (key[i] != other[i])
+                return false;
+        return true;
+    }
+
+    // Llena la tabla con la semilla y retorna cuantas posiciones en total se corrieron las claves por colisiones
+    constexpr std::size_t fill(unsigned long long tableSeed)
+    {
+        std::size_t displaced = 0;
+
+        for (std::size_t i = 0; i < slots; i++)
+            table[i] = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::size_t j = position(keys[i], lengths[i], tableSeed);
+            for (; table[j]; j = (j + 1) & (slots - 1))
+                displaced++;
+            table[j] = (unsigned short) (i + 1);
+        }
+        return displaced;
+    }
+};
+
+template<class... F>
+constexpr Fields<F...> fields(F... members)
+{
+    return Fields<F...>(members...);
+}
+
+// Declares how a struct is read from and written to json. A specialization has the key of each member in fields and,
+// optionally, a dict::Dictionary member in others that receives the keys that aren't in fields:
+//
+//     template<>
+//     struct dict::Binding<Trade>
+//     {
+//         static constexpr auto fields = dict::fields(dict::field("price", &Trade::price),
+//                                                     dict::field("symbol", &Trade::symbol));
+//         static constexpr auto others = &Trade::others;
+//     };
+//
+// Members can be arithmetic, bool, std::string, dict::Dictionary, structs with a Binding or std::vector of those
+template<class T>
+struct Binding;
+
+// Reads the json of a dictionary into value without building a dictionary, returns false if the json is not valid.
+// Members whose key is missing or null keep their value, and others is only replaced when there are other keys.
+// Integer members only accept numbers without a fractional part that fit their type. When it returns false value can
+// be partly read, with the members before the error already replaced, so read into a temporary to keep it unchanged.
+// Without others, the values of the other keys are skipped checking only their quotes and brackets. Nested structs
+// are read with recursion, so a struct that contains itself through a vector uses stack for each level of the json
+template<class T>
+bool readJson(std::string_view json, T &value);
+
+// Appends the json of value to out, with the members in the order of fields followed by the keys of others, which
+// must not repeat them. Numbers are written like jsonFromDictionary does. Throws std::bad_alloc if there is no memory
+template<class T>
+void appendJson(std::string &out, const T &value);
+
+// Json of value, like appendJson
+template<class T>
+std::string writeJson(const T &value);
+
+namespace detail
+{
+
+// Las lecturas siguen el json que acepta dictionaryFromJson: sin espacios, strings sin escapes y numeros sin exponente.
+// Retornan donde termina lo que leyeron, o nullptr si no es valido
+
+template<class T>
+struct IsVector : std::false_type {};
+
+template<class T, class A>
+struct IsVector<std::vector<T, A>> : std::true_type {};
+
+template<class T, class = void>
+struct HasBinding : std::false_type {};
+
+template<class T>
+struct HasBinding<T, std::void_t<decltype(Binding<T>::fields)>> : std::true_type {};
+
+template<class T, class = void>
+struct HasOthers : std::false_type {};
+
+template<class T>
+struct HasOthers<T, std::void_t<decltype(Binding<T>::others)>> : std::true_type {};
+
+// Fin del valor que empieza en s, buscando solo sus comillas y corchetes
+inline const char *skipValue(const char *s, const char *end)
+{
+    const char *p = s;
+    int depth = 0;
+
+    if (p < end && *p == '"')
+        return (p = static_cast<const char *>(std::memchr(p + 1, '"', end - p - 1))) ? p + 1 : nullptr;
+
+    if (p < end && (*p == '{' || *p == '['))
+    {
+        for (; p < end; p++)
+        {
+            if (*p == '"')
+            {
+                if (!(p = static_cast<const char *>(std::memchr(p + 1, '"', end - p - 1))))
+                    return nullptr;
+            }
+            else if (*p == '{' || *p == '[')
+                depth++;
+            else if ((*p == '}' || *p == ']') && !--depth)
+                return p + 1;
+        }
+        return nullptr;
+    }
+
+    while (p < end && *p != ',' && *p != '}' && *p != ']')
+        p++;
+    return p == s ? nullptr : p;
+}
+
+// Numero con el formato que acepta isNumber
+inline const char *readNumber(const char *s, const char *end, double &value)
+{
+    const char *p = s, *digits;
+
+    if (p < end && *p == '-')
+        p++;
+    for (digits = p; p < end && *p >= '0' && *p <= '9'; p++)
+        ;
+    if (p == digits)
+        return nullptr;
+
+    if (p < end && *p == '.')
+    {
+        for (digits = ++p; p < end && *p >= '0' && *p <= '9'; p++)
+            ;
+        if (p == digits)
+            return nullptr;
+    }
+
+    return std::from_chars(s, p, value).ec == std::errc() ? p : nullptr;
+}
+
+template<class T>
+const char *readObject(const char *s, const char *end, T &value);
+
+template<class T>
+const char *readValue(const char *s, const char *end, T &value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        if (end - s >= 4 && !std::memcmp(s, "true", 4))
+        {
+            value = true;
+            return s + 4;
+        }
+        if (end - s >= 5 && !std::memcmp(s, "false", 5))
+        {
+            value = false;
+            return s + 5;
+        }
+        return nullptr;
+    }
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+        // Convertir un numero que no cabe en T es comportamiento indefinido, asi que no se acepta
+        double number;
+        if (!(s = readNumber(s, end, number)))
+            return nullptr;
+        if constexpr (std::is_integral_v<T>)
+        {
+            if (!(number >= static_cast<double>(std::numeric_limits<T>::min()) &&
+                  number < static_cast<double>(std::numeric_limits<T>::max()) + 1.0) ||
+                static_cast<double>(static_cast<T>(number)) != number) // Tampoco si tiene parte fraccionaria
+                return nullptr;
+        }
+        else if (number < -static_cast<double>(std::numeric_limits<T>::max()) ||
+                 number > static_cast<double>(std::numeric_limits<T>::max()))
+            return nullptr;
+        value = static_cast<T>(number);
+        return s;
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        const char *last;
+        if (s == end || *s != '"' || !(last = static_cast<const char *>(std::memchr(s + 1, '"', end - s - 1))))
+            return nullptr;
+        value.assign(s + 1, last);
+        return last + 1;
+    }
+    else if constexpr (std::is_same_v<T, Dictionary>)
+    {
+        // Se lee con dictionaryFromJson, que valida todo lo que contiene
+        const char *last = s < end && *s == '{' ? skipValue(s, end) : nullptr;
+        if (!last)
+            return nullptr;
+
+        Dictionary nested = Dictionary::fromJson(std::string(s, last));
+        if (!nested)
+            return nullptr;
+        value = std::move(nested);
+        return last;
+    }
+    else if constexpr (IsVector<T>::value)
+    {
+        if (s == end || *s++ != '[')
+            return nullptr;
+
+        value.clear();
+        if (s < end && *s == ']')
+            return s + 1;
+
+        for (;;)
+        {
+            typename T::value_type element{};
+            if (!(s = readValue(s, end, element)))
+                return nullptr;
+            value.push_back(std::move(element));
+
+            if (s == end)
+                return nullptr;
+            if (*s == ']')
+                return s + 1;
+            if (*s++ != ',')
+                return nullptr;
+        }
+    }
+    else if constexpr (HasBinding<T>::value)
+        return readObject(s, end, value);
+    else
+        static_assert(Unsupported<T>::value, "unsupported member type");
+}
+
+template<class T, std::size_t I>
+const char *readField(const char *s, const char *end, T &value)
+{
+    return readValue(s, end, value.*std::get<I>(Binding<T>::fields.members).member);
+}
+
+// Una funcion por miembro, para ir directo a la del indice que retorna la tabla de claves
+template<class T, std::size_t... I>
+constexpr auto fieldReaders(std::index_sequence<I...>)
+{
+    return std::array<const char *(*)(const char *, const char *, T &), sizeof...(I)>{{&readField<T, I>...}};
+}
+
+template<class T>
+const char *readObject(const char *s, const char *end, T &value)
+{
+    constexpr auto &fields = Binding<T>::fields;
+    static constexpr auto readers = fieldReaders<T>(std::make_index_sequence<fields.count>());
+    static_assert(fields.validKeys, "keys must have 1 to 79 characters and no quotes");
+    static_assert(fields.uniqueKeys, "keys must not be repeated");
+
+    bool seen[fields.count + 1] = {};
+    std::string others; // Miembros con otras claves, que se leen juntos con dictionaryFromJson al final
+
+    if (s == end || *s++ != '{')
+        return nullptr;
+
+    if (s < end && *s == '}')
+        s++;
+    else
+        for (;;)
+        {
+            const char *key = s + 1, *last;
+
+            // La clave no puede ser vacia ni mas larga que las de los elementos, y va seguida de ':'
+            if (s == end || *s != '"' || !(last = static_cast<const char *>(std::memchr(key, '"', end - key))) ||
+                last == key || last - key >= (std::ptrdiff_t) sizeof(Element::key) || end - last < 2 || last[1] != ':')
+                return nullptr;
+            s = last + 2;
+
+            int i = fields.find(key, last - key);
+            if (i >= 0)
+            {
+                if (seen[i])
+                    return nullptr;
+                seen[i] = true;
+
+                if (end - s >= 4 && !std::memcmp(s, "null", 4))
+                    s += 4;
+                else if (!(s = readers[i](s, end, value)))
+                    return nullptr;
+            }
+            else
+            {
+                if (!(last = skipValue(s, end)))
+                    return nullptr;
+                if constexpr (HasOthers<T>::value)
+                {
+                    others += others.empty() ? '{' : ',';
+                    others.append(key - 1, last);
+                }
+                s = last;
+            }
+
+            if (s == end)
+                return nullptr;
+            if (*s++ == '}')
+                break;
+            if (s[-1] != ',')
+                return nullptr;
+        }
+
+    if constexpr (HasOthers<T>::value)
+        if (!others.empty())
+        {
+            Dictionary read = Dictionary::fromJson(others + '}');
+            if (!read)
+                return nullptr;
+            value.*Binding<T>::others = std::move(read);
+        }
+    return s;
+}
+
+template<class T>
+void writeObject(std::string &out, const T &value);
+
+inline void writeDictionary(std::string &out, const ::Dictionary *dictionary, bool members)
+{
+    char *json = jsonFromDictionary(dictionary);
+    if (!json)
+        throw std::bad_alloc();
+
+    // Con members solo se agregan los miembros, sin las llaves
+    std::size_t length = std::strlen(json);
+    if (!members)
+        out.append(json, length);
+    else if (length > 2)
+        out.append(json + 1, length - 2);
+    freeDictionaryMemory(dictionary, json);
+}
+
+template<class T>
+void writeValue(std::string &out, const T &value)
+{
+    if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, std::vector<bool>::const_reference>)
+        out += value ? "true" : "false";
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+        // Como el "%.3f" de jsonFromDictionary, pero sin depender del locale
+        char number[320];
+        out.append(number, std::to_chars(number, number + sizeof(number), static_cast<double>(value),
+                                         std::chars_format::fixed, 3).ptr);
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        out += '"';
+        out += value;
+        out += '"';
+    }
+    else if constexpr (std::is_same_v<T, Dictionary>)
+    {
+        if (value)
+            writeDictionary(out, value.handle(), false);
+        else
+            out += "null";
+    }
+    else if constexpr (IsVector<T>::value)
+    {
+        out += '[';
+        for (std::size_t i = 0; i < value.size(); i++)
+        {
+            if (i)
+                out += ',';
+            writeValue(out, value[i]);
+        }
+        out += ']';
+    }
+    else if constexpr (HasBinding<T>::value)
+        writeObject(out, value);
+    else
+        static_assert(Unsupported<T>::value, "unsupported member type");
+}
+
+template<class T>
+void writeObject(std::string &out, const T &value)
+{
+    std::size_t start;
+
+    out += '{';
+    std::apply([&](const auto &... field) {
+        ((out += out.back() == '{' ? "\"" : ",\"", out.append(field.key, field.length), out += "\":",
+          writeValue(out, value.*field.member)), ...);
+    }, Binding<T>::fields.members);
+
+    if constexpr (HasOthers<T>::value)
+        if (const Dictionary &others = value.*Binding<T>::others)
+        {
+            start = out.size();
+            if (Binding<T>::fields.count)
+                out += ',';
+            writeDictionary(out, others.handle(), true);
+            if (out.size() == start + 1) // No tenia claves
+                out.resize(start);
+        }
+    out += '}';
+}
+
+}
+
+template<class T>
+bool readJson(std::string_view json, T &value)
+{
+    static_assert(detail::HasBinding<T>::value, "T needs a Binding");
+    const char *end = json.data() + json.size();
+    return detail::readObject(json.data(), end, value) == end;
+}
+
+template<class T>
+void appendJson(std::string &out, const T &value)
+{
+    static_assert(detail::HasBinding<T>::value, "T needs a Binding");
+    detail::writeObject(out, value);
+}
+
+template<class T>
+std::string writeJson(const T &value)
+{
+    std::string out;
+    appendJson(out, value);
+    return out;
+}
+
+}
+
+#endif
@@ -0,0 +1,354 @@
+// Regression tests for the dictionary library.
+//
+// Build and run from the repository root:
+//     cc -O2 -o regression test/regression.c -lpthread
+//     ./regression
+//
+// Each test prints its name and the program stops at the first check that fails, with a nonzero exit status.
+// The library is compiled into this file, like in the benchmarks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/dictionary.c"
+
+// Termina el programa si la condicion no se cumple
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #condition); exit(1); } } while (0)
+
+// Verifica que el json del diccionario sea expected
+void checkJson(const Dictionary *dictionary, const char *expected)
+{
+    char *json = jsonFromDictionary(dictionary);
+
+    CHECK(json);
+    if (strcmp(json, expected))
+        printf("expected %s\ngot      %s\n", expected, json);
+    CHECK(!strcmp(json, expected));
+    free(json);
+}
+
+// Lee first y despues second con setInterning, y verifica que second conserve el orden de sus claves anidadas
+void checkInternedOrder(const char *first, const char *second, const char *expected)
+{
+    Dictionary *d = dictionaryFromJson(first), *other = dictionaryFromJson(second);
+
+    CHECK(d && other);
+    checkJson(other, expected);
+    freeDictionary(d);
+    freeDictionary(other);
+}
+
+// Un diccionario compartido solo reemplaza a otro con las mismas claves en el mismo orden, tambien dentro de los
+// diccionarios anidados, los arreglos de diccionarios y las tablas
+void testInterningKeepsKeyOrder()
+{
+    Dictionary *d, *other, *holder, *otherHolder;
+    DictionaryStats before, after;
+
+    printf("interning keeps key order\n");
+    setInterning(1);
+
+    checkInternedOrder("{\"doc\":{\"p\":{\"x\":1,\"y\":2}}}", "{\"doc\":{\"p\":{\"y\":2,\"x\":1}}}",
+                       "{\"doc\":{\"p\":{\"y\":2.000,\"x\":1.000}}}");
+    checkInternedOrder("{\"doc\":{\"l\":[{\"p\":{\"x\":1,\"y\":2}},{\"q\":1}]}}",
+                       "{\"doc\":{\"l\":[{\"p\":{\"y\":2,\"x\":1}},{\"q\":1}]}}",
+                       "{\"doc\":{\"l\":[{\"p\":{\"y\":2.000,\"x\":1.000}},{\"q\":1.000}]}}");
+    checkInternedOrder("{\"doc\":{\"t\":[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4}]}}",
+                       "{\"doc\":{\"t\":[{\"b\":2,\"a\":1},{\"b\":4,\"a\":3}]}}",
+                       "{\"doc\":{\"t\":[{\"b\":2.000,\"a\":1.000},{\"b\":4.000,\"a\":3.000}]}}");
+    checkInternedOrder("{\"doc\":{\"t\":[{\"a\":{\"x\":1,\"y\":2}},{\"a\":{\"x\":3,\"y\":4}}]}}",
+                       "{\"doc\":{\"t\":[{\"a\":{\"y\":2,\"x\":1}},{\"a\":{\"y\":4,\"x\":3}}]}}",
+                       "{\"doc\":{\"t\":[{\"a\":{\"y\":2.000,\"x\":1.000}},{\"a\":{\"y\":4.000,\"x\":3.000}}]}}");
+
+    d = dictionaryFromJson("{\"p\":{\"x\":1,\"y\":2}}");
+    other = dictionaryFromJson("{\"p\":{\"y\":2,\"x\":1}}");
+    holder = newDictionary();
+    otherHolder = newDictionary();
+    CHECK(d && other && holder && otherHolder);
+    CHECK(setDictionary(holder, "v", d) && setDictionary(otherHolder, "v", other));
+    checkJson(otherHolder, "{\"v\":{\"p\":{\"y\":2.000,\"x\":1.000}}}");
+    freeDictionary(d);
+    freeDictionary(other);
+    freeDictionary(holder);
+    freeDictionary(otherHolder);
+
+    // Los identicos se siguen compartiendo
+    getDictionaryStats(&before);
+    d = dictionaryFromJson("{\"doc\":{\"p\":{\"x\":1,\"y\":2}}}");
+    other = dictionaryFromJson("{\"doc\":{\"p\":{\"x\":1,\"y\":2}}}");
+    CHECK(d && other);
+    getDictionaryStats(&after);
+    CHECK(after.sharedDictionaries - before.sharedDictionaries >= 2);
+    freeDictionary(d);
+    freeDictionary(other);
+
+    setInterning(0);
+}
+
+// Abre el store del directorio, verifica que tenga los booleanos y lo cierra
+void checkStoredBools(const char *directory, int size, Bool *values)
+{
+    Dictionary *d = openDictionaryStore(directory, 0, 0);
+    Bool *stored;
+    int storedSize;
+
+    CHECK(d);
+    CHECK((stored = getBoolArray(d, "bools", &storedSize)) != NULL && storedSize == size);
+    CHECK(!memcmp(stored, values, size * sizeof(Bool)));
+    free(stored);
+    freeDictionary(d);
+}
+
+// Un store con un arreglo booleano de mas de 64 elementos, que ocupa menos bytes que elementos, se vuelve a abrir
+// desde el log y desde el snapshot
+void testStoreReopensLongBoolArrays()
+{
+    char directory[] = "/tmp/dictionaryStoreXXXXXX", command[64];
+    Bool values[1000];
+    Dictionary *d;
+    int i, size;
+
+    printf("store reopens long bool arrays\n");
+    CHECK(mkdtemp(directory));
+    for(i = 0; i < 1000; i++)
+        values[i] = i % 3 ? true : false;
+
+    for(size = 70; size <= 1000; size += 930)
+    {
+        CHECK((d = openDictionaryStore(directory, 0, 0)) != NULL);
+        CHECK(setBoolArray(d, "bools", size, values));
+        freeDictionary(d);
+        checkStoredBools(directory, size, values);
+
+        CHECK((d = openDictionaryStore(directory, 0, 0)) != NULL);
+        CHECK(compactDictionaryStore(d));
+        freeDictionary(d);
+        checkStoredBools(directory, size, values);
+    }
+
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    CHECK(!system(command));
+}
+
+// Con un log chico y los registros agrupados, el flusher cambia de log con registros de los dos lados del cambio y los
+// snapshots se arman desde los archivos mientras se sigue escribiendo. Al volver a abrirlo queda el mismo diccionario
+void testStoreCompactsWhileWriting()
+{
+    char directory[] = "/tmp/dictionaryStoreXXXXXX", command[64], key[16], *expected;
+    Dictionary *d;
+    int i;
+
+    printf("store compacts while writing\n");
+    CHECK(mkdtemp(directory));
+    CHECK((d = openDictionaryStore(directory, 2, 4096)) != NULL);
+    for(i = 0; i < 20000; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i % 3000);
+        if (i % 7 == 6)
+            removeElement(d, key);
+        else
+            CHECK(setNumber(d, key, i));
+    }
+    CHECK(compactDictionaryStore(d));
+    CHECK(setString(d, "last", "after the snapshot"));
+    CHECK((expected = jsonFromDictionary(d)) != NULL);
+    freeDictionary(d);
+
+    for(i = 0; i < 2; i++)
+    {
+        CHECK((d = openDictionaryStore(directory, 0, 0)) != NULL);
+        checkJson(d, expected);
+        CHECK(compactDictionaryStore(d));
+        freeDictionary(d);
+    }
+
+    free(expected);
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    CHECK(!system(command));
+}
+
+// Los bytes de los arreglos, medidos al crearlos, son los mismos que cuenta getDictionaryUsage, y se restan al liberarlos
+void testArrayBytesAreCounted()
+{
+    char *strings[] = {"a", "bcd", "efghij"};
+    DictionaryStats before, created, after;
+    DictionaryUsage usage;
+    Dictionary *d;
+
+    printf("array bytes are counted\n");
+    getDictionaryStats(&before);
+    d = dictionaryFromJson("{\"t\":[{\"a\":\"xy\",\"b\":[\"z\"]},{\"a\":\"w\",\"b\":[\"uvw\",\"q\"]}],\"n\":[1,2]}");
+    CHECK(d && setStringArray(d, "s", 3, strings));
+    getDictionaryStats(&created);
+    getDictionaryUsage(d, &usage);
+    CHECK(created.stringBytes - before.stringBytes == usage.stringBytes);
+    CHECK(created.arrayBytes - before.arrayBytes == usage.arrayBytes);
+
+    freeDictionary(d);
+    getDictionaryStats(&after);
+    CHECK(after.stringBytes == before.stringBytes && after.arrayBytes == before.arrayBytes);
+}
+
+// Las filas de un arreglo de diccionarios se leen desde su entrada, este guardado por columnas o no
+void testEntryRows()
+{
+    const char *jsons[] = {"{\"t\":[{\"a\":1,\"s\":\"x\"},{\"a\":2,\"s\":\"y\"}]}",
+                           "{\"t\":[{\"a\":1,\"s\":\"x\"},{\"s\":\"y\",\"a\":2}]}"};
+    DictionaryEntry entry, cell;
+    DictionaryCursor cursor;
+    Dictionary *d;
+    int i;
+
+    printf("entry rows\n");
+    for(i = 0; i < 2; i++)
+    {
+        CHECK((d = dictionaryFromJson(jsons[i])) != NULL);
+        startIteration(d, &cursor);
+        CHECK(nextEntry(&cursor, &entry) && entry.type == 'a' && entry.arrayType == 'd' && entry.size == 2);
+        CHECK(i ? entry.value != NULL : entry.value == NULL); // La primera se guarda por columnas
+        CHECK(getEntryRow(&entry, 1, "a", &cell) && cell.type == 'n' && *(const double *) cell.value == 2);
+        CHECK(getEntryRow(&entry, 0, "s", &cell) && cell.type == 's' && !strcmp(cell.value, "x"));
+        CHECK(!getEntryRow(&entry, 2, "a", &cell) && !getEntryRow(&entry, 0, "b", &cell));
+        freeDictionary(d);
+    }
+}
+
+// Retorna un json con depth diccionarios anidados, {"a":{"a":...{}...}}, o con arrays un arreglo de un diccionario en
+// cada nivel, {"a":[{"a":[...{}...]}]}
+char *deepJson(int depth, int arrays)
+{
+    char *json = malloc(8 * (size_t) depth + 3), *p = json;
+    int i;
+
+    CHECK(json);
+    for(i = 0; i < depth; i++)
+        p += sprintf(p, arrays ? "{\"a\":[" : "{\"a\":");
+    p += sprintf(p, "{}");
+    for(i = 0; i < depth; i++)
+        p += sprintf(p, arrays ? "]}" : "}");
+    return json;
+}
+
+// Retorna los segundos que tarda en leerse el json, y verifica que se vuelva a escribir igual
+double parseSeconds(const char *json)
+{
+    struct timespec start, end;
+    Dictionary *d;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    d = dictionaryFromJson(json);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(d);
+    checkJson(d, json);
+    freeDictionary(d);
+    return end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Un json de 100000 niveles se lee en tiempo lineal: con el doble de niveles tarda cerca del doble, y no cuatro veces
+// mas como cuando cada nivel volvia a recorrer su texto
+void testDeepJsonParsesInLinearTime()
+{
+    char *json, *twice;
+    double seconds, twiceSeconds;
+    int arrays;
+
+    printf("deep json parses in linear time\n");
+    for(arrays = 0; arrays < 2; arrays++)
+    {
+        json = deepJson(100000, arrays);
+        twice = deepJson(200000, arrays);
+        seconds = parseSeconds(json);
+        twiceSeconds = parseSeconds(twice);
+        if (twiceSeconds > 3 * seconds + 0.05)
+            printf("100000 levels %.3fs, 200000 levels %.3fs\n", seconds, twiceSeconds);
+        CHECK(twiceSeconds <= 3 * seconds + 0.05);
+        free(json);
+        free(twice);
+    }
+}
+
+// Retorna los segundos que tarda validateJson en aceptar el json
+double validateSeconds(const char *json)
+{
+    struct timespec start, end;
+    int valid;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    valid = validateJson(json);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(valid);
+    return end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Retorna los segundos que tarda en leerse {"a":<value>,"b":1} con la proyeccion de b, que salta value
+double projectSeconds(const char *value, const DictionaryProjection *projection)
+{
+    char *json = malloc(strlen(value) + 16);
+    struct timespec start, end;
+    Dictionary *d;
+
+    CHECK(json);
+    sprintf(json, "{\"a\":%s,\"b\":1}", value);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    d = dictionaryFromJsonWithProjection(json, projection, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(d);
+    checkJson(d, "{\"b\":1.000}");
+    freeDictionary(d);
+    free(json);
+    return end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// validateJson y una proyeccion que salta un valor de 100000 niveles tambien tardan cerca del doble con el doble de
+// niveles
+void testDeepJsonValidatesInLinearTime()
+{
+    const char *paths[] = {"b"};
+    DictionaryProjection *projection = newProjection(1, paths);
+    char *json, *twice;
+    double seconds, twiceSeconds;
+    int arrays;
+
+    printf("deep json validates in linear time\n");
+    CHECK(projection);
+    for(arrays = 0; arrays < 2; arrays++)
+    {
+        json = deepJson(100000, arrays);
+        twice = deepJson(200000, arrays);
+
+        seconds = validateSeconds(json);
+        twiceSeconds = validateSeconds(twice);
+        if (twiceSeconds > 3 * seconds + 0.05)
+            printf("validate: 100000 levels %.3fs, 200000 levels %.3fs\n", seconds, twiceSeconds);
+        CHECK(twiceSeconds <= 3 * seconds + 0.05);
+
+        seconds = projectSeconds(json, projection);
+        twiceSeconds = projectSeconds(twice, projection);
+        if (twiceSeconds > 3 * seconds + 0.05)
+            printf("projection: 100000 levels %.3fs, 200000 levels %.3fs\n", seconds, twiceSeconds);
+        CHECK(twiceSeconds <= 3 * seconds + 0.05);
+
+        free(json);
+        free(twice);
+    }
+    freeProjection(projection);
+}
+
+int main()
+{
+    testInterningKeepsKeyOrder();
+    testStoreReopensLongBoolArrays();
+    testStoreCompactsWhileWriting();
+    testArrayBytesAreCounted();
+    testEntryRows();
+    testDeepJsonParsesInLinearTime();
+    testDeepJsonValidatesInLinearTime();
+    printf("ok\n");
+    return 0;
+}
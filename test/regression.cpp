@@ -0,0 +1,70 @@
+// Regression tests for the C++ wrapper in dictionary.hpp.
+//
+// Build and run from the repository root, compiling the library as C:
+//     cc -O2 -c src/dictionary.c -o dictionary.o
+//     c++ -std=c++17 -O2 -Isrc -o regression_cpp test/regression.cpp dictionary.o -lpthread
+//     ./regression_cpp
+//
+// Each test prints its name and the program stops at the first check that fails, with a nonzero exit status.
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include "dictionary.hpp"
+
+// Termina el programa si la condicion no se cumple
+#define CHECK(condition) \
+    do { if (!(condition)) { std::printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (0)
+
+struct Counters
+{
+    int id = 7;
+    unsigned char small = 0;
+    unsigned int count = 0;
+    float ratio = 0;
+};
+
+template<>
+struct dict::Binding<Counters>
+{
+    static constexpr auto fields = dict::fields(dict::field("id", &Counters::id), dict::field("small", &Counters::small),
+                                                dict::field("count", &Counters::count),
+                                                dict::field("ratio", &Counters::ratio));
+};
+
+// Verifica que readJson no acepte el json
+void checkRejected(const char *json)
+{
+    Counters counters;
+    if (dict::readJson(json, counters))
+        std::printf("accepted %s\n", json);
+    CHECK(!dict::readJson(json, counters));
+}
+
+// Los miembros enteros solo aceptan numeros sin parte fraccionaria que quepan en su tipo, en lugar de convertir
+// cualquier numero, y los float solo los que caben en un float
+void testReadJsonChecksNumberRanges()
+{
+    Counters counters;
+
+    std::printf("readJson checks number ranges\n");
+    checkRejected("{\"id\":99999999999999999999.000}");
+    checkRejected("{\"id\":2147483648}");
+    checkRejected("{\"id\":-2147483649}");
+    checkRejected("{\"id\":1.500}");
+    checkRejected("{\"small\":256}");
+    checkRejected("{\"count\":-1}");
+    checkRejected("{\"ratio\":1000000000000000000000000000000000000000000}");
+
+    CHECK(dict::readJson("{\"id\":-2147483648.000,\"small\":255,\"count\":4294967295,\"ratio\":0.500}", counters));
+    CHECK(counters.id == INT_MIN && counters.small == 255 && counters.count == UINT_MAX && counters.ratio == 0.5f);
+    CHECK(dict::readJson("{\"id\":2147483647.000,\"count\":-0}", counters) && counters.id == INT_MAX && !counters.count);
+}
+
+int main()
+{
+    testReadJsonChecksNumberRanges();
+    std::printf("ok\n");
+    return 0;
+}